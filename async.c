@@ -0,0 +1,225 @@
+/*  async.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: wraps generate_sentence_cancellable in tasks for a worker pool
+*   shared by the library.  A Generation carries the request, its cancellation
+*   flag and a count of references; a CompletionQueue is a locked list of
+*   finished generations fronted by an eventfd.
+*   -------------------------
+*   Design choices & notes:
+*    - A generation has two owners, the caller and the worker, and whichever
+*      lets go last frees it.  That way the caller can cancel at any moment
+*      before releasing, without racing the worker's finish.  A queued
+*      generation's worker reference passes to the queue when it finishes,
+*      and is dropped when it is taken.
+*    - Cancellation is a flag that the search reads at every step, so a
+*      cancelled search gives up after at most one step's work.
+*    - The eventfd's counter is kept non-zero exactly while the queue is
+*      non-empty, by updating both under the queue's lock, so an event loop
+*      can poll the descriptor and drain the queue without reading it.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "model.h"
+#include "async.h"
+#include "workers.h"
+
+/*  Struct: GenerationImplementation
+*   --------------------------------
+*   One request, from submission until both its owners have let go.
+*/
+struct GenerationImplementation {
+    Model* model;
+    int length;
+    GenerationCallback callback;  // for generate_sentence_async, or NULL
+    CompletionQueue* queue;  // for generate_sentence_queued, or NULL
+    void* arg;  // callback argument or queue tag
+    bool cancelled;  // atomic
+    int n_refs;  // atomic, 2 while the worker still holds the generation
+    char* sentence;  // result, while waiting in a queue
+    struct GenerationImplementation* next;  // in the completion queue
+};
+
+/*  Struct: CompletionQueueImplementation
+*   -------------------------------------
+*   Finished generations, oldest first.
+*/
+struct CompletionQueueImplementation {
+    int event_fd;
+    pthread_mutex_t lock;
+    Generation* head;
+    Generation* tail;
+};
+
+//  -------Function prototypes-------
+Generation* submit_generation(Model* model, int length, GenerationCallback callback, CompletionQueue* queue, void* arg);
+void run_generation(void* generation_ptr);
+void complete_generation(CompletionQueue* queue, Generation* generation);
+//  ---------------------------------
+
+
+/*  Function: generate_sentence_async
+*   ---------------------------------
+*   Submits a generation that finishes through callback.
+*/
+Generation* generate_sentence_async(Model* model, int length, GenerationCallback callback, void* arg) {
+    return submit_generation(model, length, callback, NULL, arg);
+}
+
+/*  Function: generate_sentence_queued
+*   ----------------------------------
+*   Submits a generation that finishes into queue.
+*/
+Generation* generate_sentence_queued(Model* model, int length, CompletionQueue* queue, void* tag) {
+    return submit_generation(model, length, NULL, queue, tag);
+}
+
+/*  Function: submit_generation
+*   ---------------------------
+*   Creates a generation owned by both the caller and the worker, and hands it to the
+*   library's pool.
+*/
+Generation* submit_generation(Model* model, int length, GenerationCallback callback, CompletionQueue* queue, void* arg) {
+    Generation* generation = calloc(1, sizeof(Generation));
+    generation->model = model;
+    generation->length = length;
+    generation->callback = callback;
+    generation->queue = queue;
+    generation->arg = arg;
+    generation->n_refs = 2;
+    submit_task(library_worker_pool(), run_generation, generation);
+    return generation;
+}
+
+/*  Function: run_generation
+*   ------------------------
+*   Runs on a worker thread.  Searches unless the generation was cancelled while queued,
+*   then delivers the result, either to the queue along with the worker's reference, or to
+*   the callback, after which the reference is dropped.
+*/
+void run_generation(void* generation_ptr) {
+    Generation* generation = generation_ptr;
+    char* sentence = NULL;
+    if (!generation_cancelled(generation)) {
+        sentence = generate_sentence_cancellable(generation->model, generation->length, &generation->cancelled);
+    }
+    if (generation->queue) {
+        generation->sentence = sentence;
+        complete_generation(generation->queue, generation);
+    } else {
+        generation->callback(generation, sentence, generation->arg);
+        release_generation(generation);
+    }
+}
+
+/*  Function: cancel_generation
+*   ---------------------------
+*   Sets the flag that the search checks at every step.
+*/
+void cancel_generation(Generation* generation) {
+    __atomic_store_n(&generation->cancelled, true, __ATOMIC_RELAXED);
+}
+
+/*  Function: generation_cancelled
+*   ------------------------------
+*   Reads the cancellation flag.
+*/
+bool generation_cancelled(Generation* generation) {
+    return __atomic_load_n(&generation->cancelled, __ATOMIC_RELAXED);
+}
+
+/*  Function: release_generation
+*   ----------------------------
+*   Drops one reference, freeing the generation if it was the last.
+*/
+void release_generation(Generation* generation) {
+    if (__atomic_sub_fetch(&generation->n_refs, 1, __ATOMIC_ACQ_REL) == 0) free(generation);
+}
+
+/*  Function: create_completion_queue
+*   ---------------------------------
+*   Opens the eventfd and initializes an empty list.
+*/
+CompletionQueue* create_completion_queue() {
+    CompletionQueue* queue = malloc(sizeof(CompletionQueue));
+    queue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->event_fd < 0) {
+        printf("Could not create completion queue.\n");
+        exit(1);
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->head = queue->tail = NULL;
+    return queue;
+}
+
+/*  Function: completion_queue_fd
+*   -----------------------------
+*   Returns the eventfd.
+*/
+int completion_queue_fd(CompletionQueue* queue) {
+    return queue->event_fd;
+}
+
+/*  Function: complete_generation
+*   -----------------------------
+*   Appends a finished generation to the queue, making the eventfd readable if the queue was
+*   empty.
+*/
+void complete_generation(CompletionQueue* queue, Generation* generation) {
+    generation->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail) queue->tail->next = generation;
+    else {
+        queue->head = generation;
+        uint64_t one = 1;
+        ssize_t ignored = write(queue->event_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    queue->tail = generation;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*  Function: take_completion
+*   -------------------------
+*   Pops the oldest finished generation, resetting the eventfd if that empties the queue, and
+*   drops the reference the queue held.
+*/
+bool take_completion(CompletionQueue* queue, char** sentence, void** tag) {
+    pthread_mutex_lock(&queue->lock);
+    Generation* first = queue->head;
+    if (first) {
+        queue->head = first->next;
+        if (!queue->head) {
+            queue->tail = NULL;
+            uint64_t count;
+            ssize_t ignored = read(queue->event_fd, &count, sizeof(count));
+            (void)ignored;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    if (!first) return false;
+    *sentence = first->sentence;
+    *tag = first->arg;
+    release_generation(first);
+    return true;
+}
+
+/*  Function: free_completion_queue
+*   -------------------------------
+*   Releases what is left in the queue and closes the eventfd.
+*/
+void free_completion_queue(CompletionQueue* queue) {
+    char* sentence;
+    void* tag;
+    while (take_completion(queue, &sentence, &tag)) free(sentence);
+    close(queue->event_fd);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
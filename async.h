@@ -0,0 +1,98 @@
+/*  async.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Non-blocking sentence generation for callers that run an event loop.  Each
+*   request runs on a worker pool shared by the whole library and reports back
+*   either through a callback or through a completion queue whose file
+*   descriptor can be polled.  Include model.h first.
+*/
+
+/*  Struct: Generation
+*   ------------------
+*   Reference to one submitted generate request.  The caller holds it until
+*   calling release_generation, and may cancel the request until then.
+*/
+typedef struct GenerationImplementation Generation;
+
+/*  Struct: CompletionQueue
+*   -----------------------
+*   Reference to a queue of finished generations.
+*/
+typedef struct CompletionQueueImplementation CompletionQueue;
+
+/*  Type: GenerationCallback
+*   ------------------------
+*   Called once, on a worker thread, when a generation finishes.  sentence is
+*   heap-allocated and belongs to the callback, or is NULL if no sentence of
+*   that length exists or the generation was cancelled.
+*/
+typedef void (*GenerationCallback)(Generation* generation, char* sentence, void* arg);
+
+/*  Function: generate_sentence_async
+*   ---------------------------------
+*   Queues a generate_sentence call on the library's worker pool, which is
+*   started on first use with one thread per processor, and returns at once.
+*   callback is called with arg when the call finishes.  The model must stay
+*   alive, and must not ingest text, until then.
+*/
+Generation* generate_sentence_async(Model* model, int length, GenerationCallback callback, void* arg);
+
+/*  Function: generate_sentence_queued
+*   ----------------------------------
+*   Like generate_sentence_async, but when the generation finishes its sentence
+*   and tag are added to queue instead of being passed to a callback.  The
+*   caller still releases the returned generation as usual.
+*/
+Generation* generate_sentence_queued(Model* model, int length, CompletionQueue* queue, void* tag);
+
+/*  Function: cancel_generation
+*   ---------------------------
+*   Asks the generation to stop.  One that has not started is skipped, and one
+*   that is searching gives up within a few steps; either way it still finishes
+*   once, with a NULL sentence.  One that has already finished is unaffected.
+*/
+void cancel_generation(Generation* generation);
+
+/*  Function: generation_cancelled
+*   ------------------------------
+*   Returns true if cancel_generation has been called on the generation, which
+*   tells a NULL sentence from cancellation apart from an impossible length.
+*/
+bool generation_cancelled(Generation* generation);
+
+/*  Function: release_generation
+*   ----------------------------
+*   Gives up the caller's reference to the generation, which must not be used
+*   afterwards.  Call it exactly once per generation, from its callback or any
+*   time later; releasing does not cancel.
+*/
+void release_generation(Generation* generation);
+
+/*  Function: create_completion_queue
+*   ---------------------------------
+*   Creates an empty completion queue.
+*/
+CompletionQueue* create_completion_queue();
+
+/*  Function: completion_queue_fd
+*   -----------------------------
+*   Returns a non-blocking file descriptor that polls readable exactly while
+*   the queue holds finished generations.  Do not read from or close it.
+*/
+int completion_queue_fd(CompletionQueue* queue);
+
+/*  Function: take_completion
+*   -------------------------
+*   Removes the oldest finished generation from the queue, storing its
+*   sentence (owned by the caller, NULL if none was made) and tag.  Returns
+*   false, storing nothing, if the queue is empty.  Never blocks.
+*/
+bool take_completion(CompletionQueue* queue, char** sentence, void** tag);
+
+/*  Function: free_completion_queue
+*   -------------------------------
+*   Frees the queue and any sentences still in it.  No generation may still be
+*   running for the queue.
+*/
+void free_completion_queue(CompletionQueue* queue);
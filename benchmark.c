@@ -0,0 +1,132 @@
+/*  benchmark.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "model.h"
+#include "pages.h"
+#include "nodes.h"
+
+//  -------Function prototypes-------
+double now_us();
+long huge_page_kb();
+//  ---------------------------------
+
+/*	Function: main
+*	--------------
+*	Invocation: benchmark [-H] [-N] [-n n_sentences] [-w batch_size [-t threads | -E]] model_file n_words_in_sentence
+*	Loads the model file written by build_model and times the generation of n_sentences
+*	sentences of the given length, one generate_sentence call each, or with -w through
+*	generate_sentences, batch_size sentences a call, then prints the throughput.  With -t the
+*	batches are made by generate_sentences_seeded on threads threads, and with -N those are
+*	spread across the machine's NUMA nodes with enable_node_replicas.  With -E the batches
+*	are made by generate_sentences_exact instead.  With -H the model is
+*	put in huge pages with enable_huge_pages first, and the memory the process has in
+*	transparent huge pages is printed after the run.  Nothing else runs in the process, so
+*	it can be run under perf stat to compare models saved with different word orders, with
+*	and without huge pages, as the perf target in the Makefile does.
+*/
+int main(int argc, char* argv[]) {
+	int n_sentences = 100000;
+	int batch_size = 0;
+	int n_threads = 0;
+	bool huge_pages = false, node_replicas = false, exact = false;
+	int opt;
+	bool valid = true;
+	while ((opt = getopt(argc, argv, "HNEn:w:t:")) != -1) {
+		if (opt == 'H') huge_pages = true;
+		else if (opt == 'E') exact = true;
+		else if (opt == 'N') node_replicas = true;
+		else if (opt == 't') valid = valid && sscanf(optarg, "%d", &n_threads) == 1 && n_threads > 0;
+		else if (opt == 'n') valid = valid && sscanf(optarg, "%d", &n_sentences) == 1 && n_sentences > 0;
+		else if (opt == 'w') valid = valid && sscanf(optarg, "%d", &batch_size) == 1 && batch_size > 0;
+		else valid = false;
+	}
+	int n_words = 0;
+	if (argc - optind != 2 || sscanf(argv[optind + 1], "%d", &n_words) != 1 || n_words < 1) valid = false;
+	if ((n_threads || exact) && !batch_size) valid = false;
+	if (n_threads && exact) valid = false;
+	if (!valid) {
+		printf("Please invoke as: benchmark [-H] [-N] [-n n_sentences] [-w batch_size [-t threads | -E]] model_file n_words_in_sentence\n");
+		exit(1);
+	}
+	Model* model = load_model(argv[optind]);
+	if (!model) {
+		printf("Model could not be loaded from %s.\n", argv[optind]);
+		exit(1);
+	}
+	if (huge_pages && !enable_huge_pages(model)) printf("Huge pages are not available; using ordinary pages.\n");
+	if (node_replicas) {
+		int n_nodes = enable_node_replicas(model);
+		if (n_nodes > 1) printf("Threads spread across %d NUMA nodes.\n", n_nodes);
+		else printf("Only one NUMA node found; threads are not bound.\n");
+	}
+	char* first = generate_sentence(model, n_words);  // builds the generation view untimed
+	if (!first) {
+		printf("No sentence of %d words can be made from %s.\n", n_words, argv[optind]);
+		exit(1);
+	}
+	free(first);
+	size_t total_length = 0;
+	double start = now_us();
+	if (batch_size) {
+		char** sentences = malloc(batch_size * sizeof(char*));
+		for (int done = 0; done < n_sentences; done += batch_size) {
+			int n = n_sentences - done < batch_size ? n_sentences - done : batch_size;
+			int n_made = n_threads ? generate_sentences_seeded(model, n_words, 42, done, n, sentences, n_threads)
+				: exact ? generate_sentences_exact(model, n_words, n, sentences)
+				: generate_sentences(model, n_words, n, sentences);
+			for (int i = 0; i < n_made; i++) {
+				total_length += strlen(sentences[i]);
+				free(sentences[i]);
+			}
+		}
+		free(sentences);
+	} else {
+		for (int i = 0; i < n_sentences; i++) {
+			char* sentence = generate_sentence(model, n_words);
+			total_length += strlen(sentence);
+			free(sentence);
+		}
+	}
+	double elapsed = now_us() - start;
+	printf("%d sentences of %d words in %.3f s: %.0f sentences/s, %.2f us each (%zu bytes made)\n",
+		n_sentences, n_words, elapsed / 1e6, n_sentences / (elapsed / 1e6), elapsed / n_sentences, total_length);
+	long huge_kb = huge_page_kb();
+	if (huge_pages && huge_kb >= 0) printf("%ld kB in transparent huge pages\n", huge_kb);
+	free_allocated(model);
+	return 0;
+}
+
+/*	Function: now_us
+*	----------------
+*	Returns the CLOCK_MONOTONIC time in microseconds.
+*/
+double now_us() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/*	Function: huge_page_kb
+*	----------------------
+*	Returns the kilobytes of the process's memory in transparent huge pages, from
+*	/proc/self/smaps_rollup, or -1 if it cannot be read.
+*/
+long huge_page_kb() {
+	FILE* smaps = fopen("/proc/self/smaps_rollup", "r");
+	if (!smaps) return -1;
+	long kb = -1;
+	char line[256];
+	while (fgets(line, sizeof(line), smaps)) {
+		if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) break;
+	}
+	fclose(smaps);
+	return kb;
+}
@@ -0,0 +1,53 @@
+/*  build_model.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "model.h"
+#include "options.h"
+#include "relabel.h"
+
+/*	Function: main
+*	--------------
+*	Invocation: build_model [-b budget_kb | -w window | -d half_life] [-o frequency|bfs]
+*	                        [text_file] [model_file]
+*	Creates the model from text_file, as print_model would, then saves it to model_file so
+*	that load_model (and a sentence_server given its directory with -r) can map it in.  With
+*	-o, the words of an exact model are renumbered by frequency or breadth first over the
+*	bigrams before saving, so that those a walk visits most share cache lines and pages.
+*/
+int main(int argc, char* argv[]) {
+	Model* model = NULL;
+	bool relabel = false;
+	RelabelOrder order = RELABEL_BY_FREQUENCY;
+	int opt;
+	while ((opt = getopt(argc, argv, "b:w:d:o:")) != -1) {
+		if (opt == 'o') {
+			relabel = true;
+			if (!strcmp(optarg, "bfs")) order = RELABEL_BY_BFS;
+			else if (strcmp(optarg, "frequency")) {
+				printf("Option -o takes frequency or bfs.\n");
+				exit(1);
+			}
+			continue;
+		}
+		if (!parse_model_option(opt, optarg, &model)) exit(1);
+	}
+	if (argc - optind != 2 || (relabel && model)) {
+		printf("Please invoke as: build_model [-b budget_kb | -w window | -d half_life] [-o frequency|bfs] text_file model_file\n");
+		exit(1);
+	}
+	model = build_model_from(model, argv[optind]);
+	if (relabel) relabel_model(model, order);
+	FILE* file = fopen(argv[optind + 1], "wb");
+	if (!file || save_model(model, file) || fclose(file)) {
+		printf("Model could not be saved to %s.\n", argv[optind + 1]);
+		exit(1);
+	}
+	free_allocated(model);
+	return 0;
+}
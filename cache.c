@@ -0,0 +1,415 @@
+/*  cache.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: a fixed table of sentence lengths, each with a bounded ring of
+*   ready sentences.  Callers pop from the rings without locks; one thread
+*   tops them up by sampling walks from the length's reachability table, which
+*   it works out once since the model no longer changes.  How many sentences
+*   each length keeps follows the share of requests it received recently.
+*   -------------------------
+*   Design choices & notes:
+*    - Each ring is the bounded multi-producer, multi-consumer queue where
+*      every cell carries a sequence number telling pushers and poppers
+*      whose turn it is, so a pop is one compare-and-swap and never waits on
+*      the filling thread.
+*    - Lengths claim table slots the first time they are asked for, with a
+*      compare-and-swap on the slot's length.  The filling thread allocates
+*      the slot's ring and publishes it, so callers never allocate.  While the
+*      table is full further lengths are not cached, but the next demand fold
+*      then reclaims the slots whose demand has died away.
+*    - Callers count themselves as users of a slot while they touch its ring.
+*      The filling thread retires a slot by marking its length RETIRING, and
+*      only frees the ring once it then sees no users; a caller that pinned
+*      the slot first is seen, and one that pins it later sees the mark.
+*    - The filling thread sleeps while every ring is at its target.  Callers
+*      that drain a ring below half its target wake it, but only take its
+*      lock if it is actually asleep; a wake-up lost to that race costs at
+*      most one FILL_PERIOD_NS.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "model.h"
+#include "cache.h"
+
+#define MAX_CACHED_LENGTHS 32
+#define MAX_CACHED_WORDS 1000  // longer sentences are left to the caller, as is their deep search
+#define FILL_CHUNK 64  // sentences generated per length per round, so that every length progresses
+#define MIN_TARGET 4  // sentences kept for any length that has been asked for
+#define FILL_PERIOD_NS 10000000  // longest sleep of the filling thread
+#define DEMAND_PERIOD_NS 100000000  // how often request counts are folded into demand
+#define DEMAND_DECAY 0.75  // weight of the previous demand at each fold
+#define IDLE_DEMAND 0.01  // demand below which a slot may be reclaimed for a length turned away
+#define RETIRING -1  // length of a slot being reclaimed
+
+/*  Struct: CacheCell
+*   -----------------
+*   One position of a ring.  The cell at position pos is free for the push at pos when its
+*   sequence equals pos, and holds that push's sentence when its sequence equals pos + 1.
+*/
+typedef struct CacheCell {
+    size_t sequence;
+    char* sentence;
+} CacheCell;
+
+/*  Struct: CachedLength
+*   --------------------
+*   The ring and demand of one sentence length.  Fields marked atomic are shared with
+*   callers; the rest belong to the filling thread.
+*/
+typedef struct CachedLength {
+    int length;  // atomic, 0 while the slot is unclaimed, RETIRING while it is reclaimed
+    int n_users;  // atomic, callers between pin_length and unpin_length
+    bool ready;  // atomic, set once cells is allocated
+    bool impossible;  // atomic, set if no sentence of this length exists
+    size_t push_pos;  // atomic
+    size_t pop_pos;  // atomic
+    size_t target;  // atomic, sentences the filling thread aims to keep
+    unsigned long requests;  // atomic, requests since the last demand fold
+    CacheCell* cells;
+    size_t mask;  // number of cells - 1
+    uint64_t* reachable;  // find_reachable table for length
+    double demand;  // decayed requests per DEMAND_PERIOD_NS
+} CachedLength;
+
+/*  Struct: SentenceCache
+*   ---------------------
+*   The length table and the filling thread.
+*/
+struct SentenceCache {
+    Model* model;
+    int capacity;
+    CachedLength lengths[MAX_CACHED_LENGTHS];
+    pthread_t filler;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool sleeping;  // atomic, set while the filling thread waits on wake
+    bool turned_away;  // atomic, set when a length found every slot taken
+    bool stopping;  // guarded by lock
+    long long last_fold;  // CLOCK_MONOTONIC nanoseconds of the last demand fold
+};
+
+
+//  -------Function prototypes-------
+CachedLength* find_length(SentenceCache* cache, int length);
+CachedLength* pin_length(CachedLength* slot, int length);
+void unpin_length(CachedLength* slot);
+void reclaim_idle_lengths(SentenceCache* cache);
+void* fill_cache(void* cache_ptr);
+bool fill_round(SentenceCache* cache);
+void fold_demand(SentenceCache* cache);
+bool push_sentence(CachedLength* slot, char* sentence);
+char* pop_sentence(CachedLength* slot);
+void wake_filler(SentenceCache* cache);
+long long cache_clock();
+//  ---------------------------------
+
+
+/*  Function: create_sentence_cache
+*   -------------------------------
+*   Allocates the cache with every slot unclaimed and starts the filling thread.
+*/
+SentenceCache* create_sentence_cache(Model* model, int capacity) {
+    SentenceCache* cache = calloc(1, sizeof(SentenceCache));
+    cache->model = model;
+    cache->capacity = capacity < MIN_TARGET ? MIN_TARGET : capacity;
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+    cache->last_fold = cache_clock();
+    if (pthread_create(&cache->filler, NULL, fill_cache, cache)) {
+        printf("Could not start sentence cache thread.\n");
+        exit(1);
+    }
+    return cache;
+}
+
+/*  Function: take_cached_sentence
+*   ------------------------------
+*   Counts the request against its length's slot, then answers from the slot if it is ready:
+*   NULL for an impossible length, or the next sentence in the ring.  Wakes the filling thread
+*   if the ring is running low.  The slot is pinned throughout, so it cannot be reclaimed.
+*/
+bool take_cached_sentence(SentenceCache* cache, int length, char** sentence) {
+    CachedLength* slot = find_length(cache, length);
+    if (!slot) return false;
+    __atomic_fetch_add(&slot->requests, 1, __ATOMIC_RELAXED);
+    bool answered = false;
+    if (!__atomic_load_n(&slot->ready, __ATOMIC_ACQUIRE)) wake_filler(cache);
+    else if (__atomic_load_n(&slot->impossible, __ATOMIC_ACQUIRE)) {
+        *sentence = NULL;
+        answered = true;
+    } else {
+        *sentence = pop_sentence(slot);
+        size_t held = __atomic_load_n(&slot->push_pos, __ATOMIC_RELAXED) - __atomic_load_n(&slot->pop_pos, __ATOMIC_RELAXED);
+        if (2 * held < __atomic_load_n(&slot->target, __ATOMIC_RELAXED)) wake_filler(cache);
+        answered = *sentence != NULL;
+    }
+    unpin_length(slot);
+    return answered;
+}
+
+/*  Function: free_sentence_cache
+*   -----------------------------
+*   Stops and joins the filling thread, then frees what is left in the rings.
+*/
+void free_sentence_cache(SentenceCache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    cache->stopping = true;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_join(cache->filler, NULL);
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) {
+        CachedLength* slot = cache->lengths + i;
+        if (!slot->cells) continue;
+        char* sentence;
+        while ((sentence = pop_sentence(slot))) free(sentence);
+        free(slot->cells);
+        free(slot->reachable);
+    }
+    pthread_cond_destroy(&cache->wake);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+/*  Function: find_length
+*   ---------------------
+*   Returns the slot for length, pinned for the caller, claiming the first unclaimed slot if
+*   length has none.  Returns NULL if length is not between 1 and MAX_CACHED_WORDS, or if every
+*   slot belongs to another length, in which case the filling thread is told that a length was
+*   turned away.  Two callers may claim slots for the same length at once; the spare slot then
+*   loses its demand and is reclaimed.
+*/
+CachedLength* find_length(SentenceCache* cache, int length) {
+    if (length < 1 || length > MAX_CACHED_WORDS) return NULL;
+    CachedLength* unclaimed = NULL;
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) {
+        CachedLength* slot = cache->lengths + i;
+        int claimed = __atomic_load_n(&slot->length, __ATOMIC_ACQUIRE);
+        if (claimed == length && pin_length(slot, length)) return slot;
+        if (!claimed && !unclaimed) unclaimed = slot;
+    }
+    int expected = 0;
+    if (unclaimed && pin_length(unclaimed, 0)) {
+        if (__atomic_compare_exchange_n(&unclaimed->length, &expected, length, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            wake_filler(cache);
+            return unclaimed;
+        }
+        unpin_length(unclaimed);
+    }
+    __atomic_store_n(&cache->turned_away, true, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/*  Function: pin_length / unpin_length
+*   -----------------------------------
+*   pin_length counts the caller as a user of the slot, then checks that the slot still has
+*   the given length, returning the slot if so and NULL (unpinned again) if not.  unpin_length
+*   ends a successful pin.  Both sides of the handshake with reclaim_idle_lengths are
+*   sequentially consistent, so either the caller sees the slot retiring or the filling thread
+*   sees the caller.
+*/
+CachedLength* pin_length(CachedLength* slot, int length) {
+    __atomic_fetch_add(&slot->n_users, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&slot->length, __ATOMIC_SEQ_CST) == length) return slot;
+    unpin_length(slot);
+    return NULL;
+}
+
+void unpin_length(CachedLength* slot) {
+    __atomic_fetch_sub(&slot->n_users, 1, __ATOMIC_RELEASE);
+}
+
+/*  Function: fill_cache
+*   --------------------
+*   Body of the filling thread.  Runs fill rounds until one finds nothing to do, then sleeps
+*   until woken or for FILL_PERIOD_NS, whichever comes first.
+*/
+void* fill_cache(void* cache_ptr) {
+    SentenceCache* cache = cache_ptr;
+    pthread_mutex_lock(&cache->lock);
+    while (!cache->stopping) {
+        pthread_mutex_unlock(&cache->lock);
+        bool filled = fill_round(cache);
+        pthread_mutex_lock(&cache->lock);
+        if (filled || cache->stopping) continue;
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += FILL_PERIOD_NS;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        __atomic_store_n(&cache->sleeping, true, __ATOMIC_RELEASE);
+        pthread_cond_timedwait(&cache->wake, &cache->lock, &until);
+        __atomic_store_n(&cache->sleeping, false, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return NULL;
+}
+
+/*  Function: fill_round
+*   --------------------
+*   Readies newly claimed slots, folds demand if a period has passed, reclaiming idle slots
+*   if a length was turned away since the last fold, and tops up each ring by at most
+*   FILL_CHUNK sentences towards its target: the capacity shared out by demand, but never
+*   below MIN_TARGET or above the ring's size.  A length for which no sentence can be
+*   sampled is marked impossible, and a retiring slot is left alone.  Returns true if any
+*   sentence was made.
+*/
+bool fill_round(SentenceCache* cache) {
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) {
+        CachedLength* slot = cache->lengths + i;
+        if (__atomic_load_n(&slot->length, __ATOMIC_ACQUIRE) < 1 || slot->cells) continue;
+        size_t n_cells = 1;
+        while (n_cells < (size_t)cache->capacity) n_cells *= 2;
+        slot->cells = malloc(n_cells * sizeof(CacheCell));
+        for (size_t j = 0; j < n_cells; j++) slot->cells[j].sequence = j;
+        slot->mask = n_cells - 1;
+        slot->reachable = find_reachable(cache->model, slot->length);
+        slot->demand = __atomic_exchange_n(&slot->requests, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->ready, true, __ATOMIC_RELEASE);
+    }
+    if (cache_clock() - cache->last_fold >= DEMAND_PERIOD_NS) {
+        fold_demand(cache);
+        if (__atomic_exchange_n(&cache->turned_away, false, __ATOMIC_RELAXED)) reclaim_idle_lengths(cache);
+    }
+    double total_demand = 0;
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) total_demand += cache->lengths[i].demand;
+    bool filled = false;
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) {
+        CachedLength* slot = cache->lengths + i;
+        if (!slot->cells || __atomic_load_n(&slot->impossible, __ATOMIC_RELAXED)) continue;
+        int length = __atomic_load_n(&slot->length, __ATOMIC_ACQUIRE);
+        if (length == RETIRING) continue;
+        size_t target = total_demand > 0 ? (size_t)(cache->capacity * slot->demand / total_demand) : 0;
+        if (target < MIN_TARGET) target = MIN_TARGET;
+        if (target > slot->mask + 1) target = slot->mask + 1;
+        __atomic_store_n(&slot->target, target, __ATOMIC_RELAXED);
+        size_t held = __atomic_load_n(&slot->push_pos, __ATOMIC_RELAXED) - __atomic_load_n(&slot->pop_pos, __ATOMIC_RELAXED);
+        if (held >= target) continue;
+        int n = target - held < FILL_CHUNK ? (int)(target - held) : FILL_CHUNK;
+        for (int j = 0; j < n; j++) {
+            char* sentence = sample_sentence(cache->model, length, slot->reachable);
+            if (!sentence) {
+                __atomic_store_n(&slot->impossible, true, __ATOMIC_RELEASE);
+                break;
+            }
+            if (!push_sentence(slot, sentence)) free(sentence);
+            filled = true;
+        }
+    }
+    return filled;
+}
+
+/*  Function: fold_demand
+*   ---------------------
+*   Decays each ready slot's demand and adds the requests it received since the last fold.
+*/
+void fold_demand(SentenceCache* cache) {
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) {
+        CachedLength* slot = cache->lengths + i;
+        if (!slot->cells) continue;
+        unsigned long requests = __atomic_exchange_n(&slot->requests, 0, __ATOMIC_RELAXED);
+        slot->demand = DEMAND_DECAY * slot->demand + (1 - DEMAND_DECAY) * requests;
+    }
+    cache->last_fold = cache_clock();
+}
+
+/*  Function: reclaim_idle_lengths
+*   ------------------------------
+*   Retires every ready slot whose demand has fallen below IDLE_DEMAND and, once no caller
+*   has it pinned, frees its ring and table and returns it to the unclaimed state.  A slot
+*   still pinned stays retiring, and is finished here on a later call.
+*/
+void reclaim_idle_lengths(SentenceCache* cache) {
+    for (int i = 0; i < MAX_CACHED_LENGTHS; i++) {
+        CachedLength* slot = cache->lengths + i;
+        int length = __atomic_load_n(&slot->length, __ATOMIC_ACQUIRE);
+        if (length != RETIRING && (!slot->cells || slot->demand >= IDLE_DEMAND
+            || !__atomic_compare_exchange_n(&slot->length, &length, RETIRING, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))) continue;
+        if (__atomic_load_n(&slot->n_users, __ATOMIC_SEQ_CST)) {
+            __atomic_store_n(&cache->turned_away, true, __ATOMIC_RELAXED);  // finish on the next fold
+            continue;
+        }
+        char* sentence;
+        while ((sentence = pop_sentence(slot))) free(sentence);
+        free(slot->cells);
+        free(slot->reachable);
+        slot->cells = NULL;
+        slot->reachable = NULL;
+        slot->demand = 0;
+        __atomic_store_n(&slot->ready, false, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->impossible, false, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->push_pos, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->pop_pos, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->target, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->requests, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->length, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/*  Function: push_sentence
+*   -----------------------
+*   Claims the next push position whose cell is free and stores sentence there.  Returns
+*   false if the ring is full.
+*/
+bool push_sentence(CachedLength* slot, char* sentence) {
+    size_t pos = __atomic_load_n(&slot->push_pos, __ATOMIC_RELAXED);
+    while (true) {
+        CacheCell* cell = slot->cells + (pos & slot->mask);
+        intptr_t lag = (intptr_t)__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (intptr_t)pos;
+        if (lag < 0) return false;  // the cell still holds the sentence from a lap ago
+        if (lag > 0) pos = __atomic_load_n(&slot->push_pos, __ATOMIC_RELAXED);
+        else if (__atomic_compare_exchange_n(&slot->push_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            cell->sentence = sentence;
+            __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+}
+
+/*  Function: pop_sentence
+*   ----------------------
+*   Claims the next pop position whose cell holds a sentence, frees the cell for the push one
+*   lap later, and returns the sentence.  Returns NULL if the ring is empty.
+*/
+char* pop_sentence(CachedLength* slot) {
+    size_t pos = __atomic_load_n(&slot->pop_pos, __ATOMIC_RELAXED);
+    while (true) {
+        CacheCell* cell = slot->cells + (pos & slot->mask);
+        intptr_t lag = (intptr_t)__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (intptr_t)(pos + 1);
+        if (lag < 0) return NULL;  // nothing pushed here yet
+        if (lag > 0) pos = __atomic_load_n(&slot->pop_pos, __ATOMIC_RELAXED);
+        else if (__atomic_compare_exchange_n(&slot->pop_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            char* sentence = cell->sentence;
+            __atomic_store_n(&cell->sequence, pos + slot->mask + 1, __ATOMIC_RELEASE);
+            return sentence;
+        }
+    }
+}
+
+/*  Function: wake_filler
+*   ---------------------
+*   Signals the filling thread if it is asleep.
+*/
+void wake_filler(SentenceCache* cache) {
+    if (!__atomic_load_n(&cache->sleeping, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&cache->lock);
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*  Function: cache_clock
+*   ---------------------
+*   Returns the CLOCK_MONOTONIC time in nanoseconds.
+*/
+long long cache_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
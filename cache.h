@@ -0,0 +1,46 @@
+/*  cache.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Pregenerated sentences for one model, kept per sentence length and refilled
+*   by a background thread.  Used by model.c for enable_sentence_cache;
+*   include model.h and stdbool.h first.
+*/
+
+/*  Struct: SentenceCache
+*   ---------------------
+*   Reference to a running sentence cache.
+*/
+typedef struct SentenceCache SentenceCache;
+
+/*  Function: create_sentence_cache
+*   -------------------------------
+*   Starts a thread that keeps about capacity sentences from model ready,
+*   shared among the lengths asked for in proportion to recent demand.  Up to
+*   32 lengths are cached at once; lengths no longer asked for give up their
+*   place to new ones.  The model must not change while the cache exists.
+*/
+SentenceCache* create_sentence_cache(Model* model, int capacity);
+
+/*  Function: take_cached_sentence
+*   ------------------------------
+*   Records a request for a sentence of length words and returns true if the
+*   cache can answer it at once: with a ready sentence, which the caller then
+*   owns, or with NULL if the cache has found that no such sentence exists.
+*   Returns false if the caller has to generate the sentence itself.  Never
+*   blocks; safe to call from several threads at once.
+*/
+bool take_cached_sentence(SentenceCache* cache, int length, char** sentence);
+
+/*  Function: free_sentence_cache
+*   -----------------------------
+*   Stops the thread and frees the cache and every sentence still in it.
+*/
+void free_sentence_cache(SentenceCache* cache);
+
+/*  Function: sample_sentence
+*   -------------------------
+*   Provided by model.c.  Makes a sentence of length words from a table made by
+*   find_reachable, or returns NULL if there is none.
+*/
+char* sample_sentence(Model* model, int length, uint64_t reachable[]);
@@ -0,0 +1,134 @@
+/*  enumerate_sentences.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "model.h"
+#include "enumerator.h"
+
+/*	Struct: Range
+*	-------------
+*	One thread's share of the sentences.
+*/
+typedef struct Range {
+	EnumerationCursor* cursor;
+	pthread_t thread;
+} Range;
+
+//  -------Function prototypes-------
+bool print_sentence(const char* sentence, void* arg);
+void* print_range(void* range_ptr);
+//  ---------------------------------
+
+/*	Function: main
+*	--------------
+*	Invocation: enumerate_sentences [-m] [-c] [-t threads] source n_words_in_sentence
+*	            enumerate_sentences [-m] [-n max_sentences] [-s cursor] source n_words_in_sentence
+*	Creates the model from the source text, or loads the model file written by build_model
+*	with -m, and prints every sentence of the given length it can make, one per line, or with
+*	-c only how many there are.  With -t, the sentences are split among threads threads and
+*	come out in no particular order.  With -n, printing stops after max_sentences, and a
+*	cursor from which to carry on is printed to stderr; -s carries on from such a cursor.
+*/
+int main(int argc, char* argv[]) {
+	bool model_file = false, count_only = false;
+	int n_threads = 1;
+	long max_sentences = 0;
+	char* saved = NULL;
+	int opt;
+	bool valid = true;
+	while ((opt = getopt(argc, argv, "mct:n:s:")) != -1) {
+		if (opt == 'm') model_file = true;
+		else if (opt == 'c') count_only = true;
+		else if (opt == 't') valid = valid && sscanf(optarg, "%d", &n_threads) == 1 && n_threads > 0;
+		else if (opt == 'n') valid = valid && sscanf(optarg, "%ld", &max_sentences) == 1 && max_sentences > 0;
+		else if (opt == 's') saved = optarg;
+		else valid = false;
+	}
+	int n_words = 0;
+	if (argc - optind != 2 || sscanf(argv[optind + 1], "%d", &n_words) != 1 || n_words < 1) valid = false;
+	if (!valid || (n_threads > 1 && (max_sentences || saved))) {
+		printf("Please invoke as: enumerate_sentences [-m] [-c] [-t threads] source n_words_in_sentence\n");
+		printf("               or enumerate_sentences [-m] [-n max_sentences] [-s cursor] source n_words_in_sentence\n");
+		exit(1);
+	}
+	Model* model;
+	if (model_file) {
+		model = load_model(argv[optind]);
+		if (!model) {
+			printf("Model could not be loaded from %s.\n", argv[optind]);
+			exit(1);
+		}
+	} else {
+		FILE* text = fopen(argv[optind], "r");
+		if (!text) {
+			printf("File could not be opened.\n");
+			exit(1);
+		}
+		model = create_model(text);
+		fclose(text);
+	}
+	Enumerator* enumerator = create_enumerator(model, n_words);
+	if (count_only) {
+		uint64_t count = count_sentences(enumerator);
+		if (count == UINT64_MAX) printf("At least %llu sentences of %d words.\n", (unsigned long long)count, n_words);
+		else printf("%llu sentences of %d words.\n", (unsigned long long)count, n_words);
+	} else if (n_threads > 1) {
+		Range ranges[n_threads];
+		EnumerationCursor* cursors[n_threads];
+		split_enumeration(enumerator, n_threads, cursors);
+		for (int i = 0; i < n_threads; i++) {
+			ranges[i].cursor = cursors[i];
+			if (pthread_create(&ranges[i].thread, NULL, print_range, &ranges[i])) {
+				printf("Could not start enumeration thread.\n");
+				exit(1);
+			}
+		}
+		for (int i = 0; i < n_threads; i++) {
+			pthread_join(ranges[i].thread, NULL);
+			free_cursor(cursors[i]);
+		}
+	} else {
+		EnumerationCursor* cursor = saved ? load_cursor(enumerator, saved) : start_enumeration(enumerator);
+		if (!cursor) {
+			printf("Cursor could not be read for this model and length.\n");
+			exit(1);
+		}
+		enumerate_sentences(cursor, max_sentences, print_sentence, NULL);
+		if (!enumeration_finished(cursor)) {
+			char* resume = save_cursor(cursor);
+			fprintf(stderr, "Resume with: -s '%s'\n", resume);
+			free(resume);
+		}
+		free_cursor(cursor);
+	}
+	free_enumerator(enumerator);
+	free_allocated(model);
+	return 0;
+}
+
+/*	Function: print_sentence
+*	------------------------
+*	SentenceVisitor that prints the sentence on a line of its own, in one call so that lines
+*	from several threads do not mix.
+*/
+bool print_sentence(const char* sentence, void* arg) {
+	printf("%s\n", sentence);
+	return true;
+}
+
+/*	Function: print_range
+*	---------------------
+*	Thread function that prints every sentence in the range.
+*/
+void* print_range(void* range_ptr) {
+	Range* range = range_ptr;
+	enumerate_sentences(range->cursor, 0, print_sentence, NULL);
+	return NULL;
+}
@@ -0,0 +1,436 @@
+/*  enumerator.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: lists the distinct sentences of one length that a model can make,
+*   ordered by the indices of their words, without ever building the list.  A
+*   table counts the sentences that can be finished from each word in each
+*   number of steps, which lets the enumeration skip every branch that holds no
+*   sentence and find the sentence at any rank directly.
+*   -------------------------
+*   Design choices & notes:
+*    - The counts saturate at UINT64_MAX rather than wrapping.  Ranges split at
+*      ranks found from saturated counts are still disjoint and cover every
+*      sentence, they are just no longer of equal size.
+*    - A cursor is the word indices of its next sentence and of the end of its
+*      range.  Only those are saved; loading a cursor finds each word's
+*      position in its list again, which also checks that the sentences are
+*      ones the enumerator lists.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "enumerator.h"
+
+/*  Struct: EnumeratorImplementation
+*   ---------------------------------
+*   Each word's distinct successors and the distinct starting words, in ascending order of
+*   index, which is the order in which sentences are listed, and a table of how many
+*   sentences can be finished from each word.  Row k, column w of the table counts the
+*   distinct ways to reach a sentence ender from word w in exactly k more words, stopping at
+*   UINT64_MAX.
+*/
+struct EnumeratorImplementation {
+    Model* model;
+    int length;
+    int n_w;
+    int* n_next;  // parallel to the model's words, number of distinct successors
+    int** next;  // parallel to the model's words, the distinct successors
+    int* links;  // storage for every next array
+    int n_starts;
+    int* starts;
+    uint64_t* counts;  // length rows of n_w entries
+};
+
+/*  Struct: EnumerationCursorImplementation
+*   ---------------------------------------
+*   The next sentence to list, as the index of each of its words and the position of each in
+*   the list it was chosen from, and the first sentence past the end of the range.
+*/
+struct EnumerationCursorImplementation {
+    Enumerator* enumerator;
+    bool finished;
+    int* path;  // words of the next sentence
+    int* choices;  // position of each word of path in the list it came from
+    int* end;  // words of the first sentence after the range, or NULL to run to the end
+    char* text;  // the sentence being passed to a visitor
+};
+
+
+//  -------Function prototypes-------
+int* collect_distinct(int entries[], int n_entries, int* n_distinct, int storage[]);
+uint64_t sum_counts(int entries[], int n_entries, uint64_t row[]);
+EnumerationCursor* create_cursor(Enumerator* enumerator);
+int* enumeration_list(Enumerator* enumerator, int path[], int index, int* n_entries);
+bool rank_sentence(Enumerator* enumerator, uint64_t rank, int path[], int choices[]);
+void fill_first_sentence(Enumerator* enumerator, int path[], int choices[], int from);
+bool advance_cursor(EnumerationCursor* cursor);
+bool before_end(EnumerationCursor* cursor);
+void write_path(EnumerationCursor* cursor);
+bool read_path(Enumerator* enumerator, const char** saved, int path[], int choices[]);
+int find_position(int entries[], int n_entries, int word);
+//  ---------------------------------
+
+
+/*  Function: create_enumerator
+*   ---------------------------
+*   Sorts and deduplicates every successor list and the starting words, then fills in the
+*   counts a row at a time, as find_reachable does, adding up instead of or-ing.
+*/
+Enumerator* create_enumerator(Model* model, int length) {
+    if (length < 1) return NULL;
+    int n_w = model->n_w;
+    Enumerator* enumerator = malloc(sizeof(Enumerator));
+    enumerator->model = model;
+    enumerator->length = length;
+    enumerator->n_w = n_w;
+    enumerator->n_next = malloc((n_w + 1) * sizeof(int));
+    enumerator->next = malloc((n_w + 1) * sizeof(int*));
+    long n_links = 0;
+    for (int w = 0; w < n_w; w++) n_links += model->words[w].n_nw;
+    enumerator->links = malloc((n_links + 1) * sizeof(int));
+    int* storage = enumerator->links;
+    for (int w = 0; w < n_w; w++) {
+        Word* word = model->words + w;
+        enumerator->next[w] = storage;
+        storage = collect_distinct(word->next_words, word->n_nw, enumerator->n_next + w, storage);
+    }
+    enumerator->starts = malloc((model->n_ssw + 1) * sizeof(int));
+    collect_distinct(model->sentence_starting_words, model->n_ssw, &enumerator->n_starts, enumerator->starts);
+    uint64_t* counts = malloc(((size_t)length * n_w + 1) * sizeof(uint64_t));
+    for (int w = 0; w < n_w; w++) counts[w] = model->words[w].is_sentence_ender;
+    for (int k = 1; k < length; k++) {
+        uint64_t* row = counts + (size_t)k * n_w;
+        for (int w = 0; w < n_w; w++) row[w] = sum_counts(enumerator->next[w], enumerator->n_next[w], row - n_w);
+    }
+    enumerator->counts = counts;
+    return enumerator;
+}
+
+/*  Function: collect_distinct
+*   --------------------------
+*   Copies the entries into storage, sorts them and drops repeats, storing how many are
+*   left in n_distinct.  Returns the first int of storage after them.
+*/
+int* collect_distinct(int entries[], int n_entries, int* n_distinct, int storage[]) {
+    memcpy(storage, entries, n_entries * sizeof(int));
+    qsort(storage, n_entries, sizeof(int), compare_ints);
+    int n = 0;
+    for (int i = 0; i < n_entries; i++) {
+        if (!n || storage[i] != storage[n - 1]) storage[n++] = storage[i];
+    }
+    *n_distinct = n;
+    return storage + n;
+}
+
+/*  Function: sum_counts
+*   --------------------
+*   Returns the total count in row of the entries, stopping at UINT64_MAX.
+*/
+uint64_t sum_counts(int entries[], int n_entries, uint64_t row[]) {
+    uint64_t sum = 0;
+    for (int i = 0; i < n_entries; i++) {
+        if (__builtin_add_overflow(sum, row[entries[i]], &sum)) return UINT64_MAX;
+    }
+    return sum;
+}
+
+/*  Function: count_sentences
+*   -------------------------
+*   Totals the last row of the table over the starting words.
+*/
+uint64_t count_sentences(Enumerator* enumerator) {
+    uint64_t* last_row = enumerator->counts + (size_t)(enumerator->length - 1) * enumerator->n_w;
+    return sum_counts(enumerator->starts, enumerator->n_starts, last_row);
+}
+
+/*  Function: start_enumeration
+*   ---------------------------
+*   Makes a cursor at the first sentence with no end, or a finished one if there is none.
+*/
+EnumerationCursor* start_enumeration(Enumerator* enumerator) {
+    EnumerationCursor* cursor = create_cursor(enumerator);
+    cursor->finished = !rank_sentence(enumerator, 0, cursor->path, cursor->choices);
+    return cursor;
+}
+
+/*  Function: split_enumeration
+*   ---------------------------
+*   Cuts the sentences at ranks spaced evenly through the count, finding the sentence at
+*   each rank with rank_sentence.  Each range starts at one cut and ends at the next.  When
+*   the count has stopped at UINT64_MAX, the cuts still come in order, so the ranges are
+*   still disjoint and cover everything, only uneven.
+*/
+void split_enumeration(Enumerator* enumerator, int n_ranges, EnumerationCursor* cursors[]) {
+    uint64_t total = count_sentences(enumerator);
+    for (int i = 0; i < n_ranges; i++) {
+        uint64_t rank = total / n_ranges * i + total % n_ranges * i / n_ranges;
+        cursors[i] = create_cursor(enumerator);
+        cursors[i]->finished = !rank_sentence(enumerator, rank, cursors[i]->path, cursors[i]->choices);
+    }
+    for (int i = 0; i + 1 < n_ranges; i++) {
+        if (cursors[i + 1]->finished) continue;
+        cursors[i]->end = malloc(enumerator->length * sizeof(int));
+        memcpy(cursors[i]->end, cursors[i + 1]->path, enumerator->length * sizeof(int));
+        if (!cursors[i]->finished) cursors[i]->finished = !before_end(cursors[i]);
+    }
+}
+
+/*  Function: create_cursor
+*   -----------------------
+*   Allocates a cursor with no end, its path not yet filled in, and a buffer long enough for
+*   any sentence.
+*/
+EnumerationCursor* create_cursor(Enumerator* enumerator) {
+    EnumerationCursor* cursor = calloc(1, sizeof(EnumerationCursor));
+    cursor->enumerator = enumerator;
+    cursor->path = malloc(enumerator->length * sizeof(int));
+    cursor->choices = malloc(enumerator->length * sizeof(int));
+    cursor->text = malloc((size_t)enumerator->length * (MAX_WORD_LENGTH + 1) + 1);
+    return cursor;
+}
+
+/*  Function: enumeration_list
+*   --------------------------
+*   Returns the list that word index of a sentence is chosen from, given the words before
+*   it in path: the starting words, or the previous word's successors.
+*/
+int* enumeration_list(Enumerator* enumerator, int path[], int index, int* n_entries) {
+    if (index == 0) {
+        *n_entries = enumerator->n_starts;
+        return enumerator->starts;
+    }
+    *n_entries = enumerator->n_next[path[index - 1]];
+    return enumerator->next[path[index - 1]];
+}
+
+/*  Function: rank_sentence
+*   -----------------------
+*   Fills path and choices with the sentence that has the given rank, counting from 0, by
+*   skipping past whole branches at each word: each entry of the list is passed over if the
+*   rank is at least the number of sentences it leads to, which is taken from the rank.
+*   Returns false if there are no more than rank sentences.
+*/
+bool rank_sentence(Enumerator* enumerator, uint64_t rank, int path[], int choices[]) {
+    int length = enumerator->length;
+    if (rank >= count_sentences(enumerator)) return false;
+    for (int i = 0; i < length; i++) {
+        uint64_t* row = enumerator->counts + (size_t)(length - 1 - i) * enumerator->n_w;
+        int n_entries;
+        int* entries = enumeration_list(enumerator, path, i, &n_entries);
+        int j = 0;
+        while (j < n_entries - 1 && rank >= row[entries[j]]) rank -= row[entries[j++]];
+        path[i] = entries[j];
+        choices[i] = j;
+    }
+    return true;
+}
+
+/*  Function: fill_first_sentence
+*   -----------------------------
+*   Fills path and choices from index from on with the first words that can still end the
+*   sentence on time.  The word before from must be able to, so each list has one.
+*/
+void fill_first_sentence(Enumerator* enumerator, int path[], int choices[], int from) {
+    int length = enumerator->length;
+    for (int i = from; i < length; i++) {
+        uint64_t* row = enumerator->counts + (size_t)(length - 1 - i) * enumerator->n_w;
+        int n_entries;
+        int* entries = enumeration_list(enumerator, path, i, &n_entries);
+        int j = 0;
+        while (!row[entries[j]]) j++;
+        path[i] = entries[j];
+        choices[i] = j;
+    }
+}
+
+/*  Function: enumerate_sentences
+*   -----------------------------
+*   Passes the cursor's sentence on and advances, until a stop condition is met.
+*/
+long enumerate_sentences(EnumerationCursor* cursor, long max_sentences, SentenceVisitor visitor, void* arg) {
+    long n_passed = 0;
+    while (!cursor->finished && (max_sentences <= 0 || n_passed < max_sentences)) {
+        write_path(cursor);
+        n_passed++;
+        cursor->finished = !advance_cursor(cursor) || !before_end(cursor);
+        if (!visitor(cursor->text, arg)) break;
+    }
+    return n_passed;
+}
+
+/*  Function: advance_cursor
+*   ------------------------
+*   Moves the cursor to the next sentence: finds the last word that has a later entry in its
+*   list that can still end the sentence on time, takes that entry, and fills the rest of
+*   the sentence with first choices.  Returns false if every word is at its last entry.
+*/
+bool advance_cursor(EnumerationCursor* cursor) {
+    Enumerator* enumerator = cursor->enumerator;
+    int length = enumerator->length;
+    for (int i = length - 1; i >= 0; i--) {
+        uint64_t* row = enumerator->counts + (size_t)(length - 1 - i) * enumerator->n_w;
+        int n_entries;
+        int* entries = enumeration_list(enumerator, cursor->path, i, &n_entries);
+        for (int j = cursor->choices[i] + 1; j < n_entries; j++) {
+            if (!row[entries[j]]) continue;
+            cursor->path[i] = entries[j];
+            cursor->choices[i] = j;
+            fill_first_sentence(enumerator, cursor->path, cursor->choices, i + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*  Function: before_end
+*   --------------------
+*   Returns true if the cursor's sentence comes before the end of its range.  Lists are in
+*   ascending order of index, so sentences compare as their words' indices do.
+*/
+bool before_end(EnumerationCursor* cursor) {
+    if (!cursor->end) return true;
+    for (int i = 0; i < cursor->enumerator->length; i++) {
+        if (cursor->path[i] != cursor->end[i]) return cursor->path[i] < cursor->end[i];
+    }
+    return false;
+}
+
+/*  Function: write_path
+*   --------------------
+*   Writes the cursor's sentence into its buffer, formatted as combine_words formats one.
+*/
+void write_path(EnumerationCursor* cursor) {
+    Word* words = cursor->enumerator->model->words;
+    char* text = cursor->text;
+    for (int i = 0; i < cursor->enumerator->length; i++) {
+        if (i) *text++ = ' ';
+        text = stpcpy(text, words[cursor->path[i]].string);
+    }
+    strcpy(text, ".");
+    *cursor->text = toupper(*cursor->text);
+}
+
+/*  Function: enumeration_finished
+*   ------------------------------
+*   Reads the cursor's flag.
+*/
+bool enumeration_finished(EnumerationCursor* cursor) {
+    return cursor->finished;
+}
+
+/*  Function: save_cursor
+*   ---------------------
+*   Writes "enum", the length and the number of words in the model, then "done" for a
+*   finished cursor, or else the word indices of the next sentence and of the end, or "-"
+*   if it has none, each list joined by commas.
+*/
+char* save_cursor(EnumerationCursor* cursor) {
+    Enumerator* enumerator = cursor->enumerator;
+    char* saved;
+    size_t size;
+    FILE* out = open_memstream(&saved, &size);
+    fprintf(out, "enum %d %d", enumerator->length, enumerator->n_w);
+    if (cursor->finished) fprintf(out, " done");
+    else {
+        for (int i = 0; i < enumerator->length; i++) fprintf(out, "%c%d", i ? ',' : ' ', cursor->path[i]);
+        if (!cursor->end) fprintf(out, " -");
+        for (int i = 0; cursor->end && i < enumerator->length; i++) fprintf(out, "%c%d", i ? ',' : ' ', cursor->end[i]);
+    }
+    fclose(out);
+    return saved;
+}
+
+/*  Function: load_cursor
+*   ---------------------
+*   Reads back what save_cursor writes, checking that the header matches the enumerator and
+*   that both sentences are ones it lists.
+*/
+EnumerationCursor* load_cursor(Enumerator* enumerator, const char* saved) {
+    int length, n_w, n_read = 0;
+    if (sscanf(saved, "enum %d %d %n", &length, &n_w, &n_read) != 2 || !n_read) return NULL;
+    if (length != enumerator->length || n_w != enumerator->n_w) return NULL;
+    saved += n_read;
+    EnumerationCursor* cursor = create_cursor(enumerator);
+    if (!strcmp(saved, "done")) {
+        cursor->finished = true;
+        return cursor;
+    }
+    bool valid = read_path(enumerator, &saved, cursor->path, cursor->choices) && *saved++ == ' ';
+    if (valid && strcmp(saved, "-")) {
+        cursor->end = malloc(length * sizeof(int));
+        int* choices = malloc(length * sizeof(int));
+        valid = read_path(enumerator, &saved, cursor->end, choices) && !*saved;
+        free(choices);
+    }
+    if (!valid) {
+        free_cursor(cursor);
+        return NULL;
+    }
+    cursor->finished = !before_end(cursor);
+    return cursor;
+}
+
+/*  Function: read_path
+*   -------------------
+*   Reads a comma-separated sentence of word indices from *saved, advancing it, and fills
+*   path and choices.  Returns false unless every word is in its list and can still end the
+*   sentence on time.
+*/
+bool read_path(Enumerator* enumerator, const char** saved, int path[], int choices[]) {
+    int length = enumerator->length;
+    for (int i = 0; i < length; i++) {
+        int n_read = 0;
+        if (sscanf(*saved, i ? ",%d%n" : "%d%n", &path[i], &n_read) != 1) return false;
+        *saved += n_read;
+        int n_entries;
+        int* entries = enumeration_list(enumerator, path, i, &n_entries);
+        choices[i] = find_position(entries, n_entries, path[i]);
+        if (choices[i] < 0) return false;
+        if (!enumerator->counts[(size_t)(length - 1 - i) * enumerator->n_w + path[i]]) return false;
+    }
+    return true;
+}
+
+/*  Function: find_position
+*   -----------------------
+*   Returns the position of word in the ascending entries, or -1 if it is not there.
+*/
+int find_position(int entries[], int n_entries, int word) {
+    int* found = bsearch(&word, entries, n_entries, sizeof(int), compare_ints);
+    return found ? (int)(found - entries) : -1;
+}
+
+/*  Function: free_cursor
+*   ---------------------
+*   Frees the cursor's arrays and the cursor.
+*/
+void free_cursor(EnumerationCursor* cursor) {
+    free(cursor->path);
+    free(cursor->choices);
+    free(cursor->end);
+    free(cursor->text);
+    free(cursor);
+}
+
+/*  Function: free_enumerator
+*   -------------------------
+*   Frees the lists, the table and the enumerator.
+*/
+void free_enumerator(Enumerator* enumerator) {
+    free(enumerator->n_next);
+    free(enumerator->next);
+    free(enumerator->links);
+    free(enumerator->starts);
+    free(enumerator->counts);
+    free(enumerator);
+}
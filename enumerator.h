@@ -0,0 +1,99 @@
+/*  enumerator.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Listing every sentence of one length that a model can make, in a fixed
+*   order, through cursors that can be split among threads and saved to resume
+*   later.  Include model.h, stdbool.h and stdint.h first.
+*/
+
+/*  Struct: Enumerator
+*   ------------------
+*   Reference to the sentences of one length that a model can make, each listed once
+*   however often its bigrams were seen, in a fixed order.  Made by create_enumerator and
+*   read through cursors; several threads may read one enumerator through their own
+*   cursors at once.  The model must not ingest text while an enumerator exists.
+*/
+typedef struct EnumeratorImplementation Enumerator;
+
+/*  Struct: EnumerationCursor
+*   -------------------------
+*   Reference to a position in an enumerator's sentences, and the end of the range of them
+*   that it covers.  A cursor can be saved as a string and loaded again later, by another
+*   process even, against an enumerator for the same model and length.
+*/
+typedef struct EnumerationCursorImplementation EnumerationCursor;
+
+/*  Type: SentenceVisitor
+*   ---------------------
+*   Called by enumerate_sentences with each sentence, which is only valid during the
+*   call.  Returning false stops the enumeration before the next sentence.
+*/
+typedef bool (*SentenceVisitor)(const char* sentence, void* arg);
+
+/*  Function: create_enumerator
+*   ---------------------------
+*   Prepares to enumerate the sentences of the given length, first counting them for every
+*   word and number of words still to come, so that the enumeration never enters a branch
+*   with no sentence in it.  Uses a table of length 8-byte counts per word in the model.
+*   Returns NULL if length is less than 1.
+*/
+Enumerator* create_enumerator(Model* model, int length);
+
+/*  Function: count_sentences
+*   -------------------------
+*   Returns the number of sentences the enumerator lists, or UINT64_MAX if there are at
+*   least that many.
+*/
+uint64_t count_sentences(Enumerator* enumerator);
+
+/*  Function: start_enumeration
+*   ---------------------------
+*   Returns a cursor at the first sentence that covers every sentence.
+*/
+EnumerationCursor* start_enumeration(Enumerator* enumerator);
+
+/*  Function: split_enumeration
+*   ---------------------------
+*   Fills cursors with n_ranges cursors covering disjoint ranges of the sentences, in order,
+*   that together cover all of them, so that each can be enumerated by its own thread.  The
+*   ranges hold equal numbers of sentences, give or take one, unless there are too many to
+*   count; some may be empty.
+*/
+void split_enumeration(Enumerator* enumerator, int n_ranges, EnumerationCursor* cursors[]);
+
+/*  Function: enumerate_sentences
+*   -----------------------------
+*   Passes the sentences from the cursor's position on to visitor, one at a time, until its
+*   range ends, max_sentences have been passed (if max_sentences is positive), or visitor
+*   returns false, and leaves the cursor after the last sentence passed.  Returns the
+*   number passed.  No list of sentences is ever built.
+*/
+long enumerate_sentences(EnumerationCursor* cursor, long max_sentences, SentenceVisitor visitor, void* arg);
+
+/*  Function: enumeration_finished
+*   ------------------------------
+*   Returns true once the cursor has passed the end of its range.
+*/
+bool enumeration_finished(EnumerationCursor* cursor);
+
+/*  Function: save_cursor
+*   ---------------------
+*   Returns a heap-allocated string, of printable characters with no whitespace other than
+*   spaces, from which load_cursor can restore the cursor.
+*/
+char* save_cursor(EnumerationCursor* cursor);
+
+/*  Function: load_cursor
+*   ---------------------
+*   Restores a cursor saved by save_cursor.  Returns NULL if the string is not a saved
+*   cursor for an enumerator of this length over this model.
+*/
+EnumerationCursor* load_cursor(Enumerator* enumerator, const char* saved);
+
+/*  Function: free_cursor / free_enumerator
+*   ---------------------------------------
+*   Free a cursor, and an enumerator whose cursors have all been freed.
+*/
+void free_cursor(EnumerationCursor* cursor);
+void free_enumerator(Enumerator* enumerator);
@@ -0,0 +1,468 @@
+/*  export.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: writes a model out in full, either as print_model's listing, with
+*   its words sorted and its entries counted on request, or as an edge list of
+*   distinct bigrams for other tools, in JSON Lines, CSV or a packed binary
+*   form.
+*   -------------------------
+*   Design choices & notes:
+*    - Everything goes through an OutputBuffer that is filled by hand, numbers
+*      included, instead of through a printf for every word and successor.
+*    - An export is cut into ranges of words of about the same output size,
+*      formatted into memory streams by a worker pool and written to the file
+*      in order, so a large model is exported at the speed of several cores
+*      without holding the whole output in memory.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "export.h"
+#include "workers.h"
+
+#define OUTPUT_BUFFER_SIZE 65536  // bytes written at a time by write_model
+#define EXPORT_CHUNK_COST 65536  // words plus links in each range exported by one task
+#define EDGE_FILE_MAGIC "BIGEDGES"
+#define EDGE_FILE_VERSION 1
+
+/*  Struct: OutputBuffer
+*   --------------------
+*   Bytes waiting to be written by write_model, which fills the buffer directly instead of
+*   calling printf for every word.
+*/
+typedef struct OutputBuffer {
+    FILE* file;
+    size_t used;  // bytes of data filled
+    bool failed;  // if any write to file fell short
+    char data[OUTPUT_BUFFER_SIZE];
+} OutputBuffer;
+
+/*  Struct: EntryCount
+*   ------------------
+*   One distinct word among repeated entries, with how many times it appears, for writing
+*   successor and starting-word counts.
+*/
+typedef struct EntryCount {
+    int word;
+    int count;
+    const char* string;
+} EntryCount;
+
+/*  Struct: ExportJob
+*   -----------------
+*   What every chunk of one export_model call shares: the model, the format, how often each
+*   word starts a sentence, each word's position among the words not removed, and the lock
+*   and condition under which chunks are marked done.
+*/
+typedef struct ExportJob {
+    Model* model;
+    ExportFormat format;
+    int* starts;  // parallel to the model's words
+    int* renumbered;  // parallel to the model's words, -1 for removed words
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_done;
+} ExportJob;
+
+/*  Struct: ExportChunk
+*   -------------------
+*   A range of words exported by one task, and the bytes it produced.
+*/
+typedef struct ExportChunk {
+    ExportJob* job;
+    int first;  // index of the first word in the range
+    int last;  // index just past the last word in the range
+    char* data;  // the exported range, from open_memstream
+    size_t size;
+    bool failed;  // if the memory stream could not be written
+    bool done;  // guarded by the job's lock
+} ExportChunk;
+
+/*  Struct: EdgeFileHeader
+*   ----------------------
+*   Start of a binary edge list written by export_model.  The header is followed by the
+*   n_words NUL-terminated strings of the vocabulary, zero-padded to strings_size bytes, then
+*   by one {source, target, count} triple of uint32s per distinct bigram until the end of the
+*   file.  Sources and targets are positions in the vocabulary.  Host byte order.
+*/
+typedef struct EdgeFileHeader {
+    char magic[8];  // EDGE_FILE_MAGIC
+    uint32_t version;
+    uint32_t n_words;
+    uint64_t strings_size;
+} EdgeFileHeader;
+
+
+//  -------Function prototypes-------
+void write_entries(OutputBuffer* out, Model* model, int indices[], int n, ModelOrder order, int tally[], EntryCount entries[], char separator);
+int compare_entries_by_count(const void* a, const void* b);
+int compare_entries_alphabetically(const void* a, const void* b);
+void put_string(OutputBuffer* out, const char* string);
+void put_bytes(OutputBuffer* out, const void* bytes, size_t length);
+void put_char(OutputBuffer* out, char c);
+void put_number(OutputBuffer* out, long number);
+void flush_buffer(OutputBuffer* out);
+bool write_export_header(Model* model, FILE* file, ExportFormat format, int n_words, uint64_t strings_size);
+void export_chunk(void* chunk_ptr);
+void put_json_string(OutputBuffer* out, const char* string);
+void put_csv_field(OutputBuffer* out, const char* string);
+//  ---------------------------------
+
+
+/*  Function: write_model
+*   ---------------------
+*   Writes every word in the requested order through an OutputBuffer, followed by the
+*   sentence-starting words.  Words are sorted through an array of pointers, so no Word is
+*   copied.
+*/
+int write_model(Model* model, FILE* file, ModelOrder order, bool show_counts) {
+    OutputBuffer* out = malloc(sizeof(OutputBuffer));
+    out->file = file;
+    out->used = 0;
+    out->failed = false;
+    Word** words = malloc((model->n_w + 1) * sizeof(Word*));
+    int n_words = 0;
+    int max_entries = model->n_ssw;
+    for (int i = 0; i < model->n_w; i++) {
+        if (!model->words[i].string) continue;  // removed from a live model
+        words[n_words++] = model->words + i;
+        if (model->words[i].n_nw > max_entries) max_entries = model->words[i].n_nw;
+    }
+    if (order == ORDER_BY_FREQUENCY) qsort(words, n_words, sizeof(Word*), compare_by_frequency);
+    else if (order == ORDER_ALPHABETICAL) qsort(words, n_words, sizeof(Word*), compare_alphabetically);
+    int* tally = show_counts ? calloc(model->n_w + 1, sizeof(int)) : NULL;
+    EntryCount* entries = show_counts ? malloc((max_entries + 1) * sizeof(EntryCount)) : NULL;
+
+    put_string(out, "----------MODEL----------\n---Model size: ");
+    put_number(out, n_words);
+    put_string(out, " words\n---Words:\n");
+    for (int i = 0; i < n_words; i++) {
+        Word* word = words[i];
+        put_string(out, word->string);
+        put_string(out, " (");
+        put_number(out, word->n_occurrences);
+        put_string(out, word->is_sentence_ender ? ") (se): " : "): ");
+        write_entries(out, model, word->next_words, word->n_nw, order, tally, entries, ' ');
+        put_char(out, '\n');
+    }
+    put_string(out, "---Sentence-starting words (");
+    put_number(out, model->n_ssw);
+    put_string(out, "):\n");
+    write_entries(out, model, model->sentence_starting_words, model->n_ssw, order, tally, entries, '\n');
+    put_string(out, "---------------------------\n");
+    flush_buffer(out);
+    int result = (out->failed || fflush(file) != 0) ? -1 : 0;
+    free(entries);
+    free(tally);
+    free(words);
+    free(out);
+    return result;
+}
+
+/*  Function: write_entries
+*   -----------------------
+*   Writes the words at the given indices, each followed by separator.  Without a tally they
+*   are written as stored, once per entry.  With one, each distinct word is written once with
+*   its number of entries, in order of first appearance, by count or alphabetically; tally
+*   holds a zero for every word of the model and is left that way.
+*/
+void write_entries(OutputBuffer* out, Model* model, int indices[], int n, ModelOrder order, int tally[], EntryCount entries[], char separator) {
+    if (!tally) {
+        for (int i = 0; i < n; i++) {
+            put_string(out, model->words[indices[i]].string);
+            put_char(out, separator);
+        }
+        return;
+    }
+    int n_distinct = 0;
+    for (int i = 0; i < n; i++) {
+        if (tally[indices[i]]++ == 0) entries[n_distinct++].word = indices[i];
+    }
+    for (int i = 0; i < n_distinct; i++) {
+        entries[i].string = model->words[entries[i].word].string;
+        entries[i].count = tally[entries[i].word];
+        tally[entries[i].word] = 0;
+    }
+    if (order == ORDER_BY_FREQUENCY) qsort(entries, n_distinct, sizeof(EntryCount), compare_entries_by_count);
+    else if (order == ORDER_ALPHABETICAL) qsort(entries, n_distinct, sizeof(EntryCount), compare_entries_alphabetically);
+    for (int i = 0; i < n_distinct; i++) {
+        put_string(out, entries[i].string);
+        put_string(out, " (");
+        put_number(out, entries[i].count);
+        put_char(out, ')');
+        put_char(out, separator);
+    }
+}
+
+/*  Function: compare_entries_by_count / compare_entries_alphabetically
+*   -------------------------------------------------------------------
+*   The same orders for arrays of EntryCounts.
+*/
+int compare_entries_by_count(const void* a, const void* b) {
+    const EntryCount* first = a;
+    const EntryCount* second = b;
+    if (first->count != second->count) return first->count > second->count ? -1 : 1;
+    return strcmp(first->string, second->string);
+}
+
+int compare_entries_alphabetically(const void* a, const void* b) {
+    return strcmp(((const EntryCount*)a)->string, ((const EntryCount*)b)->string);
+}
+
+/*  Function: put_string
+*   --------------------
+*   Appends a NUL-terminated string to the buffer.
+*/
+void put_string(OutputBuffer* out, const char* string) {
+    put_bytes(out, string, strlen(string));
+}
+
+/*  Function: put_bytes
+*   -------------------
+*   Appends length bytes to the buffer, flushing it first if they do not fit.
+*/
+void put_bytes(OutputBuffer* out, const void* bytes, size_t length) {
+    if (out->used + length > OUTPUT_BUFFER_SIZE) flush_buffer(out);
+    if (length > OUTPUT_BUFFER_SIZE) {
+        if (fwrite(bytes, 1, length, out->file) != length) out->failed = true;
+        return;
+    }
+    memcpy(out->data + out->used, bytes, length);
+    out->used += length;
+}
+
+/*  Function: put_char
+*   ------------------
+*   Appends one character to the buffer.
+*/
+void put_char(OutputBuffer* out, char c) {
+    if (out->used == OUTPUT_BUFFER_SIZE) flush_buffer(out);
+    out->data[out->used++] = c;
+}
+
+/*  Function: put_number
+*   --------------------
+*   Appends a non-negative number in decimal, converted by hand rather than through printf.
+*/
+void put_number(OutputBuffer* out, long number) {
+    char digits[24];
+    int n_digits = 0;
+    do {
+        digits[n_digits++] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+    if (out->used + n_digits > OUTPUT_BUFFER_SIZE) flush_buffer(out);
+    while (n_digits > 0) out->data[out->used++] = digits[--n_digits];
+}
+
+/*  Function: flush_buffer
+*   ----------------------
+*   Writes out and empties the buffer, remembering any failure.
+*/
+void flush_buffer(OutputBuffer* out) {
+    if (out->used && fwrite(out->data, 1, out->used, out->file) != out->used) out->failed = true;
+    out->used = 0;
+}
+
+/*  Function: export_model
+*   ----------------------
+*   Splits the words into ranges of about EXPORT_CHUNK_COST output entries and has a worker
+*   pool write each range into memory, while this thread writes the finished ranges to the
+*   file in order.  At most two ranges per worker are in flight, so memory stays bounded
+*   however large the model is.  With one thread, each range is written here instead.
+*/
+int export_model(Model* model, FILE* file, ExportFormat format, int n_threads) {
+    ExportJob job;
+    job.model = model;
+    job.format = format;
+    job.starts = calloc(model->n_w + 1, sizeof(int));
+    for (int i = 0; i < model->n_ssw; i++) job.starts[model->sentence_starting_words[i]]++;
+    job.renumbered = malloc((model->n_w + 1) * sizeof(int));
+    int n_words = 0;
+    uint64_t strings_size = 0;
+    for (int i = 0; i < model->n_w; i++) {
+        char* string = model->words[i].string;
+        job.renumbered[i] = string ? n_words++ : -1;
+        if (string) strings_size += strlen(string) + 1;
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.chunk_done, NULL);
+    bool written = write_export_header(model, file, format, n_words, strings_size);
+
+    WorkerPool* pool = n_threads == 1 ? NULL : create_worker_pool(n_threads);
+    int window = pool ? 2 * worker_pool_size(pool) : 1;
+    ExportChunk* chunks = calloc(window, sizeof(ExportChunk));
+    int next_word = 0;  // first word not yet handed out
+    int n_submitted = 0, n_written = 0;
+    while (next_word < model->n_w || n_written < n_submitted) {
+        while (next_word < model->n_w && n_submitted - n_written < window) {
+            ExportChunk* chunk = chunks + n_submitted++ % window;
+            chunk->job = &job;
+            chunk->first = next_word;
+            int cost = 0;
+            while (next_word < model->n_w && cost < EXPORT_CHUNK_COST) {
+                cost += model->words[next_word++].n_nw + 1;
+            }
+            chunk->last = next_word;
+            chunk->done = false;
+            if (pool) submit_task(pool, export_chunk, chunk);
+            else export_chunk(chunk);
+        }
+        ExportChunk* chunk = chunks + n_written++ % window;
+        pthread_mutex_lock(&job.lock);
+        while (!chunk->done) pthread_cond_wait(&job.chunk_done, &job.lock);
+        pthread_mutex_unlock(&job.lock);
+        written &= !chunk->failed && fwrite(chunk->data, 1, chunk->size, file) == chunk->size;
+        free(chunk->data);
+    }
+    if (pool) free_worker_pool(pool);
+    free(chunks);
+    pthread_cond_destroy(&job.chunk_done);
+    pthread_mutex_destroy(&job.lock);
+    free(job.renumbered);
+    free(job.starts);
+    return (written && fflush(file) == 0) ? 0 : -1;
+}
+
+/*  Function: write_export_header
+*   -----------------------------
+*   Writes what comes before the words: the column names of a CSV edge list, or the header
+*   and vocabulary of a binary one, whose strings are padded to a multiple of four bytes so
+*   that the edges after them stay aligned.  JSON Lines has no header.
+*/
+bool write_export_header(Model* model, FILE* file, ExportFormat format, int n_words, uint64_t strings_size) {
+    if (format == EXPORT_CSV) return fputs("source,target,count\n", file) >= 0;
+    if (format != EXPORT_BINARY) return true;
+    EdgeFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EDGE_FILE_MAGIC, sizeof(header.magic));
+    header.version = EDGE_FILE_VERSION;
+    header.n_words = n_words;
+    header.strings_size = (strings_size + 3) & ~(uint64_t)3;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; i < model->n_w; i++) {
+        char* string = model->words[i].string;
+        if (string) written &= fwrite(string, strlen(string) + 1, 1, file) == 1;
+    }
+    char padding[4] = {0};
+    size_t n_padding = header.strings_size - strings_size;
+    return written && fwrite(padding, 1, n_padding, file) == n_padding;
+}
+
+/*  Function: export_chunk
+*   ----------------------
+*   Runs on a worker thread.  Writes the chunk's words, in the job's format, through an
+*   OutputBuffer into a memory stream, then marks the chunk done.  Each word's distinct
+*   successors are found by sorting a copy of its next_words, so they come out in word order.
+*/
+void export_chunk(void* chunk_ptr) {
+    ExportChunk* chunk = chunk_ptr;
+    ExportJob* job = chunk->job;
+    Model* model = job->model;
+    chunk->data = NULL;
+    chunk->size = 0;
+    OutputBuffer* out = malloc(sizeof(OutputBuffer));
+    out->file = open_memstream(&chunk->data, &chunk->size);
+    out->used = 0;
+    out->failed = !out->file;
+    int max_nw = 0;
+    for (int i = chunk->first; i < chunk->last; i++) {
+        if (model->words[i].n_nw > max_nw) max_nw = model->words[i].n_nw;
+    }
+    int* successors = malloc((max_nw + 1) * sizeof(int));
+    for (int i = chunk->first; i < chunk->last && out->file; i++) {
+        Word* word = model->words + i;
+        if (!word->string) continue;  // removed from a live model
+        memcpy(successors, word->next_words, word->n_nw * sizeof(int));
+        qsort(successors, word->n_nw, sizeof(int), compare_ints);
+        if (job->format == EXPORT_JSON_LINES) {
+            put_string(out, "{\"word\":");
+            put_json_string(out, word->string);
+            put_string(out, ",\"count\":");
+            put_number(out, word->n_occurrences);
+            put_string(out, ",\"starts\":");
+            put_number(out, job->starts[i]);
+            put_string(out, word->is_sentence_ender ? ",\"ender\":true,\"successors\":{" : ",\"ender\":false,\"successors\":{");
+        }
+        for (int j = 0; j < word->n_nw; ) {
+            int k = j;
+            while (k < word->n_nw && successors[k] == successors[j]) k++;
+            Word* next_word = model->words + successors[j];
+            if (job->format == EXPORT_JSON_LINES) {
+                if (j > 0) put_char(out, ',');
+                put_json_string(out, next_word->string);
+                put_char(out, ':');
+                put_number(out, k - j);
+            } else if (job->format == EXPORT_CSV) {
+                put_csv_field(out, word->string);
+                put_char(out, ',');
+                put_csv_field(out, next_word->string);
+                put_char(out, ',');
+                put_number(out, k - j);
+                put_char(out, '\n');
+            } else {
+                uint32_t edge[3] = {job->renumbered[i], job->renumbered[successors[j]], k - j};
+                put_bytes(out, edge, sizeof(edge));
+            }
+            j = k;
+        }
+        if (job->format == EXPORT_JSON_LINES) put_string(out, "}}\n");
+    }
+    if (out->file) {
+        flush_buffer(out);
+        if (fclose(out->file) != 0) out->failed = true;
+    }
+    free(successors);
+    pthread_mutex_lock(&job->lock);
+    chunk->failed = out->failed;
+    chunk->done = true;
+    pthread_cond_broadcast(&job->chunk_done);
+    pthread_mutex_unlock(&job->lock);
+    free(out);
+}
+
+/*  Function: put_json_string
+*   -------------------------
+*   Appends a string as a quoted JSON string, escaping quotes, backslashes and control
+*   characters.
+*/
+void put_json_string(OutputBuffer* out, const char* string) {
+    put_char(out, '"');
+    for (const char* c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            put_char(out, '\\');
+            put_char(out, *c);
+        } else if ((unsigned char)*c < 0x20) {
+            char escape[7];
+            snprintf(escape, sizeof(escape), "\\u%04x", *c);
+            put_string(out, escape);
+        } else put_char(out, *c);
+    }
+    put_char(out, '"');
+}
+
+/*  Function: put_csv_field
+*   -----------------------
+*   Appends a string as a CSV field, quoted (with inner quotes doubled) if it holds a comma,
+*   a quote or a line break.
+*/
+void put_csv_field(OutputBuffer* out, const char* string) {
+    if (!strpbrk(string, ",\"\r\n")) {
+        put_string(out, string);
+        return;
+    }
+    put_char(out, '"');
+    for (const char* c = string; *c; c++) {
+        if (*c == '"') put_char(out, '"');
+        put_char(out, *c);
+    }
+    put_char(out, '"');
+}
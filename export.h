@@ -0,0 +1,55 @@
+/*  export.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Writing a model out in full: print_model's listing in a chosen order, and
+*   edge lists in formats other tools read.  Include model.h, stdio.h and
+*   stdbool.h first.
+*/
+
+/*  Enum: ModelOrder
+*   ----------------
+*   Order in which write_model lists words: as first ingested, by number of
+*   occurrences (most first), or alphabetically.
+*/
+typedef enum ModelOrder {
+    ORDER_INGESTED,
+    ORDER_BY_FREQUENCY,
+    ORDER_ALPHABETICAL
+} ModelOrder;
+
+/*  Function: write_model
+*   ---------------------
+*   Writes the model to an open file in print_model's format, with its words
+*   in the given order, through a buffer rather than a printf per word.  With
+*   show_counts, each distinct successor and starting word is written once,
+*   as "word (count)", instead of once per time it was seen, and these lists
+*   follow the same order.  Returns 0 on success, or -1 if writing failed.
+*/
+int write_model(Model* model, FILE* file, ModelOrder order, bool show_counts);
+
+/*  Enum: ExportFormat
+*   ------------------
+*   Machine-readable formats for export_model:
+*    - EXPORT_JSON_LINES: one object per word, such as
+*      {"word":"the","count":18,"starts":2,"ender":false,"successors":{"cat":3}}
+*    - EXPORT_CSV: a source,target,count edge list with a header row, fields
+*      quoted as RFC 4180 requires
+*    - EXPORT_BINARY: the vocabulary followed by packed uint32 source, target,
+*      count triples, as described by EdgeFileHeader in export.c
+*/
+typedef enum ExportFormat {
+    EXPORT_JSON_LINES,
+    EXPORT_CSV,
+    EXPORT_BINARY
+} ExportFormat;
+
+/*  Function: export_model
+*   ----------------------
+*   Writes the model to an open file in the given format, one entry per
+*   distinct bigram with its count.  Ranges of the vocabulary are formatted
+*   by n_threads threads at once, or one per processor if n_threads is not
+*   positive, and written in order.  Returns 0 on success, or -1 if writing
+*   failed.
+*/
+int export_model(Model* model, FILE* file, ExportFormat format, int n_threads);
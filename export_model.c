@@ -0,0 +1,50 @@
+/*  export_model.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "model.h"
+#include "export.h"
+
+/*	Function: main
+*	--------------
+*	Invocation: export_model [-j | -c | -e] [-t threads] model_file output_file
+*	Loads a model file written by build_model and exports it for other tools: as JSON Lines
+*	with -j (the default), as a CSV edge list with -c, or as a binary edge list with -e.
+*	The export is formatted by threads threads, one per processor by default.
+*/
+int main(int argc, char* argv[]) {
+	ExportFormat format = EXPORT_JSON_LINES;
+	int n_threads = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "jcet:")) != -1) {
+		if (opt == 'j') format = EXPORT_JSON_LINES;
+		else if (opt == 'c') format = EXPORT_CSV;
+		else if (opt == 'e') format = EXPORT_BINARY;
+		else if (opt == 't' && sscanf(optarg, "%d", &n_threads) == 1 && n_threads > 0) continue;
+		else {
+			printf("Please invoke as: export_model [-j | -c | -e] [-t threads] model_file output_file\n");
+			exit(1);
+		}
+	}
+	if (argc - optind != 2) {
+		printf("Please invoke as: export_model [-j | -c | -e] [-t threads] model_file output_file\n");
+		exit(1);
+	}
+	Model* model = load_model(argv[optind]);
+	if (!model) {
+		printf("Model could not be loaded from %s.\n", argv[optind]);
+		exit(1);
+	}
+	FILE* file = fopen(argv[optind + 1], "wb");
+	if (!file || export_model(model, file, format, n_threads) || fclose(file)) {
+		printf("Model could not be exported to %s.\n", argv[optind + 1]);
+		exit(1);
+	}
+	free_allocated(model);
+	return 0;
+}
@@ -0,0 +1,175 @@
+/*  load_generator.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "protocol.h"
+
+/*	Struct: Client
+*	--------------
+*	One connection's share of the load and the latencies it measured.
+*/
+typedef struct Client {
+	const char* socket_path;
+	int model;
+	const char* model_name;  // for named requests, or NULL
+	int n_words;
+	int n_requests;
+	int depth;  // requests kept in flight
+	double* latencies;  // microseconds, indexed by request id
+	int n_failed;
+} Client;
+
+
+//  -------Function prototypes-------
+void* run_client(void* client_ptr);
+double now_us();
+int compare_doubles(const void* a, const void* b);
+//  ---------------------------------
+
+
+/*	Function: main
+*	--------------
+*	Invocation: load_generator [-c connections] [-n requests_per_connection] [-d depth]
+*	                           [-l n_words] [-m model_index | -m model_name] [socket_path]
+*	Drives a running sentence_server with generate requests from several connections at
+*	once, each keeping depth requests in flight, then prints the throughput and the
+*	latency distribution.  Run it against servers started with and without -b to see
+*	what batching buys.  A non-numeric model is asked for by name from the server's model
+*	directory.
+*/
+int main(int argc, char* argv[]) {
+	int n_clients = 4, n_requests = 10000, depth = 8, n_words = 5, model = 0;
+	const char* model_name = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:d:l:m:")) != -1) {
+		int value;
+		if (opt == 'm' && sscanf(optarg, "%d", &value) != 1 && strlen(optarg) <= MAX_MODEL_NAME_LENGTH) {
+			model_name = optarg;
+			continue;
+		}
+		if (sscanf(optarg, "%d", &value) != 1 || value < 0) opt = '?';
+		if (opt == 'c') n_clients = value;
+		else if (opt == 'n') n_requests = value;
+		else if (opt == 'd') depth = value;
+		else if (opt == 'l') n_words = value;
+		else if (opt == 'm') model = value;
+		else {
+			printf("Please invoke as: load_generator [-c connections] [-n requests] [-d depth] [-l n_words] [-m model] socket_path\n");
+			exit(1);
+		}
+	}
+	if (optind != argc - 1 || n_clients < 1 || depth < 1) {
+		printf("Please invoke as: load_generator [-c connections] [-n requests] [-d depth] [-l n_words] [-m model] socket_path\n");
+		exit(1);
+	}
+	Client clients[n_clients];
+	pthread_t threads[n_clients];
+	double start = now_us();
+	for (int i = 0; i < n_clients; i++) {
+		clients[i].socket_path = argv[optind];
+		clients[i].model = model;
+		clients[i].model_name = model_name;
+		clients[i].n_words = n_words;
+		clients[i].n_requests = n_requests;
+		clients[i].depth = depth;
+		clients[i].latencies = malloc((n_requests + 1) * sizeof(double));
+		clients[i].n_failed = 0;
+		if (pthread_create(threads + i, NULL, run_client, clients + i)) {
+			printf("Could not start client thread.\n");
+			exit(1);
+		}
+	}
+	for (int i = 0; i < n_clients; i++) pthread_join(threads[i], NULL);
+	double elapsed = now_us() - start;
+	int n_total = n_clients * n_requests, n_failed = 0;
+	double* latencies = malloc((n_total + 1) * sizeof(double));
+	for (int i = 0; i < n_clients; i++) {
+		memcpy(latencies + i * n_requests, clients[i].latencies, n_requests * sizeof(double));
+		n_failed += clients[i].n_failed;
+		free(clients[i].latencies);
+	}
+	qsort(latencies, n_total, sizeof(double), compare_doubles);
+	printf("%d requests over %d connections (depth %d) in %.3f s: %.0f requests/s\n",
+		n_total, n_clients, depth, elapsed / 1e6, n_total / (elapsed / 1e6));
+	if (n_total) {
+		printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", latencies[n_total / 2],
+			latencies[(int)(n_total * 0.9)], latencies[(int)(n_total * 0.99)], latencies[n_total - 1]);
+	}
+	if (n_failed) printf("%d requests failed or had no sentence\n", n_failed);
+	free(latencies);
+	return 0;
+}
+
+/*	Function: run_client
+*	--------------------
+*	Body of each connection's thread.  Sends depth requests, then sends one more for each
+*	response received until all n_requests are answered, timing each request from just
+*	before it is sent to when its response is read.
+*/
+void* run_client(void* client_ptr) {
+	Client* client = client_ptr;
+	int fd = connect_to_server(client->socket_path);
+	if (fd < 0) {
+		printf("Could not connect to %s.\n", client->socket_path);
+		exit(1);
+	}
+	unsigned char* payload = malloc(MAX_FRAME_LENGTH);
+	double* sent_at = malloc((client->n_requests + 1) * sizeof(double));
+	int n_sent = 0;
+	for (int n_received = 0; n_received < client->n_requests; n_received++) {
+		while (n_sent < client->n_requests && n_sent - n_received < client->depth) {
+			uint32_t length = client->model_name
+				? encode_named_generate_request(payload, n_sent, client->model_name, client->n_words)
+				: encode_generate_request(payload, n_sent, client->model, client->n_words);
+			sent_at[n_sent] = now_us();
+			if (send_frame(fd, payload, length)) {
+				printf("Connection lost.\n");
+				exit(1);
+			}
+			n_sent++;
+		}
+		int length = receive_frame(fd, payload);
+		if (length < RESPONSE_HEADER_LENGTH) {
+			printf("Connection lost.\n");
+			exit(1);
+		}
+		uint32_t id = get_u32(payload + 1);
+		if (id >= (uint32_t)n_sent) {
+			printf("Unexpected response id %u.\n", id);
+			exit(1);
+		}
+		client->latencies[id] = now_us() - sent_at[id];
+		if (payload[0] != STATUS_OK) client->n_failed++;
+	}
+	close(fd);
+	free(payload);
+	free(sent_at);
+	return NULL;
+}
+
+/*	Function: now_us
+*	----------------
+*	Returns the CLOCK_MONOTONIC time in microseconds.
+*/
+double now_us() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+/*	Function: compare_doubles
+*	-------------------------
+*	qsort comparator for ascending doubles.
+*/
+int compare_doubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
@@ -34,8 +34,8 @@
 *   -------------------------
 *   Other Notes:
 *    - n_occurrences is only used for printing model
-*    - forgot to add the new sentence to new_sentences
-*    - forgot to implement freeing!!!  would free: sentences, then word strings for each Word, then model
+*    - words refer to each other by index into the model's words array rather than by pointer,
+*      so the array can grow, and a model saved to a file can be mapped straight back in
 */
 
 #include <stdio.h>
@@ -43,71 +43,382 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
 #include <time.h>
 #include <assert.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "model.h"
+#include "workers.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "export.h"
+#include "pages.h"
+#include "nodes.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WALK_AVX2  // walk_sentences may use walk_sentences_avx2, if the processor has AVX2
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
 
-#define MAX_WORD_LENGTH 50  // hard-coded into fscanf format string
-#define MAX_WORDS_IN_MODEL 10000
-#define MAX_STARTING_WORDS 1000
-#define MAX_FOLLOWING_WORDS 100
-#define MAX_SENTENCES 100
-
-/*  Struct: Word
-*   ------------
-*   Data structure storing the information for each word in the model.  Note that if
-*   the first
-*/
-typedef struct Word {
-    char* string;   // pointer to the string
-    int n_occurrences; // number of times this word appeared in the text
-    bool is_sentence_ender;  // if the word has been found to end a sentence
-    int n_nw;  // size of next_words and counts
-    void* next_words[MAX_FOLLOWING_WORDS]; // array of pointers to any words that followed
-    bool tested[MAX_FOLLOWING_WORDS];    // used in marking words for the recursive sentence generation
-} Word;
-
-/*  Struct: ModelImplementation
-*   ---------------------------
-*   Data structure that stores the model.  Contains an array of Word structs, along
-*   with an array of pointers to all words that start sentences.
+#define MAX_STARTING_WORDS 1000  // entries in a derived sentence_starting_words table
+#define MAX_FOLLOWING_WORDS 100  // entries in a derived next_words table
+#define MAX_BIGRAM_LENGTH (2 * MAX_WORD_LENGTH + 1)  // two words joined by a space
+#define COMPACTION_INTERVAL 100000  // streamed words between compactions
+#define START_TALLY 0  // tally of a streamed word's entry counting sentences it starts
+#define END_TALLY 1  // tally of a streamed word's entry counting sentences it ends
+#define MIN_WORD_INDEX_SIZE 1024  // power of two
+#define MODEL_FILE_MAGIC "BIGRAMS"
+#define MODEL_FILE_VERSION 1
+#define MIN_LIVE_WEIGHT 0.0625  // decayed weight, in fresh occurrences, below which counts are dropped
+#define PRUNE_SCALE 16.0  // decayed weights are rescaled and pruned every four half-lives
+#define MIN_FAILURE_SET_SIZE 64  // power of two
+#define MIN_SCRATCH_SIZE 256  // ints of scratch space first allocated for random orders
+#define LAZY_DRAWS 8  // positions a random order draws by rejection before shuffling
+#define RESTART_UNIT 32  // search frames per word of the sentence in a one-unit restart
+#define RESTART_BUDGET 64  // units spent on restarts before a final search without a limit
+#define REACHABLE_WORDS_PER_THREAD 16384  // words each thread filling a reachable table takes on
+#define REACHABLE_PERIODS 2  // longest period of repeating rows a reachable table looks for
+#define WALK_DRAWS 8  // entries a walk draws by rejection before counting the feasible ones
+#define WALK_LANES 16  // walks walk_sentences keeps under way at once
+#define VECTOR_LANES 8  // walks walk_sentences_avx2 takes a step of at once, one per 32-bit lane
+#define VECTOR_GROUPS 4  // groups of VECTOR_LANES walks walk_sentences_avx2 keeps under way
+
+/*  Struct: ModelFileHeader
+*   -----------------------
+*   Start of a model file written by save_model.  The header is followed by n_w FileWords,
+*   n_links successor indices (every word's next_words in turn), n_ssw starting-word
+*   indices, and strings_size bytes of NUL-terminated strings.  Everything is stored in the
+*   host's byte order and 4-byte aligned, so the file can be used in place once mapped.
+*/
+typedef struct ModelFileHeader {
+    char magic[8];  // MODEL_FILE_MAGIC
+    uint32_t version;
+    uint32_t n_w;
+    uint32_t n_ssw;
+    uint32_t reserved;
+    uint64_t n_links;
+    uint64_t strings_size;
+} ModelFileHeader;
+
+/*  Struct: FileWord
+*   ----------------
+*   A word as stored in a model file.  Its next_words are the n_links indices starting at
+*   position first_link of the file's successor array.
+*/
+typedef struct FileWord {
+    uint32_t string_offset;
+    uint32_t n_occurrences;
+    uint32_t is_sentence_ender;
+    uint32_t first_link;
+    uint32_t n_links;
+} FileWord;
+
+/*  Struct: SearchContext
+*   ---------------------
+*   State shared by every frame of one backtracking search.  The search follows the lists of
+*   the generation view, and gives up as soon as it sees the cancellation flag set or has
+*   entered more frames than its limit allows.  Every
+*   (word, remaining length) state from which the search has exhausted all continuations is
+*   kept in an open-addressed set of packed keys, allocated at the first failure, so that no
+*   state is explored twice.
+*/
+typedef struct SearchContext {
+    GenerationView* view;
+    const bool* cancelled;  // set by another thread to stop the search, or NULL
+    bool given_up;  // if the search stopped without exhausting its options
+    long frame_limit;  // frames the current attempt may enter, or 0 for no limit
+    long n_frames;  // frames entered in the current attempt
+    uint64_t* failures;  // failed states as failure_key values, 0 if empty, or NULL
+    uint32_t failures_mask;  // size of failures - 1; the size is a power of two
+    uint32_t n_failures;
+    int* scratch;  // stack of positions for the RandomOrders of the frames in progress
+    int scratch_cap;
+    int n_scratch;
+} SearchContext;
+
+/*  Struct: RandomOrder
+*   -------------------
+*   A lazy random order of the positions 0 to n - 1.  The first few positions are drawn by
+*   rejection against a short list of those already drawn, which needs no setup, so a frame
+*   whose first choices work costs O(1) however long its list.  Once LAZY_DRAWS have been
+*   drawn, or half of the positions, the rest are laid out in a slice of the search's
+*   scratch stack and drawn by Fisher-Yates: each step picks one and moves the last into its
+*   place.  Either way each position still to come is equally likely, and an exhausted order
+*   costs O(n) in all.  The slice is found by offset, since the scratch stack may move as it
+*   grows.
+*/
+typedef struct RandomOrder {
+    SearchContext* context;
+    int n;
+    int n_drawn;  // positions returned so far
+    int drawn[LAZY_DRAWS];  // the positions returned, while drawing by rejection
+    int offset;  // start of the slice in the context's scratch, or -1 before it is laid out
+    int n_left;  // positions in the slice not yet returned
+} RandomOrder;
+
+/*  Struct: PathWeights
+*   -------------------
+*   Table made by weigh_paths for one sentence length.  Row k, column w is proportional to
+*   the probability that a walk from word w, picking each next word with its bigram
+*   probability, reaches a sentence ender after exactly k more words, and is 0 if it never
+*   can.  Each row is scaled so that its largest weight is 1, which keeps the probabilities
+*   of many-word sentences from underflowing; draws only compare weights within a row, so
+*   the scales cancel out.
+*/
+typedef struct PathWeights {
+    int length;
+    int n_w;
+    double* rows;  // length rows of n_w entries
+    double* scales;  // for each row after the first, its scale over the scale of the row before
+    double start;  // summed weights of every sentence_starting_words entry in the last row
+} PathWeights;
+
+/*  Struct: ReachableJob
+*   --------------------
+*   A reachable table being filled in by find_reachable, whose threads each own a range of
+*   its 64-bit row words and meet at a barrier after every row.
+*/
+typedef struct ReachableJob {
+    GenerationView* view;
+    int n_w;
+    int length;
+    size_t row_size;  // uint64_t words per row
+    uint64_t* rows;
+    pthread_barrier_t barrier;
+} ReachableJob;
+
+/*  Struct: ReachableRange
+*   ----------------------
+*   One thread's part of a ReachableJob, and where it found the rows starting to repeat.
+*/
+typedef struct ReachableRange {
+    ReachableJob* job;
+    size_t first;  // first row word filled by the thread
+    size_t last;  // row word after the last one filled
+    int last_row;  // last row filled before the repeat was found, or length - 1
+    int period;  // rows between repeats, or 0 if none was found
+    pthread_t thread;
+} ReachableRange;
+
+/*  Struct: RandomStream
+*   --------------------
+*   Counter-based generator.  Its draws are hash_draw of its key and a counter that counts
+*   up from 0, so they depend only on the key, which start_random_stream works out from a
+*   seed and the index of the sentence being made, and not on what else the thread has
+*   drawn.  random_int draws from the thread's current_stream whenever it is set.
+*/
+typedef struct RandomStream {
+    uint32_t key[2];
+    uint32_t counter;  // draws made so far
+} RandomStream;
+
+static __thread RandomStream* current_stream = NULL;
+
+/*  Struct: SeededRange
+*   -------------------
+*   One thread's share of the sentences made by generate_sentences_seeded.
+*/
+typedef struct SeededRange {
+    Model* model;
+    int length;
+    uint64_t* reachable;
+    uint64_t seed;
+    uint64_t first_index;  // index of the range's first sentence in the seeded sequence
+    int n;
+    char** sentences;
+    int n_made;
+    int node;  // NUMA node the thread is bound to, or -1
+    pthread_t thread;
+} SeededRange;
+
+static __thread GenerationView* local_view = NULL;  // node replica walk_sentences follows, or NULL
+bool use_vector_kernels = true;  // cleared to run the scalar kernels on any processor
+
+/*  Enum: WalkStage
+*   ---------------
+*   What a lane of walk_sentences does on its next turn: load the successor list of the word
+*   it just chose, read the entry it drew from its list, or test that entry in the reachable
+*   table.  Each is a load that the turn before prefetched.
+*/
+typedef enum WalkStage {
+    WALK_LIST,
+    WALK_ENTRY,
+    WALK_TEST
+} WalkStage;
+
+/*  Struct: WalkLane
+*   ----------------
+*   One of the walks walk_sentences advances in turn, suspended between stages.
+*/
+typedef struct WalkLane {
+    int sentence;  // index of the sentence being made, or -1 if the lane is idle
+    int step;  // index in the sentence of the word being chosen
+    WalkStage stage;
+    int word;  // the word last chosen
+    int* entries;  // list the next word is drawn from
+    int n_entries;
+    int* drawn;  // the entry drawn from it
+    int draws;  // entries drawn for this word so far
+    uint64_t* row;  // reachable table row the next word must be set in
+    Word** words;  // the sentence so far
+    RandomStream stream;  // the sentence's draws, if it is seeded
+} WalkLane;
+
+#ifdef WALK_AVX2
+/*  Struct: VectorGroup
+*   -------------------
+*   VECTOR_LANES walks that walk_sentences_avx2 advances together, one per 32-bit lane (or
+*   64-bit lane, for addresses, with lanes 0-3 in the low vector and 4-7 in the high one),
+*   suspended between stages as a WalkLane is.
+*/
+typedef struct VectorGroup {
+    __m256i n_entries;  // size of each lane's list
+    __m256i lists_low, lists_high;  // address of each lane's list
+    __m256i addresses_low, addresses_high;  // address of the entry each lane drew
+    __m256i drawn;  // the entries drawn
+    __m256i chosen;  // the entries found feasible so far
+    __m256i pending;  // all ones in lanes that have yet to find a feasible entry
+    __m256i keys[2];  // each lane's RandomStream key
+    __m256i counters;  // each lane's RandomStream counter
+    int first;  // index of the sentence made in lane 0, or -1 if the group is idle
+    int step;  // index in the sentences of the words being chosen
+    int draws;  // draws made for these words so far
+    WalkStage stage;
+    int* path;  // VECTOR_LANES words for each step, lane by lane
+} VectorGroup;
+#endif
+
+/*  Struct: Portfolio
+*   -----------------
+*   What the searches racing in one generate_sentence_portfolio call share.  done doubles
+*   as every search's cancellation flag.  The lock guards the winner and the count of
+*   searches under way, so that the caller can wait for those before returning, while a
+*   search whose task starts after the race is over never touches the model at all.
 */
-struct ModelImplementation {
-    int n_w; // size of words
-    Word words[MAX_WORDS_IN_MODEL]; // array of every word, stored as Word structs
-    int n_ssw;  // size of sentence_starting_words
-    Word* sentence_starting_words[MAX_STARTING_WORDS];  // array of pointers to all words that start sentences
-    int n_s;  // size of sentences
-    char* sentences[MAX_SENTENCES];
-};
+typedef struct Portfolio {
+    Model* model;
+    int length;
+    bool done;  // atomic, set once a sentence is found or shown not to exist
+    char* winner;  // the first sentence found, or NULL
+    int n_running;  // searches that have started and not yet finished
+    int n_refs;  // the caller plus each task not yet run
+    pthread_mutex_t lock;
+    pthread_cond_t finished;  // signaled when n_running drops to 0
+} Portfolio;
 
 
 //  -------Function prototypes-------
 Model* initialize_model();
+Model* initialize_live_model(int window, double growth);
+void record_word(Model* model, char* next_word_buf, bool ends_sentence);
+void stream_word(Model* model, char* next_word_buf, bool ends_sentence);
+void record_live_word(Model* model, char* next_word_buf, bool ends_sentence);
+void end_live_sentence(Model* model);
+void expire_sentence(Model* model, int* sentence);
+void expire_oldest_sentences(Model* model);
+void prune_live_model(Model* model);
+void add_live_link(Model* model, int word, int next_word, double weight);
+void add_live_start(Model* model, int word, double weight);
+void mark_dirty(Model* model, int word);
+void remove_word(Model* model, int word);
+void refresh_live_words(Model* model);
+void compact_model(Model* model);
+void compact_successors(Model* model);
+void compact_starting_words(Model* model);
+void clear_words(Model* model);
+int allocate_slots(double weights[], int n, int n_slots, int slots[]);
+void index_word(Model* model, int word);
+void unindex_word(Model* model, int word);
+void resize_word_index(Model* model, uint32_t size);
+void add_starting_word(Model* model, int word);
 int scan_next_word(FILE* text, char* next_word_buf);
 bool check_if_ends_sentence(char* next_word_buf);
 Word* add_next_word_to_model(Model* model, char* next_word_buf, bool ends_sentence, bool new_sentence);
 Word* search_words(Model* model, char* next_word_buf);
 Word* create_word(Model* model, char* next_word_buf, bool ends_sentence);
-void link_words(Word* this_word, Word* next_word);
+void link_words(Model* model, Word* this_word, Word* next_word);
+Model* map_model_file(void* mapping, size_t size);
 void print_model(Model* model);
-bool find_words(Model* model, int length, Word* sentence[]);
-bool find_words_recursive(int length, Word* sentence[], int cur_index);
-bool not_all_checked(bool array[], int n_elems);
+int compare_by_frequency(const void* a, const void* b);
+int compare_alphabetically(const void* a, const void* b);
+int compare_ints(const void* a, const void* b);
+GenerationView* get_generation_view(Model* model);
+GenerationView* build_generation_view(Model* model);
+void fill_view_starts(Model* model, GenerationView* view);
+void add_view_word(GenerationView* view, int word);
+void add_view_link(Model* model, GenerationView* view, int word, int next_word);
+void make_viable(Model* model, GenerationView* view, int word);
+void append_to_list(GenerationView* view, int** lists, int* sizes, int* caps, int word, int entry);
+void free_generation_view(GenerationView* view);
+bool find_words(Model* model, int length, Word* sentence[], SearchContext* context);
+bool find_words_recursive(Model* model, int length, Word* sentence[], int cur_index, SearchContext* context);
+bool search_with_restarts(Model* model, int length, Word* sentence[], SearchContext* context);
+char* search_sentence(Model* model, int length, const bool* cancelled);
+void run_portfolio_search(void* portfolio_ptr);
+void search_portfolio(Portfolio* portfolio);
+void release_portfolio(Portfolio* portfolio);
+long luby(int i);
+bool search_stopped(SearchContext* context);
+uint64_t failure_key(int word, int remaining);
+uint32_t failure_slot(uint64_t key, uint32_t mask);
+bool known_failure(SearchContext* context, int word, int remaining);
+void record_failure(SearchContext* context, int word, int remaining);
+void start_random_order(SearchContext* context, RandomOrder* order, int n);
+int next_in_random_order(RandomOrder* order);
+void lay_out_random_order(RandomOrder* order);
+void end_random_order(RandomOrder* order);
+void* fill_reachable_range(void* range_ptr);
+uint64_t fill_row_word(GenerationView* view, uint64_t previous[], int first_word, int n_bits);
+int find_repeated_row(ReachableJob* job, int k);
+bool test_bit(uint64_t bits[], int index);
+char* sample_sentence(Model* model, int length, uint64_t reachable[]);
+bool walk_sentence(Model* model, int length, uint64_t reachable[], Word* sentence[]);
+int pick_feasible(int entries[], int n_entries, uint64_t row[]);
+int* feasible_entries(int entries[], int n_entries, uint64_t row[], int* n_feasible);
+int walk_sentences(Model* model, int length, uint64_t reachable[], int n, char* sentences[], const uint64_t* seed, uint64_t first_index);
+void* walk_seeded_range(void* range_ptr);
+void start_range_thread(SeededRange* range);
+bool advance_walk(Model* model, GenerationView* view, WalkLane* lane, int length, size_t row_size);
+void draw_entry(WalkLane* lane);
+#ifdef WALK_AVX2
+TARGET_AVX2 int walk_sentences_avx2(Model* model, int length, uint64_t reachable[], int n, char* sentences[], const uint64_t* seed, uint64_t first_index);
+TARGET_AVX2 void start_vector_streams(VectorGroup* group, const uint64_t* seed, uint64_t first_index);
+TARGET_AVX2 void draw_vector(VectorGroup* group, bool new_word);
+TARGET_AVX2 void settle_lanes(VectorGroup* group, int chosen[], uint64_t row[]);
+TARGET_AVX2 int pick_feasible_avx2(int entries[], int n_entries, uint64_t row[]);
+TARGET_AVX2 __m256i hash_draws(__m256i keys[], __m256i counters);
+TARGET_AVX2 __m256i mix_draws(__m256i x);
+TARGET_AVX2 __m256i test_bits_avx2(uint64_t row[], __m256i entries);
+TARGET_AVX2 uint64_t fill_row_word_avx2(GenerationView* view, uint64_t previous[], int first_word, int n_bits);
+#endif
+PathWeights* weigh_paths(Model* model, int length);
+double sum_weights(int entries[], int n_entries, double row[]);
+void walk_weighted(Model* model, PathWeights* weights, Word* sentence[]);
+int draw_weighted(int entries[], int n_entries, double row[], double total);
+void free_path_weights(PathWeights* weights);
+double random_fraction();
 char* combine_words(Word* sentence[], int length);
 int random_int(int lower_bound, int upper_bound);
+void start_random_stream(RandomStream* stream, uint64_t seed, uint64_t index);
+uint32_t hash_draw(const uint32_t key[], uint32_t counter);
+uint32_t mix_draw(uint32_t x);
+uint64_t mix_seed(uint64_t x);
+int count_entries(int array[], int n_elems, int word);
+bool check_model_file(void* mapping, size_t size);
 //  ---------------------------------
 
 
 /*  Function: create_model
 *   ----------------------
-*   Generates the model of words.  Maintains a focus window of two words (this_word and next_word),
-*   represented by pointers to Word structs in the model's main array.  On each interation, the
-*   function first scans a new word, notes whether that word ends a sentence and removes that
-*   punctuation if it does, then adds it to the model.  With this_word and next_word populated,
-*   the function links this_word to next_word in the model if this_word did not end a sentence;
-*   if this_word ended a sentence, the function de-capitalizes this_word and adds next_word to the
-*   model's list of words that can begin sentences.  The function then returns a pointer to the model.
+*   Generates the model of words by ingesting the whole text into a new exact model.  Exits if
+*   the text holds no words.  The function then returns a pointer to the model.
 */
 Model* create_model(FILE* text) {
     if (!text) {
@@ -115,31 +426,586 @@ Model* create_model(FILE* text) {
         exit(1);
     }
     Model* model = initialize_model();
-    Word* this_word = NULL;
-    bool new_sentence = true;
+    ingest_text(model, text);
+    if (!model->n_w) {
+        printf("could not create model, no words found.\n");
+        exit(1);
+    }
+    return model;
+}
+
+/*  Function: create_streaming_model
+*   --------------------------------
+*   Creates an empty model whose counts are kept in sketches sized to memory_budget bytes,
+*   so that ingest_text can consume any amount of text without growing.  Of the budget left
+*   after the StreamState itself, 40% goes to the word summary, whose entries also tally
+*   sentence starts and ends, and 60% to the bigram summary.  Exits if the budget is too
+*   small to hold the summaries.
+*/
+Model* create_streaming_model(size_t memory_budget) {
+    Model* model = initialize_model();
+    StreamState* stream = malloc(sizeof(StreamState));
+    size_t sketch_budget = memory_budget > sizeof(StreamState) ? memory_budget - sizeof(StreamState) : 0;
+    stream->word_counts = hh_create(sketch_budget / 10 * 4, MAX_WORD_LENGTH + 1, 2);
+    stream->bigram_counts = hh_create(sketch_budget / 10 * 6, MAX_BIGRAM_LENGTH + 1, 0);
+    if (!stream->word_counts || !stream->bigram_counts) {
+        printf("Could not create model, memory budget of %zu bytes is too small.\n", memory_budget);
+        exit(1);
+    }
+    stream->last_word[0] = '\0';
+    stream->n_since_compaction = 0;
+    model->stream = stream;
+    return model;
+}
+
+/*  Function: ingest_text
+*   ---------------------
+*   Adds the words of text to the model, continuing from wherever the previous ingest left off,
+*   so a sentence may span two calls.  Each word is scanned, checked for sentence-ending
+*   punctuation (which is removed), and recorded either exactly or in the model's sketches.
+*   Streaming models are compacted at the end so the model reflects all of text.  An exact
+*   model's generation view is updated word by word, and its starting words refilled at the
+*   end if they changed; other models can lose links as well as gain them, so their views
+*   are dropped and rebuilt by the next search.
+*/
+void ingest_text(Model* model, FILE* text) {
+    if (model->mapping) {
+        printf("Could not ingest text, model was loaded from a file and is read-only.\n");
+        exit(1);
+    }
+    if (model->cache) {
+        printf("Could not ingest text, model has a sentence cache.\n");
+        exit(1);
+    }
+    if (model->view && (model->stream || model->live)) {  // rebuilt by the next search
+        free_generation_view(model->view);
+        model->view = NULL;
+    }
+    if (model->view) free_view_replicas(model->view);  // copied again by the next seeded batch
     while (true) {
         char next_word_buf[MAX_WORD_LENGTH + 1];
         if (scan_next_word(text, next_word_buf)) break;
         bool ends_sentence = check_if_ends_sentence(next_word_buf);
-        Word* next_word = add_next_word_to_model(model, next_word_buf, ends_sentence, new_sentence);
-        if (new_sentence) {  // if this_word ended a sentence and next_word begins a sentence
-            // LIMITATION: if sentence starts with prop. noun, will be un-capitalized in model
-            (model->sentence_starting_words)[model->n_ssw++] = next_word;
-            new_sentence = false;
-        } else link_words(this_word, next_word);
-        if (ends_sentence) {
-            next_word->is_sentence_ender = true;
-            new_sentence = true;
-        }
-        this_word = next_word;
+        if (model->stream) stream_word(model, next_word_buf, ends_sentence);
+        else if (model->live) record_live_word(model, next_word_buf, ends_sentence);
+        else record_word(model, next_word_buf, ends_sentence);
     }
-    if (!model->n_w) {
-        printf("could not create model, no words found.\n");
+    if (model->stream) compact_model(model);
+    if (model->live) refresh_live_words(model);
+    if (model->view && model->view->starts_stale) fill_view_starts(model, model->view);
+}
+
+/*  Function: record_word
+*   ---------------------
+*   Adds one word to an exact model.  Maintains a focus window of two words (last_word and
+*   next_word), represented by their indices in the model's main array.  With both
+*   populated, the function links last_word to next_word in the model if last_word did not end
+*   a sentence; if last_word ended a sentence, the function de-capitalizes next_word and adds it
+*   to the model's list of words that can begin sentences.  If the model has a generation
+*   view, each change is carried into it.
+*/
+void record_word(Model* model, char* next_word_buf, bool ends_sentence) {
+    int n_w = model->n_w;
+    Word* next_word = add_next_word_to_model(model, next_word_buf, ends_sentence, model->new_sentence);
+    int index = next_word - model->words;
+    GenerationView* view = model->view;
+    if (view && model->n_w > n_w) add_view_word(view, index);
+    if (model->new_sentence) {  // if last_word ended a sentence and next_word begins a sentence
+        // LIMITATION: if sentence starts with prop. noun, will be un-capitalized in model
+        add_starting_word(model, index);
+        if (view) view->starts_stale = true;
+        model->new_sentence = false;
+    } else {
+        link_words(model, model->words + model->last_word, next_word);
+        if (view) add_view_link(model, view, model->last_word, index);
+    }
+    if (ends_sentence) {
+        next_word->is_sentence_ender = true;
+        if (view && !view->viable[index]) make_viable(model, view, index);
+        model->new_sentence = true;
+    }
+    model->last_word = index;
+}
+
+/*  Function: stream_word
+*   ---------------------
+*   Adds one word to a streaming model.  Mirrors record_word, but instead of linking Word
+*   structs it counts the word and the bigram it completes in the model's summaries, tallying
+*   on the word's entry whether it starts or ends a sentence.  Compacts the model every
+*   COMPACTION_INTERVAL words so that the regular arrays never fall far behind the stream.
+*/
+void stream_word(Model* model, char* next_word_buf, bool ends_sentence) {
+    StreamState* stream = model->stream;
+    if (model->new_sentence) {
+        *next_word_buf = tolower(*next_word_buf);  // decapitalizes word
+    } else {
+        char bigram[MAX_BIGRAM_LENGTH + 1];
+        sprintf(bigram, "%s %s", stream->last_word, next_word_buf);
+        hh_add(stream->bigram_counts, bigram);
+    }
+    int entry = hh_add(stream->word_counts, next_word_buf);
+    if (entry >= 0 && model->new_sentence) hh_tally(stream->word_counts, entry, START_TALLY);
+    if (entry >= 0 && ends_sentence) hh_tally(stream->word_counts, entry, END_TALLY);
+    strcpy(stream->last_word, next_word_buf);
+    model->new_sentence = ends_sentence;
+    if (++stream->n_since_compaction >= COMPACTION_INTERVAL) compact_model(model);
+}
+
+/*  Function: compact_model
+*   -----------------------
+*   Rebuilds the regular arrays of a streaming model from its sketches.  The most frequent
+*   words, up to MAX_WORDS_IN_MODEL, become the model's words, in descending order of count
+*   so that a word's Word struct has the same index as its (sorted) heavy-hitter entry.  A
+*   word is marked as a sentence ender if its entry has seen it end a sentence.  Unlike a
+*   sketch estimate, that tally never counts another word's occurrences.
+*/
+void compact_model(Model* model) {
+    StreamState* stream = model->stream;
+    clear_words(model);
+    hh_sort(stream->word_counts);
+    int n_words = hh_size(stream->word_counts);
+    if (n_words > MAX_WORDS_IN_MODEL) n_words = MAX_WORDS_IN_MODEL;
+    for (int i = 0; i < n_words; i++) {
+        char* string = (char*)hh_key(stream->word_counts, i);
+        Word* word = create_word(model, string, hh_tally_count(stream->word_counts, i, END_TALLY) > 0);
+        word->n_occurrences = hh_count(stream->word_counts, i);
+    }
+    compact_successors(model);
+    compact_starting_words(model);
+    stream->n_since_compaction = 0;
+}
+
+/*  Function: compact_successors
+*   ----------------------------
+*   Fills each word's next_words array from the bigram summary.  Bigrams are grouped by their
+*   first word, and each word's MAX_FOLLOWING_WORDS slots are shared among its successors in
+*   proportion to their counts, so that repeated entries keep the relative frequencies that
+*   the exact model would have.  Bigrams naming a word that did not make it into the model
+*   are dropped.
+*/
+void compact_successors(Model* model) {
+    HeavyHitters* bigrams = model->stream->bigram_counts;
+    int n_bigrams = hh_size(bigrams);
+    int* firsts = malloc((n_bigrams + 1) * sizeof(int));
+    int* seconds = malloc((n_bigrams + 1) * sizeof(int));
+    double* counts = malloc((n_bigrams + 1) * sizeof(double));
+    int* starts = calloc(model->n_w + 1, sizeof(int));  // start of each word's group
+    int n_kept = 0;
+    for (int i = 0; i < n_bigrams; i++) {
+        char bigram[MAX_BIGRAM_LENGTH + 1];
+        strcpy(bigram, hh_key(bigrams, i));
+        char* space = strchr(bigram, ' ');
+        *space = '\0';
+        int first = hh_find(model->stream->word_counts, bigram);
+        int second = hh_find(model->stream->word_counts, space + 1);
+        if (first < 0 || first >= model->n_w || second < 0 || second >= model->n_w) continue;
+        firsts[n_kept] = first;
+        seconds[n_kept] = second;
+        counts[n_kept++] = hh_count(bigrams, i);
+        starts[first + 1]++;
+    }
+    for (int i = 0; i < model->n_w; i++) starts[i + 1] += starts[i];
+    int* group_seconds = malloc((n_kept + 1) * sizeof(int));
+    double* group_counts = malloc((n_kept + 1) * sizeof(double));
+    int* fill = malloc((model->n_w + 1) * sizeof(int));
+    memcpy(fill, starts, model->n_w * sizeof(int));
+    for (int i = 0; i < n_kept; i++) {  // counting sort by first word
+        group_seconds[fill[firsts[i]]] = seconds[i];
+        group_counts[fill[firsts[i]]++] = counts[i];
+    }
+    int* slots = malloc((n_kept + 1) * sizeof(int));
+    for (int i = 0; i < model->n_w; i++) {
+        int n_successors = starts[i + 1] - starts[i];
+        allocate_slots(group_counts + starts[i], n_successors, MAX_FOLLOWING_WORDS, slots);
+        for (int j = 0; j < n_successors; j++) {
+            for (int k = 0; k < slots[j]; k++) link_words(model, model->words + i, model->words + group_seconds[starts[i] + j]);
+        }
+    }
+    free(firsts);
+    free(seconds);
+    free(counts);
+    free(starts);
+    free(group_seconds);
+    free(group_counts);
+    free(fill);
+    free(slots);
+}
+
+/*  Function: compact_starting_words
+*   --------------------------------
+*   Fills sentence_starting_words from the start tallies of the word summary, sharing its MAX_STARTING_WORDS slots
+*   among the model's words in proportion to how often each was seen starting a sentence.
+*/
+void compact_starting_words(Model* model) {
+    double* counts = malloc((model->n_w + 1) * sizeof(double));
+    int* slots = malloc((model->n_w + 1) * sizeof(int));
+    for (int i = 0; i < model->n_w; i++) {
+        counts[i] = hh_tally_count(model->stream->word_counts, i, START_TALLY);
+    }
+    allocate_slots(counts, model->n_w, MAX_STARTING_WORDS, slots);
+    for (int i = 0; i < model->n_w; i++) {
+        for (int k = 0; k < slots[i]; k++) add_starting_word(model, i);
+    }
+    free(counts);
+    free(slots);
+}
+
+/*  Function: clear_words
+*   ---------------------
+*   Empties the model's word and sentence-starting word arrays, freeing the word strings.
+*   The next_words arrays are kept for the words that will next occupy the same slots.
+*/
+void clear_words(Model* model) {
+    for (int i = 0; i < model->n_w; i++) free((model->words)[i].string);
+    model->n_w = 0;
+    model->n_ssw = 0;
+    for (uint32_t i = 0; i <= model->index_mask; i++) model->word_index[i] = -1;
+}
+
+/*  Function: allocate_slots
+*   ------------------------
+*   Shares array slots among n items in proportion to their weights using the largest
+*   remainder method, writing each item's share to slots.  Weights adding up to less than
+*   n_slots only get as many slots as their rounded total, so whole-number counts that fit
+*   are reproduced exactly.  Returns the number of slots used.
+*/
+int allocate_slots(double weights[], int n, int n_slots, int slots[]) {
+    double total = 0;
+    for (int i = 0; i < n; i++) total += weights[i];
+    if (total < n_slots) n_slots = total < 1 ? (total > 0) : (int)(total + 0.5);
+    int n_used = 0;
+    for (int i = 0; i < n; i++) {
+        slots[i] = (int)(weights[i] * n_slots / total);
+        n_used += slots[i];
+    }
+    while (n_used < n_slots) {  // at most n leftover slots, one per largest remainder
+        int best = -1;
+        double best_remainder = -1;
+        for (int i = 0; i < n; i++) {
+            double remainder = weights[i] * n_slots / total - slots[i];
+            if (remainder > best_remainder && remainder < 1 && remainder > 0) {
+                best = i;
+                best_remainder = remainder;
+            }
+        }
+        if (best < 0) break;
+        slots[best]++;
+        n_used++;
+    }
+    return n_used;
+}
+
+/*  Function: create_windowed_model
+*   -------------------------------
+*   Creates an empty live model that only counts the last window sentences ingested.  Exits
+*   if window is not at least one sentence.
+*/
+Model* create_windowed_model(int window) {
+    if (window < 1) {
+        printf("Could not create model, window of %d sentences is too small.\n", window);
+        exit(1);
+    }
+    return initialize_live_model(window, 1);
+}
+
+/*  Function: create_decaying_model
+*   -------------------------------
+*   Creates an empty live model whose counts halve every half_life sentences ingested.
+*/
+Model* create_decaying_model(double half_life) {
+    return initialize_live_model(0, pow(2, 1 / half_life));
+}
+
+/*  Function: initialize_live_model
+*   -------------------------------
+*   Creates a new model with an empty LiveState in the given mode.
+*/
+Model* initialize_live_model(int window, double growth) {
+    Model* model = initialize_model();
+    LiveState* live = malloc(sizeof(LiveState));
+    live->window = window;
+    live->growth = growth;
+    live->scale = 1;
+    live->ring = window ? calloc(window, sizeof(int*)) : NULL;
+    if (window && !live->ring) {
+        printf("Could not create model, window of %d sentences is too large.\n", window);
         exit(1);
     }
+    live->ring_start = 0;
+    live->n_ring = 0;
+    live->current = NULL;
+    live->n_current = 0;
+    live->current_cap = 0;
+    live->n_starters = 0;
+    live->starters_dirty = false;
+    live->n_dirty = 0;
+    live->n_free = 0;
+    for (int i = 0; i < MAX_WORDS_IN_MODEL; i++) {
+        live->words[i].link_targets = NULL;
+        live->words[i].link_weights = NULL;
+        live->words[i].links_cap = 0;
+        live->words[i].dirty = false;
+    }
+    model->live = live;
     return model;
 }
 
+/*  Function: record_live_word
+*   --------------------------
+*   Adds one word to a live model.  Mirrors record_word, but adds the new counts (at the
+*   current scale) to the LiveWords rather than appending to next_words, and marks the words
+*   whose sampling tables they change as dirty.  The word's index is kept in the sentence in
+*   progress until the sentence ends.
+*/
+void record_live_word(Model* model, char* next_word_buf, bool ends_sentence) {
+    LiveState* live = model->live;
+    Word* next_word = add_next_word_to_model(model, next_word_buf, ends_sentence, model->new_sentence);
+    int index = next_word - model->words;
+    live->words[index].weight += live->scale;
+    if (model->new_sentence) add_live_start(model, index, live->scale);
+    else add_live_link(model, model->last_word, index, live->scale);
+    if (ends_sentence) {
+        live->words[index].end_weight += live->scale;
+        mark_dirty(model, index);
+    }
+    if (live->window) {
+        if (live->n_current + 1 >= live->current_cap) {
+            live->current_cap = 2 * live->current_cap + 16;
+            live->current = realloc(live->current, live->current_cap * sizeof(int));
+        }
+        live->current[live->n_current++] = index;
+    }
+    model->new_sentence = ends_sentence;
+    model->last_word = index;
+    if (ends_sentence) end_live_sentence(model);
+}
+
+/*  Function: end_live_sentence
+*   ---------------------------
+*   Advances the live model by one sentence.  In window mode the sentence in progress joins
+*   the ring, expiring the oldest sentence if the ring is full; in decay mode the scale grows,
+*   and the model is pruned once it has grown by PRUNE_SCALE.
+*/
+void end_live_sentence(Model* model) {
+    LiveState* live = model->live;
+    if (live->window) {
+        live->current[live->n_current] = -1;
+        int* sentence = malloc((live->n_current + 1) * sizeof(int));
+        memcpy(sentence, live->current, (live->n_current + 1) * sizeof(int));
+        live->n_current = 0;
+        if (live->n_ring == live->window) {
+            int* oldest = live->ring[live->ring_start];
+            live->ring[live->ring_start] = sentence;
+            live->ring_start = (live->ring_start + 1) % live->window;
+            expire_sentence(model, oldest);
+            free(oldest);
+        } else live->ring[(live->ring_start + live->n_ring++) % live->window] = sentence;
+    } else {
+        live->scale *= live->growth;
+        if (live->scale >= PRUNE_SCALE) prune_live_model(model);
+    }
+}
+
+/*  Function: expire_sentence
+*   -------------------------
+*   Subtracts every count that the sentence (a -1-terminated array of word indices) added,
+*   dropping links whose weight reaches zero and removing words that no longer occur.
+*/
+void expire_sentence(Model* model, int* sentence) {
+    LiveState* live = model->live;
+    add_live_start(model, sentence[0], -1);
+    for (int i = 0; sentence[i] >= 0; i++) {
+        LiveWord* word = live->words + sentence[i];
+        word->weight--;
+        model->words[sentence[i]].n_occurrences--;
+        if (sentence[i + 1] >= 0) add_live_link(model, sentence[i], sentence[i + 1], -1);
+        else {
+            word->end_weight--;
+            mark_dirty(model, sentence[i]);
+        }
+    }
+    for (int i = 0; sentence[i] >= 0; i++) {
+        if (live->words[sentence[i]].weight <= 0 && model->words[sentence[i]].string) remove_word(model, sentence[i]);
+    }
+}
+
+/*  Function: expire_oldest_sentences
+*   ---------------------------------
+*   Makes room for a new word in a full windowed model by expiring the oldest sentences in
+*   the window ahead of time, until one of their words no longer occurs or the window is
+*   empty.  The window is then shorter than requested until enough sentences arrive.
+*/
+void expire_oldest_sentences(Model* model) {
+    LiveState* live = model->live;
+    while (!live->n_free && live->n_ring) {
+        int* oldest = live->ring[live->ring_start];
+        live->ring[live->ring_start] = NULL;
+        live->ring_start = (live->ring_start + 1) % live->window;
+        live->n_ring--;
+        expire_sentence(model, oldest);
+        free(oldest);
+    }
+}
+
+/*  Function: prune_live_model
+*   --------------------------
+*   Divides every weight in a decaying model by the current scale, resetting the scale to 1,
+*   and drops links, start weights and end weights that have decayed below MIN_LIVE_WEIGHT.
+*   A bigram can be no heavier than either of its words, so once a word itself falls below
+*   MIN_LIVE_WEIGHT every link to or from it has been dropped and the word can be removed.
+*   Only words whose links or ender status changed become dirty.
+*/
+void prune_live_model(Model* model) {
+    LiveState* live = model->live;
+    double scale = live->scale;
+    for (int i = 0; i < model->n_w; i++) {
+        if (!model->words[i].string) continue;
+        LiveWord* word = live->words + i;
+        word->weight /= scale;
+        word->start_weight /= scale;
+        word->end_weight /= scale;
+        if (word->start_weight > 0 && word->start_weight < MIN_LIVE_WEIGHT) {
+            add_live_start(model, i, -word->start_weight);
+        }
+        if (word->end_weight > 0 && word->end_weight < MIN_LIVE_WEIGHT) {
+            word->end_weight = 0;
+            mark_dirty(model, i);
+        }
+        int n_kept = 0;
+        for (int j = 0; j < word->n_links; j++) {
+            double weight = word->link_weights[j] / scale;
+            if (weight < MIN_LIVE_WEIGHT) continue;
+            word->link_targets[n_kept] = word->link_targets[j];
+            word->link_weights[n_kept++] = weight;
+        }
+        if (n_kept < word->n_links) mark_dirty(model, i);
+        word->n_links = n_kept;
+    }
+    live->scale = 1;
+    for (int i = 0; i < model->n_w; i++) {
+        if (model->words[i].string && live->words[i].weight < MIN_LIVE_WEIGHT
+            && i != model->last_word) remove_word(model, i);
+    }
+}
+
+/*  Function: add_live_link
+*   -----------------------
+*   Adds weight (possibly negative) to the bigram from word to next_word, creating the link
+*   if needed and dropping it if its weight reaches zero, and marks word as dirty.
+*/
+void add_live_link(Model* model, int word, int next_word, double weight) {
+    LiveWord* live_word = model->live->words + word;
+    mark_dirty(model, word);
+    for (int i = 0; i < live_word->n_links; i++) {
+        if (live_word->link_targets[i] != next_word) continue;
+        live_word->link_weights[i] += weight;
+        if (live_word->link_weights[i] <= 0) {
+            live_word->n_links--;
+            live_word->link_targets[i] = live_word->link_targets[live_word->n_links];
+            live_word->link_weights[i] = live_word->link_weights[live_word->n_links];
+        }
+        return;
+    }
+    if (live_word->n_links == live_word->links_cap) {
+        live_word->links_cap = 2 * live_word->links_cap + 4;
+        live_word->link_targets = realloc(live_word->link_targets, live_word->links_cap * sizeof(int));
+        live_word->link_weights = realloc(live_word->link_weights, live_word->links_cap * sizeof(double));
+    }
+    live_word->link_targets[live_word->n_links] = next_word;
+    live_word->link_weights[live_word->n_links++] = weight;
+}
+
+/*  Function: add_live_start
+*   ------------------------
+*   Adds weight (possibly negative) to the number of times word started a sentence, keeping
+*   the model's list of starters in step, and marks the starting words as out of date.
+*/
+void add_live_start(Model* model, int word, double weight) {
+    LiveState* live = model->live;
+    LiveWord* live_word = live->words + word;
+    live_word->start_weight += weight;
+    live->starters_dirty = true;
+    if (live_word->start_weight > 0 && live_word->starter_pos < 0) {
+        live_word->starter_pos = live->n_starters;
+        live->starters[live->n_starters++] = word;
+    } else if (live_word->start_weight <= 0 && live_word->starter_pos >= 0) {
+        int moved = live->starters[--live->n_starters];
+        live->starters[live_word->starter_pos] = moved;
+        live->words[moved].starter_pos = live_word->starter_pos;
+        live_word->starter_pos = -1;
+        live_word->start_weight = 0;
+    }
+}
+
+/*  Function: mark_dirty
+*   --------------------
+*   Queues word for a refresh of its sampling table, unless it is already queued.
+*/
+void mark_dirty(Model* model, int word) {
+    LiveState* live = model->live;
+    if (live->words[word].dirty) return;
+    live->words[word].dirty = true;
+    live->dirty[live->n_dirty++] = word;
+}
+
+/*  Function: remove_word
+*   ---------------------
+*   Removes a word that no longer has any counts from a live model, keeping its slot (and
+*   its link arrays) for the next new word.
+*/
+void remove_word(Model* model, int word) {
+    LiveState* live = model->live;
+    unindex_word(model, word);
+    free(model->words[word].string);
+    model->words[word].string = NULL;
+    model->words[word].n_nw = 0;
+    live->words[word].n_links = 0;
+    live->free_words[live->n_free++] = word;
+}
+
+/*  Function: refresh_live_words
+*   ----------------------------
+*   Brings the sampling tables of a live model up to date at the end of each ingest, so that
+*   generating and printing only ever read the model.  Each dirty word's next_words array is
+*   rebuilt by sharing its MAX_FOLLOWING_WORDS slots among its links in proportion to their
+*   weights, and sentence_starting_words is rebuilt the same way from the starters if any
+*   start weight changed.  Words that were not touched keep their tables, since decay changes
+*   all of a word's weights in the same proportion.  In decay mode every word's n_occurrences
+*   is also updated to its decayed count.
+*/
+void refresh_live_words(Model* model) {
+    LiveState* live = model->live;
+    int* slots = live->slots;
+    for (int i = 0; i < live->n_dirty; i++) {
+        int index = live->dirty[i];
+        Word* word = model->words + index;
+        LiveWord* live_word = live->words + index;
+        live_word->dirty = false;
+        if (!word->string) continue;
+        allocate_slots(live_word->link_weights, live_word->n_links, MAX_FOLLOWING_WORDS, slots);
+        word->n_nw = 0;
+        for (int j = 0; j < live_word->n_links; j++) {
+            for (int k = 0; k < slots[j]; k++) link_words(model, word, model->words + live_word->link_targets[j]);
+        }
+        word->is_sentence_ender = live_word->end_weight > 0;
+    }
+    live->n_dirty = 0;
+    if (live->starters_dirty) {
+        for (int i = 0; i < live->n_starters; i++) live->weights[i] = live->words[live->starters[i]].start_weight;
+        allocate_slots(live->weights, live->n_starters, MAX_STARTING_WORDS, slots);
+        model->n_ssw = 0;
+        for (int i = 0; i < live->n_starters; i++) {
+            for (int k = 0; k < slots[i]; k++) add_starting_word(model, live->starters[i]);
+        }
+        live->starters_dirty = false;
+    }
+    if (!live->window) {
+        for (int i = 0; i < model->n_w; i++) {
+            model->words[i].n_occurrences = (int)(live->words[i].weight / live->scale + 0.5);
+        }
+    }
+}
+
 /*  Function: initialize_model
 *   --------------------------
 *   Creates a new heap-allocated model and sets its fields to empty.
@@ -147,8 +1013,24 @@ Model* create_model(FILE* text) {
 Model* initialize_model() {
     Model* model = malloc(sizeof(Model));    // declares the model struct
     model->n_w = 0;
+    model->words_cap = 0;
+    model->words = NULL;
     model->n_ssw = 0;
-    srand(time(NULL));
+    model->ssw_cap = 0;
+    model->sentence_starting_words = NULL;
+    model->word_index = NULL;
+    resize_word_index(model, MIN_WORD_INDEX_SIZE);
+    model->last_word = -1;
+    model->new_sentence = true;
+    model->stream = NULL;
+    model->live = NULL;
+    model->cache = NULL;
+    model->mapping = NULL;
+    model->mapping_size = 0;
+    model->huge_pages = false;
+    model->node_replicas = false;
+    model->view = NULL;
+    pthread_mutex_init(&model->view_lock, NULL);
     return model;
 }
 
@@ -197,14 +1079,15 @@ Word* add_next_word_to_model(Model* model, char* next_word_buf, bool ends_senten
 
 /*  Function: search_words
 *   ----------------------
-*   Iterates through the model's array of Word structs, comparing each struct's string field
-*   to next_word_buf and returning a pointer to the matching struct, if it exists, or NULL if
-*   not found.
+*   Looks next_word_buf up in the model's word index, probing from the slot its hash selects
+*   and comparing each indexed word's string field to next_word_buf.  Returns a pointer to
+*   the matching struct, if it exists, or NULL if not found.
 */
 Word* search_words(Model* model, char* next_word_buf) {
-    for (int i = 0; i < model->n_w; i++) {
-        char* word_to_cmp = (model->words[i]).string;
-        if (!strcmp(word_to_cmp, next_word_buf)) return model->words + i;
+    uint32_t mask = model->index_mask;
+    for (uint32_t slot = hash_key(next_word_buf) & mask; model->word_index[slot] >= 0; slot = (slot + 1) & mask) {
+        char* word_to_cmp = (model->words[model->word_index[slot]]).string;
+        if (!strcmp(word_to_cmp, next_word_buf)) return model->words + model->word_index[slot];
     }
     return NULL;
 }
@@ -212,23 +1095,118 @@ Word* search_words(Model* model, char* next_word_buf) {
 /*  Function: create_word
 *   ---------------------
 *   Creates a new Word struct for the found word, appending it to the end of the array of Word
-*   structs in the model.
+*   structs in the model (which grows as needed), or reusing the slot of a removed word in a
+*   live model.  Live models hold at most MAX_WORDS_IN_MODEL words; a full one first makes
+*   room by pruning decayed words or expiring its oldest sentences early, and the function
+*   only exits if that frees nothing, as when one sentence holds that many words.  The word
+*   index is doubled whenever it would become more than half full.
 */
 Word* create_word(Model* model, char* next_word_buf, bool ends_sentence) {
-    (model->words)[model->n_w].string = strdup(next_word_buf);
-    (model->words)[model->n_w].n_occurrences = 1;
-    (model->words)[model->n_w].is_sentence_ender = ends_sentence;
-    (model->words)[model->n_w].n_nw = 0;
-    model->n_w++;
-    return model->words + model->n_w - 1;
+    int index = model->n_w;
+    if (model->live && !model->live->n_free && model->n_w == MAX_WORDS_IN_MODEL) {
+        if (model->live->window) expire_oldest_sentences(model);
+        else prune_live_model(model);  // make room by dropping decayed words early
+    }
+    if (model->live && model->live->n_free) index = model->live->free_words[--model->live->n_free];
+    else if (model->live && model->n_w == MAX_WORDS_IN_MODEL) {
+        printf("Could not add \"%s\", model is full.\n", next_word_buf);
+        exit(1);
+    } else {
+        if (model->n_w == model->words_cap) {
+            model->words_cap = 2 * model->words_cap + 64;
+            model->words = realloc(model->words, model->words_cap * sizeof(Word));
+            for (int i = model->n_w; i < model->words_cap; i++) {
+                model->words[i].nw_cap = 0;
+                model->words[i].next_words = NULL;
+            }
+        }
+        model->n_w++;
+    }
+    (model->words)[index].string = strdup(next_word_buf);
+    (model->words)[index].n_occurrences = 1;
+    (model->words)[index].is_sentence_ender = ends_sentence;
+    (model->words)[index].n_nw = 0;
+    if (model->live) {
+        LiveWord* live_word = model->live->words + index;
+        live_word->weight = 0;
+        live_word->start_weight = 0;
+        live_word->end_weight = 0;
+        live_word->n_links = 0;
+        live_word->starter_pos = -1;  // dirty is left alone, the slot may still be queued
+    }
+    if (2 * (uint32_t)model->n_w > model->index_mask + 1) resize_word_index(model, 2 * (model->index_mask + 1));
+    else index_word(model, index);
+    return model->words + index;
+}
+
+/*  Function: index_word
+*   --------------------
+*   Adds the word at the given index to the model's word index, in the first empty slot at or
+*   after the slot its hash selects.
+*/
+void index_word(Model* model, int word) {
+    uint32_t mask = model->index_mask;
+    uint32_t slot = hash_key(model->words[word].string) & mask;
+    while (model->word_index[slot] >= 0) slot = (slot + 1) & mask;
+    model->word_index[slot] = word;
+}
+
+/*  Function: unindex_word
+*   ----------------------
+*   Removes the word at the given index from the model's word index, shifting later words of
+*   the same probe run back into the gap so that lookups never stop short of them.
+*/
+void unindex_word(Model* model, int word) {
+    uint32_t mask = model->index_mask;
+    uint32_t gap = hash_key(model->words[word].string) & mask;
+    while (model->word_index[gap] != word) gap = (gap + 1) & mask;
+    for (uint32_t slot = (gap + 1) & mask; model->word_index[slot] >= 0; slot = (slot + 1) & mask) {
+        uint32_t home = hash_key(model->words[model->word_index[slot]].string) & mask;
+        if (((slot - home) & mask) >= ((slot - gap) & mask)) {
+            model->word_index[gap] = model->word_index[slot];
+            gap = slot;
+        }
+    }
+    model->word_index[gap] = -1;
+}
+
+/*  Function: resize_word_index
+*   ---------------------------
+*   Replaces the model's word index with an empty one of size slots (a power of two), then
+*   indexes every word in the model again.
+*/
+void resize_word_index(Model* model, uint32_t size) {
+    free(model->word_index);
+    model->word_index = malloc(size * sizeof(int));
+    model->index_mask = size - 1;
+    for (uint32_t i = 0; i < size; i++) model->word_index[i] = -1;
+    for (int i = 0; i < model->n_w; i++) {
+        if (model->words[i].string) index_word(model, i);
+    }
+}
+
+/*  Function: add_starting_word
+*   ---------------------------
+*   Appends the word at the given index to sentence_starting_words, growing it as needed.
+*/
+void add_starting_word(Model* model, int word) {
+    if (model->n_ssw == model->ssw_cap) {
+        model->ssw_cap = 2 * model->ssw_cap + 16;
+        model->sentence_starting_words = realloc(model->sentence_starting_words, model->ssw_cap * sizeof(int));
+    }
+    model->sentence_starting_words[model->n_ssw++] = word;
 }
 
 /*  Function: link_words
 *   --------------------
-*   Adds next_word to the next_words array of this_word.
+*   Adds next_word to the next_words array of this_word, growing the array as needed.
 */
-void link_words(Word* this_word, Word* next_word) {
-    (this_word->next_words)[this_word->n_nw++] = next_word;
+void link_words(Model* model, Word* this_word, Word* next_word) {
+    if (this_word->n_nw == this_word->nw_cap) {
+        this_word->nw_cap = 2 * this_word->nw_cap + 4;
+        this_word->next_words = realloc(this_word->next_words, this_word->nw_cap * sizeof(int));
+    }
+    (this_word->next_words)[this_word->n_nw++] = next_word - model->words;
 }
 
 /*  Function: print_model
@@ -236,109 +1214,1566 @@ void link_words(Word* this_word, Word* next_word) {
 *   Prints all elements in the model.
 */
 void print_model(Model* model) {
-    printf("----------MODEL----------\n");
-    printf("---Model size: %d words\n", model->n_w);
-    printf("---Words:\n");
-    for (int i = 0; i < model->n_w; i++) {
-        Word word = (model->words)[i];
-        printf("%s (%d)", word.string, word.n_occurrences);
-        if (word.is_sentence_ender) printf(" (se)");
-        printf(": ");
-        for (int j = 0; j < word.n_nw; j++) {
-            printf("%s ", ((Word*)(word.next_words)[j])->string);
-        }
-        printf("\n");
-    }
-    printf("---Sentence-starting words (%d):\n", model->n_ssw);
-    for (int i = 0; i < model->n_ssw; i++) {
-        Word* word = (model->sentence_starting_words)[i];
-        printf("%s\n", word->string);
+    fflush(stdout);
+    write_model(model, stdout, ORDER_INGESTED, false);
+}
+
+/*  Function: compare_by_frequency / compare_alphabetically
+*   -------------------------------------------------------
+*   qsort comparators for arrays of Word pointers: most occurrences first, ties broken
+*   alphabetically; or by string alone.
+*/
+int compare_by_frequency(const void* a, const void* b) {
+    const Word* first = *(Word* const*)a;
+    const Word* second = *(Word* const*)b;
+    if (first->n_occurrences != second->n_occurrences) {
+        return first->n_occurrences > second->n_occurrences ? -1 : 1;
     }
-    printf("---------------------------\n");
+    return strcmp(first->string, second->string);
+}
+
+int compare_alphabetically(const void* a, const void* b) {
+    return strcmp((*(Word* const*)a)->string, (*(Word* const*)b)->string);
+}
+
+/*  Function: compare_ints
+*   ----------------------
+*   qsort comparator for ascending ints.
+*/
+int compare_ints(const void* a, const void* b) {
+    int first = *(const int*)a, second = *(const int*)b;
+    return (first > second) - (first < second);
 }
 
 /*  Function: generate_sentence
 *   ---------------------------
-*   Finds a set of pattern-matched Word structs, then combines them into one
-*   heap-allocated sentence string and returns a pointer to it.
+*   Takes a ready sentence from the model's cache if it has one.  Otherwise finds a set of
+*   pattern-matched Word structs, then combines them into one heap-allocated sentence string
+*   and returns a pointer to it.
 */
 char* generate_sentence(Model* model, int length) {
+    return generate_sentence_cancellable(model, length, NULL);
+}
+
+/*  Function: generate_sentence_cancellable
+*   ---------------------------------------
+*   Does the work of generate_sentence, taking a cached sentence if there is one and
+*   otherwise searching with search_sentence.
+*/
+char* generate_sentence_cancellable(Model* model, int length, const bool* cancelled) {
+    if (length < 1) return NULL;
+    char* cached;
+    if (model->cache && take_cached_sentence(model->cache, length, &cached)) return cached;
+    return search_sentence(model, length, cancelled);
+}
+
+/*  Function: generate_sentence_seeded
+*   ----------------------------------
+*   Searches with every draw taken from a RandomStream for the seed and index, made the
+*   thread's current_stream for the length of the search.  The search makes the same draws
+*   in the same order each time, as its restarts and failure set depend only on what it has
+*   drawn and found.
+*/
+char* generate_sentence_seeded(Model* model, int length, uint64_t seed, uint64_t index) {
+    if (length < 1) return NULL;
+    RandomStream stream;
+    start_random_stream(&stream, seed, index);
+    RandomStream* previous = current_stream;
+    current_stream = &stream;
+    char* sentence = search_sentence(model, length, NULL);
+    current_stream = previous;
+    return sentence;
+}
+
+/*  Function: search_sentence
+*   -------------------------
+*   Finds a sentence with search_with_restarts, giving the search a context through which
+*   another thread can stop it, and returns it heap-allocated, or NULL if there is none.
+*/
+char* search_sentence(Model* model, int length, const bool* cancelled) {
     Word* sentence[length];
-    if (!find_words(model, length, sentence)) {
-        return NULL;
-    }
+    SearchContext context;
+    memset(&context, 0, sizeof(context));
+    context.view = get_generation_view(model);
+    context.cancelled = cancelled;
+    bool found = search_with_restarts(model, length, sentence, &context);
+    free(context.scratch);
+    free(context.failures);
+    if (!found) return NULL;
     return combine_words(sentence, length);
 }
 
-/*  Function: find_words
-*   --------------------
-*   For each word in sentence_starting_words (selected in random order), the function calls
-*   find_words_recursive to attempt to create a sentence from that initial word.  If an attempt
-*   succeeds, the function returns 'true' with a populated sentence array; if none succeed the
-*   function returns false.
-*/
-bool find_words(Model* model, int length, Word* sentence[]) {
-    bool ssw_checked[model->n_ssw];
-    for (int i = 0; i < model->n_ssw; i++) ssw_checked[i] = false;
-    while(not_all_checked(ssw_checked, model->n_ssw)) {
-        int ssw_index = random_int(0, model->n_ssw - 1);
-        if (!ssw_checked[ssw_index]) {
-            ssw_checked[ssw_index] = true;
-            sentence[0] = model->sentence_starting_words[ssw_index];
-            if (find_words_recursive(length, sentence, 0)) return true;
-        }
-    }
-    return false;
+/*  Function: generate_sentence_portfolio
+*   -------------------------------------
+*   Hands n_searches - 1 searches to the library's worker pool and runs one more on the
+*   calling thread, then waits only for the searches that have already started, which stop
+*   within a frame once done is set.  Searches still queued find the race over and return
+*   without searching, so the call never waits on the pool, even from one of its threads.
+*/
+char* generate_sentence_portfolio(Model* model, int length, int n_searches) {
+    if (n_searches <= 1) return generate_sentence(model, length);
+    if (length < 1) return NULL;
+    char* cached;
+    if (model->cache && take_cached_sentence(model->cache, length, &cached)) return cached;
+    get_generation_view(model);
+    Portfolio* portfolio = calloc(1, sizeof(Portfolio));
+    portfolio->model = model;
+    portfolio->length = length;
+    portfolio->n_refs = n_searches;
+    pthread_mutex_init(&portfolio->lock, NULL);
+    pthread_cond_init(&portfolio->finished, NULL);
+    WorkerPool* pool = library_worker_pool();
+    for (int i = 1; i < n_searches; i++) submit_task(pool, run_portfolio_search, portfolio);
+    search_portfolio(portfolio);
+    pthread_mutex_lock(&portfolio->lock);
+    __atomic_store_n(&portfolio->done, true, __ATOMIC_RELAXED);
+    while (portfolio->n_running > 0) pthread_cond_wait(&portfolio->finished, &portfolio->lock);
+    char* sentence = portfolio->winner;
+    portfolio->winner = NULL;
+    pthread_mutex_unlock(&portfolio->lock);
+    release_portfolio(portfolio);
+    return sentence;
 }
 
-/*  Function: find_words_recursive
+/*  Function: run_portfolio_search
 *   ------------------------------
-*   First checks the base case where the recursion has found enough words to create a sentence;
-*   the function returns true all the way down the stack if the final word is a sentence ender
-*   and returns false to the previous stack frame if not.  For non-base-cases, the function
-*   zeros out the array that keeps track of which next_words elements it has already tested,
-*   then randomly selects next_words elements that have not been previously tried to append
-*   to the sentence and recursively test until all elements have been tested.  A success at
-*   sentence end propagates a 'true' value back to the calling function; 'false' is returned
-*   when none work.  LIMITATION: because of how the next words are stored, the function may
-*   unnecessarily test duplicate entries of the same next_word.
-*/
-bool find_words_recursive(int length, Word* sentence[], int cur_index) {
-    if (length == cur_index + 1) {
-        if (sentence[length - 1]->is_sentence_ender) return true;
-        else return false;
-    }
-    Word* this_word = sentence[cur_index];
-    for (int i = 0; i < this_word->n_nw; i++) this_word->tested[i] = false;
-    while(not_all_checked(this_word->tested, this_word->n_nw)) {
-        int nw_index = random_int(0, this_word->n_nw - 1);
-        if (!this_word->tested[nw_index]) {
-            this_word->tested[nw_index] = true;
-            Word* next_word = this_word->next_words[nw_index];
-            sentence[cur_index + 1] = next_word;
-            if (find_words_recursive(length, sentence, cur_index + 1)) return true;
-        }
-    }
-    return false;
+*   Runs on a worker thread.  Takes part in the race, then drops the task's reference.
+*/
+void run_portfolio_search(void* portfolio_ptr) {
+    Portfolio* portfolio = portfolio_ptr;
+    search_portfolio(portfolio);
+    release_portfolio(portfolio);
 }
 
-/*  Function: not_all_checked
-*   -------------------------
-*   Returns true if any of the boolean values in the passed_array are 'false.'
+/*  Function: search_portfolio
+*   --------------------------
+*   Joins the race unless it is already over, and runs a search with its own context, and
+*   so its own failure set and random order, that gives up as soon as done is set.  The
+*   first search to find a sentence keeps it as the winner; a later one discards its own.
+*   A search that exhausts every option proves that no sentence exists, which ends the race
+*   just as a find does.
 */
-bool not_all_checked(bool array[], int n_elems) {
-    for (int i = 0; i < n_elems; i++) {
-        if (!array[i]) return true;
+void search_portfolio(Portfolio* portfolio) {
+    pthread_mutex_lock(&portfolio->lock);
+    bool over = __atomic_load_n(&portfolio->done, __ATOMIC_RELAXED);
+    if (!over) portfolio->n_running++;
+    pthread_mutex_unlock(&portfolio->lock);
+    if (over) return;
+    int length = portfolio->length;
+    Word* sentence[length];
+    SearchContext context;
+    memset(&context, 0, sizeof(context));
+    context.view = get_generation_view(portfolio->model);
+    context.cancelled = &portfolio->done;
+    bool found = search_with_restarts(portfolio->model, length, sentence, &context);
+    bool exhausted = !found && !context.given_up;
+    free(context.scratch);
+    free(context.failures);
+    char* combined = found ? combine_words(sentence, length) : NULL;
+    pthread_mutex_lock(&portfolio->lock);
+    if (combined && !portfolio->winner) {
+        portfolio->winner = combined;
+        combined = NULL;
     }
-    return false;
+    if (found || exhausted) __atomic_store_n(&portfolio->done, true, __ATOMIC_RELAXED);
+    if (--portfolio->n_running == 0) pthread_cond_signal(&portfolio->finished);
+    pthread_mutex_unlock(&portfolio->lock);
+    free(combined);
 }
 
-/*  Function: combine_words
-*   -----------------------
+/*  Function: release_portfolio
+*   ---------------------------
+*   Drops one reference, freeing the portfolio if it was the last.
+*/
+void release_portfolio(Portfolio* portfolio) {
+    if (__atomic_sub_fetch(&portfolio->n_refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    free(portfolio->winner);
+    pthread_mutex_destroy(&portfolio->lock);
+    pthread_cond_destroy(&portfolio->finished);
+    free(portfolio);
+}
+
+/*  Function: enable_sentence_cache
+*   -------------------------------
+*   Starts the model's sentence cache.  A live model's sampling tables are already up to
+*   date, since ingest_text refreshes them at the end of each ingest, and ingest_text refuses
+*   a model with a cache.  Does nothing if the model already has one.
+*/
+void enable_sentence_cache(Model* model, int capacity) {
+    if (model->cache) return;
+    model->cache = create_sentence_cache(model, capacity);
+}
+
+/*  Function: generate_sentences
+*   ----------------------------
+*   Generates n sentences of the same length at once.  Instead of backtracking, the function
+*   first works out which words can still reach a sentence ender in exactly the right number
+*   of steps, then makes each sentence with a single walk that only ever picks such words,
+*   many walks at a time through walk_sentences.  Picking uniformly among the feasible
+*   entries is exactly what the backtracking search ends up doing, so the sentences follow
+*   the same distribution as generate_sentence's.  Returns n, or 0 if no sentence of that
+*   length can be made.
+*/
+int generate_sentences(Model* model, int length, int n, char* sentences[]) {
+    if (length < 1 || n < 1) return 0;
+    uint64_t* reachable = find_reachable(model, length);
+    int n_made = walk_sentences(model, length, reachable, n, sentences, NULL, 0);
+    free(reachable);
+    return n_made;
+}
+
+/*  Function: generate_sentences_from
+*   ---------------------------------
+*   generate_sentences without the table-building step.
+*/
+int generate_sentences_from(Model* model, int length, uint64_t reachable[], int n, char* sentences[]) {
+    if (length < 1 || n < 1) return 0;
+    return walk_sentences(model, length, reachable, n, sentences, NULL, 0);
+}
+
+/*  Function: generate_sentences_seeded
+*   -----------------------------------
+*   Works out the reachable table once, then splits the sentences into contiguous ranges,
+*   one per thread, each made by walk_sentences with its sentences' indices in the seeded
+*   sequence.  Every sentence is made from its own stream, so how the sentences are split
+*   makes no difference to them.  With node replicas enabled, the threads are dealt out
+*   to the NUMA nodes in turn, and none of the ranges runs on the calling thread, which is
+*   bound to no node.
+*/
+int generate_sentences_seeded(Model* model, int length, uint64_t seed, uint64_t first_index, int n, char* sentences[], int n_threads) {
+    if (length < 1 || n < 1) return 0;
+    if (n_threads < 1) n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads > n) n_threads = n;
+    if (n_threads < 1) n_threads = 1;
+    uint64_t* reachable = find_reachable(model, length);
+    int n_nodes = numa_node_count();
+    bool bound = model->node_replicas && n_nodes > 1;
+    SeededRange ranges[n_threads];
+    for (int t = n_threads - 1; t >= 0; t--) {
+        int first = (int64_t)n * t / n_threads;
+        ranges[t].model = model;
+        ranges[t].length = length;
+        ranges[t].reachable = reachable;
+        ranges[t].seed = seed;
+        ranges[t].first_index = first_index + first;
+        ranges[t].n = (int64_t)n * (t + 1) / n_threads - first;
+        ranges[t].sentences = sentences + first;
+        ranges[t].node = bound ? t % n_nodes : -1;
+        if (t || bound) start_range_thread(&ranges[t]);
+    }
+    if (!bound) walk_seeded_range(&ranges[0]);
+    bool made = true;
+    for (int t = 0; t < n_threads; t++) {
+        if (t || bound) pthread_join(ranges[t].thread, NULL);
+        made = made && ranges[t].n_made;
+    }
+    free(reachable);
+    if (made) return n;
+    for (int t = 0; t < n_threads; t++) {
+        for (int i = 0; i < ranges[t].n_made; i++) free(ranges[t].sentences[i]);
+    }
+    return 0;
+}
+
+/*  Function: walk_seeded_range
+*   ---------------------------
+*   Thread function that makes the range's sentences with walk_sentences.  A thread bound
+*   to a node walks that node's replica of the view, and its own copy of the reachable
+*   table; both are written by threads on the node, so the kernel places them there.
+*/
+void* walk_seeded_range(void* range_ptr) {
+    SeededRange* range = range_ptr;
+    uint64_t* reachable = range->reachable;
+    if (range->node >= 0) {
+        local_view = get_node_view(range->model, range->node);
+        size_t size = ((size_t)range->length * (((size_t)range->model->n_w + 63) / 64) + 1) * sizeof(uint64_t);
+        reachable = malloc(size);
+        memcpy(reachable, range->reachable, size);
+    }
+    range->n_made = walk_sentences(range->model, range->length, reachable, range->n, range->sentences, &range->seed, range->first_index);
+    if (range->node >= 0) {
+        local_view = NULL;
+        free(reachable);
+    }
+    return NULL;
+}
+
+/*  Function: start_range_thread
+*   ----------------------------
+*   Starts the range's thread, bound to the processors of its node if it has one.  Should
+*   the binding be refused, as when the process may not run on that node, the thread runs
+*   unbound and still walks the node's replica.  Exits if no thread can be started.
+*/
+void start_range_thread(SeededRange* range) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (range->node >= 0) bind_to_node(&attr, range->node);
+    if (pthread_create(&range->thread, &attr, walk_seeded_range, range)
+        && pthread_create(&range->thread, NULL, walk_seeded_range, range)) {
+        printf("Could not start sentence generation thread.\n");
+        exit(1);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/*  Function: sample_sentence
+*   -------------------------
+*   Makes one sentence with walk_sentence from a table made by find_reachable for the same
+*   length, and returns it heap-allocated, or returns NULL if no sentence of that length can
+*   be made.
+*/
+char* sample_sentence(Model* model, int length, uint64_t reachable[]) {
+    Word* sentence[length];
+    if (!walk_sentence(model, length, reachable, sentence)) return NULL;
+    return combine_words(sentence, length);
+}
+
+/*  Function: find_reachable
+*   ------------------------
+*   Returns a heap-allocated table of length rows, each a bitset over the model's words in
+*   which bit w of row k is set if a sentence ender can be reached from word w in exactly k
+*   more words.  Row 0 marks the sentence enders.  Each later row is filled in 64 words at a
+*   time from the generation view's lists, in ranges of row words split among one thread per
+*   REACHABLE_WORDS_PER_THREAD words, up to one per processor.  Since each row depends only
+*   on the one before it, once a row repeats an earlier one the rest of the table repeats
+*   with the same period, and is copied rather than worked out.  Exits if a thread cannot be
+*   started.
+*/
+uint64_t* find_reachable(Model* model, int length) {
+    ReachableJob job;
+    job.view = get_generation_view(model);
+    job.n_w = model->n_w;
+    job.length = length;
+    job.row_size = ((size_t)job.n_w + 63) / 64;
+    job.rows = calloc((size_t)length * job.row_size + 1, sizeof(uint64_t));
+    if (model->huge_pages) advise_huge_pages(job.rows, ((size_t)length * job.row_size + 1) * sizeof(uint64_t));
+    for (int w = 0; w < job.n_w; w++) {
+        if (model->words[w].is_sentence_ender) job.rows[w / 64] |= (uint64_t)1 << (w % 64);
+    }
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads > job.n_w / REACHABLE_WORDS_PER_THREAD) n_threads = job.n_w / REACHABLE_WORDS_PER_THREAD;
+    if (n_threads < 1) n_threads = 1;
+    ReachableRange ranges[n_threads];
+    pthread_barrier_init(&job.barrier, NULL, n_threads);
+    for (int t = n_threads - 1; t >= 0; t--) {
+        ranges[t].job = &job;
+        ranges[t].first = job.row_size * t / n_threads;
+        ranges[t].last = job.row_size * (t + 1) / n_threads;
+        if (t && pthread_create(&ranges[t].thread, NULL, fill_reachable_range, &ranges[t])) {
+            printf("Could not start reachability thread.\n");
+            exit(1);
+        }
+    }
+    fill_reachable_range(&ranges[0]);
+    for (int t = 1; t < n_threads; t++) pthread_join(ranges[t].thread, NULL);
+    pthread_barrier_destroy(&job.barrier);
+    int period = ranges[0].period;
+    for (int k = ranges[0].last_row + 1; k < length; k++) {
+        memcpy(job.rows + k * job.row_size, job.rows + (k - period) * job.row_size, job.row_size * sizeof(uint64_t));
+    }
+    return job.rows;
+}
+
+/*  Function: reachable_size
+*   ------------------------
+*   Returns the size of find_reachable's table: length rows of one bit per word.
+*/
+size_t reachable_size(Model* model, int length) {
+    return (size_t)length * (((size_t)model->n_w + 63) / 64) * sizeof(uint64_t);
+}
+
+/*  Function: fill_reachable_range
+*   ------------------------------
+*   Thread function that fills the range's words of each row in turn.  Each row word is
+*   built up in a register, 64 words of the model at a time, by fill_row_word, or eight at a
+*   time by fill_row_word_avx2 if the processor has AVX2, and stored once, so no two threads
+*   ever write the same memory.  After each row every thread waits for the rest, then checks
+*   on its own whether the row repeats, so they all stop after the same row.
+*/
+void* fill_reachable_range(void* range_ptr) {
+    ReachableRange* range = range_ptr;
+    ReachableJob* job = range->job;
+    range->last_row = job->length - 1;
+    range->period = 0;
+#ifdef WALK_AVX2
+    bool vector = use_vector_kernels && __builtin_cpu_supports("avx2");
+#endif
+    for (int k = 1; k < job->length; k++) {
+        uint64_t* row = job->rows + k * job->row_size;
+        uint64_t* previous = row - job->row_size;
+        for (size_t i = range->first; i < range->last; i++) {
+            int first_word = i * 64;
+            int n_bits = job->n_w - first_word < 64 ? job->n_w - first_word : 64;
+#ifdef WALK_AVX2
+            if (vector) {
+                row[i] = fill_row_word_avx2(job->view, previous, first_word, n_bits);
+                continue;
+            }
+#endif
+            row[i] = fill_row_word(job->view, previous, first_word, n_bits);
+        }
+        pthread_barrier_wait(&job->barrier);
+        int period = find_repeated_row(job, k);
+        if (period) {
+            range->last_row = k;
+            range->period = period;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*  Function: fill_row_word
+*   -----------------------
+*   Returns the row word for the n_bits model words from first_word, built up in a register
+*   by testing each word's viable successors in the row before until one is set.
+*/
+uint64_t fill_row_word(GenerationView* view, uint64_t previous[], int first_word, int n_bits) {
+    uint64_t bits = 0;
+    for (int b = 0; b < n_bits; b++) {
+        int* next = view->next[first_word + b];
+        int n_next = view->n_next[first_word + b];
+        for (int j = 0; j < n_next; j++) {
+            if (test_bit(previous, next[j])) {
+                bits |= (uint64_t)1 << b;
+                break;
+            }
+        }
+    }
+    return bits;
+}
+
+/*  Function: find_repeated_row
+*   ---------------------------
+*   Returns how many rows back row k last appeared, looking up to REACHABLE_PERIODS rows
+*   back, or 0 if it did not.
+*/
+int find_repeated_row(ReachableJob* job, int k) {
+    size_t bytes = job->row_size * sizeof(uint64_t);
+    for (int period = 1; period <= REACHABLE_PERIODS && period <= k; period++) {
+        if (!memcmp(job->rows + k * job->row_size, job->rows + (k - period) * job->row_size, bytes)) return period;
+    }
+    return 0;
+}
+
+/*  Function: test_bit
+*   ------------------
+*   Returns bit index of the bitset.
+*/
+bool test_bit(uint64_t bits[], int index) {
+    return bits[(unsigned)index / 64] >> ((unsigned)index % 64) & 1;
+}
+
+/*  Function: walk_sentence
+*   -----------------------
+*   Fills sentence with a random walk guided by the reachable table: the first word is drawn
+*   uniformly from the sentence_starting_words entries that can reach an ender in length - 1
+*   more words, and each later word from the current word's next_words entries that can
+*   reach one in the number of words still to come.  Only entries in the generation view's
+*   lists can, so those are the lists drawn from.  Up to WALK_DRAWS entries are drawn at
+*   random until one is feasible, which is usually the first, before falling back on
+*   pick_feasible; either way each feasible entry is equally likely.  Returns false if no
+*   entry qualifies.
+*/
+bool walk_sentence(Model* model, int length, uint64_t reachable[], Word* sentence[]) {
+    GenerationView* view = get_generation_view(model);
+    size_t row_size = ((size_t)model->n_w + 63) / 64;
+    int* entries = view->starts;
+    int n_entries = view->n_starts;
+    for (int i = 0; i < length; i++) {
+        uint64_t* row = reachable + (size_t)(length - 1 - i) * row_size;
+        if (!n_entries) return false;
+        int w = -1;
+        for (int draw = 0; draw < WALK_DRAWS && w < 0; draw++) {
+            int entry = entries[random_int(0, n_entries - 1)];
+            if (test_bit(row, entry)) w = entry;
+        }
+        if (w < 0) w = pick_feasible(entries, n_entries, row);
+        if (w < 0) return false;
+        sentence[i] = model->words + w;
+        entries = view->next[w];
+        n_entries = view->n_next[w];
+    }
+    return true;
+}
+
+/*  Function: pick_feasible
+*   -----------------------
+*   Counts the entries set in the reachable table row and returns one of them picked
+*   uniformly, or -1 if there are none.
+*/
+int pick_feasible(int entries[], int n_entries, uint64_t row[]) {
+    int n_feasible = 0;
+    for (int j = 0; j < n_entries; j++) n_feasible += test_bit(row, entries[j]);
+    if (!n_feasible) return -1;
+    int pick = random_int(0, n_feasible - 1);
+    for (int j = 0; ; j++) {
+        if (test_bit(row, entries[j]) && !pick--) return entries[j];
+    }
+}
+
+/*  Function: feasible_entries
+*   --------------------------
+*   Returns a heap-allocated array of the entries set in the reachable table row, in order,
+*   and sets n_feasible to their number.
+*/
+int* feasible_entries(int entries[], int n_entries, uint64_t row[], int* n_feasible) {
+    int* feasible = malloc((n_entries + 1) * sizeof(int));
+    *n_feasible = 0;
+    for (int i = 0; i < n_entries; i++) {
+        if (test_bit(row, entries[i])) feasible[(*n_feasible)++] = entries[i];
+    }
+    return feasible;
+}
+
+/*  Function: walk_sentences
+*   ------------------------
+*   Makes n sentences with the same walks as walk_sentence, but keeps WALK_LANES of them
+*   under way at once and turns to each in turn.  Every step of a walk is a chain of
+*   dependent loads (the word's list, the entry drawn from it, that entry's bit in the
+*   table) which on a model larger than the cache each miss, so each turn takes a lane one
+*   load along and prefetches the next, which has arrived by the time the lane's next turn
+*   comes round.  Lanes draw in interleaved order, so the sentences differ from
+*   walk_sentence's for the same seed but follow the same distribution.  Every walk starts
+*   from the same list and row, so the feasible starting words are found once, and first
+*   words are drawn from those alone.  Given a seed, sentence i draws from a RandomStream
+*   for the seed and first_index + i, made current while its lane takes its turn.  On a
+*   processor with AVX2 the walks are left to walk_sentences_avx2 instead, which makes the
+*   same sentences from the same seed.  Returns n, or 0, with no sentences left allocated,
+*   if no sentence of that length can be made.
+*/
+int walk_sentences(Model* model, int length, uint64_t reachable[], int n, char* sentences[], const uint64_t* seed, uint64_t first_index) {
+#ifdef WALK_AVX2
+    if (use_vector_kernels && __builtin_cpu_supports("avx2")) return walk_sentences_avx2(model, length, reachable, n, sentences, seed, first_index);
+#endif
+    GenerationView* view = local_view ? local_view : get_generation_view(model);
+    size_t row_size = ((size_t)model->n_w + 63) / 64;
+    int n_starts;
+    int* starts = feasible_entries(view->starts, view->n_starts, reachable + (size_t)(length - 1) * row_size, &n_starts);
+    WalkLane lanes[WALK_LANES];
+    Word** lane_words = malloc(WALK_LANES * length * sizeof(Word*));
+    for (int l = 0; l < WALK_LANES; l++) {
+        lanes[l].sentence = -1;
+        lanes[l].words = lane_words + l * length;
+    }
+    for (int i = 0; i < n; i++) sentences[i] = NULL;
+    int n_started = 0, n_made = 0;
+    bool failed = false;
+    RandomStream* previous = current_stream;
+    while (n_made < n && !failed) {
+        for (int l = 0; l < WALK_LANES && !failed; l++) {
+            WalkLane* lane = lanes + l;
+            if (seed) current_stream = &lane->stream;
+            if (lane->sentence < 0) {
+                if (n_started == n) continue;
+                lane->sentence = n_started++;
+                if (seed) start_random_stream(&lane->stream, *seed, first_index + lane->sentence);
+                lane->step = 0;
+                lane->entries = starts;
+                lane->n_entries = n_starts;
+                lane->row = reachable + (size_t)(length - 1) * row_size;
+                lane->draws = 0;
+                draw_entry(lane);
+            }
+            if (!advance_walk(model, view, lane, length, row_size)) failed = true;
+            else if (lane->step == length) {
+                sentences[lane->sentence] = combine_words(lane->words, length);
+                lane->sentence = -1;
+                n_made++;
+            }
+        }
+    }
+    current_stream = previous;
+    free(lane_words);
+    free(starts);
+    if (!failed) return n;
+    for (int i = 0; i < n; i++) free(sentences[i]);
+    return 0;
+}
+
+/*  Function: advance_walk
+*   ----------------------
+*   Takes the lane through its next stage and prefetches what the stage after will load.
+*   Once a word is chosen, its view lists and Word struct are prefetched; on the next turn
+*   the list is loaded and an entry drawn and prefetched, and on the one after the entry's
+*   table word is prefetched, to be tested on the turn after that.  A walk that has drawn
+*   WALK_DRAWS infeasible entries for a word picks with pick_feasible, as walk_sentence
+*   does.  Returns false if no entry qualifies.
+*/
+bool advance_walk(Model* model, GenerationView* view, WalkLane* lane, int length, size_t row_size) {
+    if (lane->stage == WALK_LIST) {
+        __builtin_prefetch(model->words[lane->word].string);
+        lane->entries = view->next[lane->word];
+        lane->n_entries = view->n_next[lane->word];
+        draw_entry(lane);
+        return true;
+    }
+    if (lane->stage == WALK_ENTRY) {
+        if (!lane->n_entries) return false;
+        __builtin_prefetch(lane->row + (unsigned)*lane->drawn / 64);
+        lane->stage = WALK_TEST;
+        return true;
+    }
+    int w = test_bit(lane->row, *lane->drawn) ? *lane->drawn : -1;
+    if (w < 0 && lane->draws < WALK_DRAWS) {
+        draw_entry(lane);
+        return true;
+    }
+    if (w < 0) w = pick_feasible(lane->entries, lane->n_entries, lane->row);
+    if (w < 0) return false;
+    lane->words[lane->step++] = model->words + w;
+    lane->word = w;
+    lane->draws = 0;
+    if (lane->step == length) return true;
+    lane->row -= row_size;
+    __builtin_prefetch(view->next + w);
+    __builtin_prefetch(view->n_next + w);
+    __builtin_prefetch(model->words + w);
+    lane->stage = WALK_LIST;
+    return true;
+}
+
+/*  Function: draw_entry
+*   --------------------
+*   Draws an entry uniformly from the lane's list, prefetches it and sets the lane to read
+*   it next.  Draws nothing from an empty list, which advance_walk then reports.
+*/
+void draw_entry(WalkLane* lane) {
+    if (lane->n_entries) {
+        lane->drawn = lane->entries + random_int(0, lane->n_entries - 1);
+        __builtin_prefetch(lane->drawn);
+        lane->draws++;
+    }
+    lane->stage = WALK_ENTRY;
+}
+
+#ifdef WALK_AVX2
+/*  Function: walk_sentences_avx2
+*   -----------------------------
+*   Does walk_sentences' work with each of VECTOR_GROUPS groups of VECTOR_LANES walks taking
+*   its steps together, one walk per 32-bit lane.  Each lane draws from its own RandomStream,
+*   kept in vectors and advanced by hash_draws, with random keys when there is no seed.  Each
+*   draw is made for every lane at once: the lanes' random numbers are scaled to each lane's
+*   list size by taking the high half of their product, as random_int does with a stream, the
+*   entries are gathered from the lanes' lists, and their bits in the reachable table are
+*   gathered and tested by test_bits_avx2.  As in walk_sentences, the groups take turns a
+*   stage at a time, and each turn prefetches the lines its group's next gather will load.
+*   Lanes keep drawing until their entry is feasible, and after WALK_DRAWS draws any lane
+*   still without one picks with pick_feasible, as walk_sentence does.  Only pending lanes
+*   count a draw, so each lane makes exactly the draws walk_sentences would for its sentence.
+*   First words are drawn from the feasible starting words alone, as in walk_sentences.  A
+*   word chosen while words remain to come always has a feasible successor, so once a
+*   starting word can be found no walk fails, and the lists gathered from are never empty.
+*   The last group's spare lanes make walks that are thrown away.  Returns n, or 0 if no
+*   sentence of that length can be made.
+*/
+int walk_sentences_avx2(Model* model, int length, uint64_t reachable[], int n, char* sentences[], const uint64_t* seed, uint64_t first_index) {
+    GenerationView* view = local_view ? local_view : get_generation_view(model);
+    size_t row_size = ((size_t)model->n_w + 63) / 64;
+    int n_starts;
+    int* starts = feasible_entries(view->starts, view->n_starts, reachable + (size_t)(length - 1) * row_size, &n_starts);
+    if (!n_starts) {
+        free(starts);
+        return 0;
+    }
+    VectorGroup groups[VECTOR_GROUPS];
+    int* paths = malloc(VECTOR_GROUPS * VECTOR_LANES * length * sizeof(int));
+    for (int g = 0; g < VECTOR_GROUPS; g++) {
+        groups[g].first = -1;
+        groups[g].path = paths + g * VECTOR_LANES * length;
+    }
+    Word* sentence[length];
+    int n_started = 0, n_finished = 0;
+    while (n_finished < n) {
+        for (int g = 0; g < VECTOR_GROUPS; g++) {
+            VectorGroup* group = groups + g;
+            if (group->first < 0) {
+                if (n_started >= n) continue;
+                group->first = n_started;
+                n_started += VECTOR_LANES;
+                group->step = 0;
+                start_vector_streams(group, seed, first_index);
+                group->n_entries = _mm256_set1_epi32(n_starts);
+                group->lists_low = group->lists_high = _mm256_set1_epi64x((uintptr_t)starts);
+                draw_vector(group, true);
+                continue;
+            }
+            uint64_t* row = reachable + (size_t)(length - 1 - group->step) * row_size;
+            if (group->stage == WALK_LIST) {
+                int* chosen = group->path + (group->step - 1) * VECTOR_LANES;
+                for (int l = 0; l < VECTOR_LANES; l++) __builtin_prefetch(model->words[chosen[l]].string);
+                __m256i words = _mm256_loadu_si256((__m256i*)chosen);
+                group->n_entries = _mm256_i32gather_epi32(view->n_next, words, 4);
+                if (sizeof(int*) == 8) {
+                    group->lists_low = _mm256_i32gather_epi64((const void*)view->next, _mm256_castsi256_si128(words), 8);
+                    group->lists_high = _mm256_i32gather_epi64((const void*)view->next, _mm256_extracti128_si256(words, 1), 8);
+                } else {
+                    __m256i lists = _mm256_i32gather_epi32((const void*)view->next, words, 4);
+                    group->lists_low = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(lists));
+                    group->lists_high = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(lists, 1));
+                }
+                draw_vector(group, true);
+            } else if (group->stage == WALK_ENTRY) {
+                __m128i drawn_low = _mm256_i64gather_epi32(NULL, group->addresses_low, 1);
+                __m128i drawn_high = _mm256_i64gather_epi32(NULL, group->addresses_high, 1);
+                group->drawn = _mm256_inserti128_si256(_mm256_castsi128_si256(drawn_low), drawn_high, 1);
+                int indices[VECTOR_LANES];
+                _mm256_storeu_si256((__m256i*)indices, _mm256_srli_epi32(group->drawn, 6));
+                for (int l = 0; l < VECTOR_LANES; l++) __builtin_prefetch(row + indices[l]);
+                group->stage = WALK_TEST;
+            } else {
+                __m256i taken = _mm256_and_si256(group->pending, test_bits_avx2(row, group->drawn));
+                group->chosen = _mm256_blendv_epi8(group->chosen, group->drawn, taken);
+                group->pending = _mm256_andnot_si256(taken, group->pending);
+                bool settled = _mm256_testz_si256(group->pending, group->pending);
+                if (!settled && group->draws < WALK_DRAWS) {
+                    draw_vector(group, false);
+                    continue;
+                }
+                int* chosen = group->path + group->step * VECTOR_LANES;
+                _mm256_storeu_si256((__m256i*)chosen, group->chosen);
+                if (!settled) settle_lanes(group, chosen, row);
+                if (++group->step < length) {
+                    for (int l = 0; l < VECTOR_LANES; l++) {
+                        __builtin_prefetch(view->next + chosen[l]);
+                        __builtin_prefetch(view->n_next + chosen[l]);
+                        __builtin_prefetch(model->words + chosen[l]);
+                    }
+                    group->stage = WALK_LIST;
+                    continue;
+                }
+                for (int l = 0; l < VECTOR_LANES && group->first + l < n; l++) {
+                    for (int i = 0; i < length; i++) sentence[i] = model->words + group->path[i * VECTOR_LANES + l];
+                    sentences[group->first + l] = combine_words(sentence, length);
+                    n_finished++;
+                }
+                group->first = -1;
+            }
+        }
+    }
+    free(paths);
+    free(starts);
+    return n;
+}
+
+/*  Function: start_vector_streams
+*   -------------------------------
+*   Gives each lane of a group starting new sentences the RandomStream for its sentence's
+*   index in the seeded sequence, or a stream with a key drawn from random_int if there is
+*   no seed.
+*/
+void start_vector_streams(VectorGroup* group, const uint64_t* seed, uint64_t first_index) {
+    uint32_t keys[2][VECTOR_LANES];
+    for (int l = 0; l < VECTOR_LANES; l++) {
+        RandomStream stream;
+        if (seed) start_random_stream(&stream, *seed, first_index + group->first + l);
+        else {
+            stream.key[0] = (uint32_t)random_int(0, (1 << 16) - 1) << 16 | random_int(0, (1 << 16) - 1);
+            stream.key[1] = (uint32_t)random_int(0, (1 << 16) - 1) << 16 | random_int(0, (1 << 16) - 1);
+        }
+        keys[0][l] = stream.key[0];
+        keys[1][l] = stream.key[1];
+    }
+    group->keys[0] = _mm256_loadu_si256((__m256i*)keys[0]);
+    group->keys[1] = _mm256_loadu_si256((__m256i*)keys[1]);
+    group->counters = _mm256_setzero_si256();
+}
+
+/*  Function: draw_vector
+*   ---------------------
+*   Draws an entry for every lane of the group, as walk_sentences_avx2 describes, prefetches
+*   each and sets the group to gather them next.  A group starting a new word first marks
+*   every lane as pending.  Only the pending lanes' counters move on.
+*/
+void draw_vector(VectorGroup* group, bool new_word) {
+    if (new_word) {
+        group->chosen = _mm256_setzero_si256();
+        group->pending = _mm256_set1_epi32(-1);
+        group->draws = 0;
+    }
+    __m256i random = hash_draws(group->keys, group->counters);
+    group->counters = _mm256_sub_epi32(group->counters, group->pending);
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(random, group->n_entries), 32);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(random, 32), _mm256_srli_epi64(group->n_entries, 32));
+    __m256i offsets = _mm256_slli_epi32(_mm256_blend_epi32(even, odd, 0xaa), 2);
+    group->addresses_low = _mm256_add_epi64(group->lists_low, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(offsets)));
+    group->addresses_high = _mm256_add_epi64(group->lists_high, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(offsets, 1)));
+    uint64_t addresses[VECTOR_LANES];
+    _mm256_storeu_si256((__m256i*)addresses, group->addresses_low);
+    _mm256_storeu_si256((__m256i*)(addresses + 4), group->addresses_high);
+    for (int l = 0; l < VECTOR_LANES; l++) __builtin_prefetch((void*)(uintptr_t)addresses[l]);
+    group->draws++;
+    group->stage = WALK_ENTRY;
+}
+
+/*  Function: settle_lanes
+*   ----------------------
+*   Picks a word with pick_feasible_avx2 for each lane of the group that is still pending
+*   after WALK_DRAWS draws, writing it over that lane's place in chosen.  The pick draws
+*   from the lane's stream, made current for the purpose.
+*/
+void settle_lanes(VectorGroup* group, int chosen[], uint64_t row[]) {
+    int pending[VECTOR_LANES], sizes[VECTOR_LANES];
+    uint32_t keys[2][VECTOR_LANES], counters[VECTOR_LANES];
+    uint64_t lists[VECTOR_LANES];
+    _mm256_storeu_si256((__m256i*)pending, group->pending);
+    _mm256_storeu_si256((__m256i*)sizes, group->n_entries);
+    _mm256_storeu_si256((__m256i*)lists, group->lists_low);
+    _mm256_storeu_si256((__m256i*)(lists + 4), group->lists_high);
+    _mm256_storeu_si256((__m256i*)keys[0], group->keys[0]);
+    _mm256_storeu_si256((__m256i*)keys[1], group->keys[1]);
+    _mm256_storeu_si256((__m256i*)counters, group->counters);
+    RandomStream* previous = current_stream;
+    for (int l = 0; l < VECTOR_LANES; l++) {
+        if (!pending[l]) continue;
+        RandomStream stream = {{keys[0][l], keys[1][l]}, counters[l]};
+        current_stream = &stream;
+        chosen[l] = pick_feasible_avx2((int*)(uintptr_t)lists[l], sizes[l], row);
+        counters[l] = stream.counter;
+    }
+    current_stream = previous;
+    group->counters = _mm256_loadu_si256((__m256i*)counters);
+}
+
+/*  Function: pick_feasible_avx2
+*   ----------------------------
+*   Does pick_feasible's work VECTOR_LANES entries at a time with test_bits_avx2, both when
+*   counting the feasible entries and when finding the block that holds the one picked.
+*/
+int pick_feasible_avx2(int entries[], int n_entries, uint64_t row[]) {
+    int n_blocks = n_entries / VECTOR_LANES;
+    int n_feasible = 0;
+    for (int b = 0; b < n_blocks; b++) {
+        __m256i block = _mm256_loadu_si256((__m256i*)(entries + b * VECTOR_LANES));
+        n_feasible += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(test_bits_avx2(row, block))));
+    }
+    for (int j = n_blocks * VECTOR_LANES; j < n_entries; j++) n_feasible += test_bit(row, entries[j]);
+    if (!n_feasible) return -1;
+    int pick = random_int(0, n_feasible - 1);
+    int j = 0;
+    for (int b = 0; b < n_blocks; b++, j += VECTOR_LANES) {
+        __m256i block = _mm256_loadu_si256((__m256i*)(entries + j));
+        int count = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(test_bits_avx2(row, block))));
+        if (pick < count) break;
+        pick -= count;
+    }
+    for (; ; j++) {
+        if (test_bit(row, entries[j]) && !pick--) return entries[j];
+    }
+}
+
+/*  Function: hash_draws
+*   --------------------
+*   Returns hash_draw of each lane's key and counter, computed for all the lanes at once.
+*/
+__m256i hash_draws(__m256i keys[], __m256i counters) {
+    __m256i x = mix_draws(_mm256_xor_si256(counters, keys[0]));
+    return mix_draws(_mm256_xor_si256(x, keys[1]));
+}
+
+/*  Function: mix_draws
+*   -------------------
+*   Returns mix_draw of each lane.
+*/
+__m256i mix_draws(__m256i x) {
+    x = _mm256_mullo_epi32(_mm256_xor_si256(x, _mm256_srli_epi32(x, 16)), _mm256_set1_epi32(0x7feb352d));
+    x = _mm256_mullo_epi32(_mm256_xor_si256(x, _mm256_srli_epi32(x, 15)), _mm256_set1_epi32(0x846ca68b));
+    return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+/*  Function: test_bits_avx2
+*   ------------------------
+*   Returns a vector with every bit of a lane set if that lane's entry is set in the row,
+*   and clear if not.  The row words are gathered four lanes at a time, as 64-bit values.
+*/
+__m256i test_bits_avx2(uint64_t row[], __m256i entries) {
+    __m256i indices = _mm256_srli_epi32(entries, 6);
+    __m256i shifts = _mm256_and_si256(entries, _mm256_set1_epi32(63));
+    __m256i low = _mm256_i32gather_epi64((const void*)row, _mm256_castsi256_si128(indices), 8);
+    __m256i high = _mm256_i32gather_epi64((const void*)row, _mm256_extracti128_si256(indices, 1), 8);
+    low = _mm256_srlv_epi64(low, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(shifts)));
+    high = _mm256_srlv_epi64(high, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(shifts, 1)));
+    __m256i halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);  // the low 32 bits of each 64
+    low = _mm256_permutevar8x32_epi32(low, halves);
+    high = _mm256_permutevar8x32_epi32(high, halves);
+    __m256i bits = _mm256_and_si256(_mm256_permute2x128_si256(low, high, 0x20), _mm256_set1_epi32(1));
+    return _mm256_cmpeq_epi32(bits, _mm256_set1_epi32(1));
+}
+
+/*  Function: fill_row_word_avx2
+*   ----------------------------
+*   Does fill_row_word's work for VECTOR_LANES model words at once, one per 32-bit lane.
+*   Step j gathers the jth successor of every lane still without a set one, and tests their
+*   bits in the row before with test_bits_avx2, so a row word takes as many steps per group
+*   of lanes as its slowest lane needs rather than the sum of them all.  Lanes past n_bits,
+*   and lanes whose lists are used up, are masked out of the gathers.
+*/
+uint64_t fill_row_word_avx2(GenerationView* view, uint64_t previous[], int first_word, int n_bits) {
+    uint64_t bits = 0;
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i zero = _mm256_setzero_si256();
+    for (int b = 0; b < n_bits; b += VECTOR_LANES) {
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(n_bits - b), lanes);
+        __m256i words = _mm256_add_epi32(_mm256_set1_epi32(first_word + b), lanes);
+        __m256i n_next = _mm256_mask_i32gather_epi32(zero, view->n_next, words, valid, 4);
+        __m256i lists_low, lists_high;
+        if (sizeof(int*) == 8) {
+            __m256i valid_low = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(valid));
+            __m256i valid_high = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(valid, 1));
+            lists_low = _mm256_mask_i32gather_epi64(zero, (const void*)view->next, _mm256_castsi256_si128(words), valid_low, 8);
+            lists_high = _mm256_mask_i32gather_epi64(zero, (const void*)view->next, _mm256_extracti128_si256(words, 1), valid_high, 8);
+        } else {
+            __m256i lists = _mm256_mask_i32gather_epi32(zero, (const void*)view->next, words, valid, 4);
+            lists_low = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(lists));
+            lists_high = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(lists, 1));
+        }
+        __m256i found = zero;
+        __m256i pending = _mm256_cmpgt_epi32(n_next, zero);
+        for (int j = 0; !_mm256_testz_si256(pending, pending); j++) {
+            __m256i offset = _mm256_set1_epi64x((int64_t)j * sizeof(int));
+            __m128i entries_low = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), NULL, _mm256_add_epi64(lists_low, offset),
+                                                              _mm256_castsi256_si128(pending), 1);
+            __m128i entries_high = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), NULL, _mm256_add_epi64(lists_high, offset),
+                                                               _mm256_extracti128_si256(pending, 1), 1);
+            __m256i entries = _mm256_inserti128_si256(_mm256_castsi128_si256(entries_low), entries_high, 1);
+            __m256i set = _mm256_and_si256(pending, test_bits_avx2(previous, entries));
+            found = _mm256_or_si256(found, set);
+            pending = _mm256_andnot_si256(set, _mm256_and_si256(pending, _mm256_cmpgt_epi32(n_next, _mm256_set1_epi32(j + 1))));
+        }
+        bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(found)) << b;
+    }
+    return bits;
+}
+#endif
+
+/*  Function: generate_sentences_exact
+*   ----------------------------------
+*   Weighs every word's paths to a sentence ender once, then makes each sentence with a
+*   single forward walk that draws from those weights.  Returns n, or 0 if no sentence of
+*   that length can be made.
+*/
+int generate_sentences_exact(Model* model, int length, int n, char* sentences[]) {
+    if (length < 1 || n < 1) return 0;
+    PathWeights* weights = weigh_paths(model, length);
+    if (weights->start <= 0) {
+        free_path_weights(weights);
+        return 0;
+    }
+    Word* sentence[length];
+    for (int i = 0; i < n; i++) {
+        walk_weighted(model, weights, sentence);
+        sentences[i] = combine_words(sentence, length);
+    }
+    free_path_weights(weights);
+    return n;
+}
+
+/*  Function: weigh_paths
+*   ---------------------
+*   Fills in the table of a PathWeights a row at a time.  Row 0 is 1 for the sentence enders
+*   and 0 for the rest.  In each later row, a word's weight is the mean weight in the row
+*   before of its next_words entries, since every entry is equally likely to be picked, and
+*   the row is then divided by its largest weight.  Works in time proportional to length
+*   times the number of entries.
+*/
+PathWeights* weigh_paths(Model* model, int length) {
+    int n_w = model->n_w;
+    PathWeights* weights = malloc(sizeof(PathWeights));
+    weights->length = length;
+    weights->n_w = n_w;
+    weights->rows = malloc(((size_t)length * n_w + 1) * sizeof(double));
+    if (model->huge_pages) advise_huge_pages(weights->rows, ((size_t)length * n_w + 1) * sizeof(double));
+    weights->scales = malloc(length * sizeof(double));
+    for (int w = 0; w < n_w; w++) weights->rows[w] = model->words[w].is_sentence_ender;
+    for (int k = 1; k < length; k++) {
+        double* row = weights->rows + (size_t)k * n_w;
+        double* previous = row - n_w;
+        double largest = 0;
+        for (int w = 0; w < n_w; w++) {
+            Word* word = model->words + w;
+            row[w] = word->n_nw ? sum_weights(word->next_words, word->n_nw, previous) / word->n_nw : 0;
+            if (row[w] > largest) largest = row[w];
+        }
+        weights->scales[k] = largest > 0 ? 1 / largest : 1;
+        for (int w = 0; w < n_w; w++) row[w] *= weights->scales[k];
+    }
+    double* last_row = weights->rows + (size_t)(length - 1) * n_w;
+    weights->start = sum_weights(model->sentence_starting_words, model->n_ssw, last_row);
+    return weights;
+}
+
+/*  Function: sum_weights
+*   ---------------------
+*   Returns the summed weights in row of the entries.
+*/
+double sum_weights(int entries[], int n_entries, double row[]) {
+    double sum = 0;
+    for (int i = 0; i < n_entries; i++) sum += row[entries[i]];
+    return sum;
+}
+
+/*  Function: walk_weighted
+*   -----------------------
+*   Fills sentence with a walk that draws each word with probability proportional to its
+*   entries' path weights for the words still to come.  Since the weights of a word's entries
+*   sum to its own weight in the row above, times its number of entries and the scale between
+*   the rows, each step needs no pass of its own to total them, and a sentence is drawn with
+*   exactly the probability that the model makes it, given its length.  The table must show
+*   that some sentence exists.
+*/
+void walk_weighted(Model* model, PathWeights* weights, Word* sentence[]) {
+    int length = weights->length;
+    int n_w = weights->n_w;
+    double* row = weights->rows + (size_t)(length - 1) * n_w;
+    int w = draw_weighted(model->sentence_starting_words, model->n_ssw, row, weights->start);
+    sentence[0] = model->words + w;
+    for (int i = 1; i < length; i++) {
+        Word* word = sentence[i - 1];
+        double total = row[w] * word->n_nw / weights->scales[length - i];
+        row -= n_w;
+        w = draw_weighted(word->next_words, word->n_nw, row, total);
+        sentence[i] = model->words + w;
+    }
+}
+
+/*  Function: draw_weighted
+*   -----------------------
+*   Draws one of the entries with probability proportional to its weight in row, given their
+*   summed weights, in one pass that stops at the entry drawn.  Should rounding leave the
+*   running sum short of the draw, the last entry with any weight is taken.
+*/
+int draw_weighted(int entries[], int n_entries, double row[], double total) {
+    double target = random_fraction() * total;
+    double sum = 0;
+    int last = -1;
+    for (int i = 0; i < n_entries; i++) {
+        if (row[entries[i]] <= 0) continue;
+        last = entries[i];
+        sum += row[last];
+        if (sum > target) return last;
+    }
+    assert(last >= 0);
+    return last;
+}
+
+/*  Function: free_path_weights
+*   ---------------------------
+*   Frees the table and the struct.
+*/
+void free_path_weights(PathWeights* weights) {
+    free(weights->rows);
+    free(weights->scales);
+    free(weights);
+}
+
+/*  Function: get_generation_view
+*   -----------------------------
+*   Returns the model's generation view, first building it if there is none, as after an
+*   ingest.  Searches may call this from several threads at once; the first to find the view
+*   missing builds it under the model's lock, and the view is published with a release store
+*   so that the others see it whole.  The view is only freed by ingest_text, during which no
+*   search may run.
+*/
+GenerationView* get_generation_view(Model* model) {
+    GenerationView* view = __atomic_load_n(&model->view, __ATOMIC_ACQUIRE);
+    if (view) return view;
+    pthread_mutex_lock(&model->view_lock);
+    view = model->view;
+    if (!view) {
+        view = build_generation_view(model);
+        __atomic_store_n(&model->view, view, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&model->view_lock);
+    return view;
+}
+
+/*  Function: build_generation_view
+*   -------------------------------
+*   Builds the view from scratch.  The predecessor lists are gathered by counting sort, then
+*   a breadth-first search from every sentence ender along them marks the viable words, and
+*   each viable word's list keeps the entries that name viable words.
+*/
+GenerationView* build_generation_view(Model* model) {
+    int n_w = model->n_w;
+    GenerationView* view = calloc(1, sizeof(GenerationView));
+    view->n_w = view->words_cap = n_w;
+    view->n_prev = calloc(n_w + 1, sizeof(int));
+    long n_entries = 0;
+    for (int w = 0; w < n_w; w++) {
+        Word* word = model->words + w;
+        for (int i = 0; i < word->n_nw; i++) view->n_prev[word->next_words[i]]++;
+        n_entries += word->n_nw;
+    }
+    view->prev = malloc((n_w + 1) * sizeof(int*));
+    view->prev_cap = calloc(n_w + 1, sizeof(int));
+    view->prev_links = malloc((n_entries + 1) * sizeof(int));
+    int* link = view->prev_links;
+    for (int w = 0; w < n_w; w++) {
+        view->prev[w] = link;
+        link += view->n_prev[w];
+        view->n_prev[w] = 0;
+    }
+    for (int w = 0; w < n_w; w++) {
+        Word* word = model->words + w;
+        for (int i = 0; i < word->n_nw; i++) {
+            int next_word = word->next_words[i];
+            view->prev[next_word][view->n_prev[next_word]++] = w;
+        }
+    }
+    bool* viable = view->viable = calloc(n_w + 1, sizeof(bool));
+    int* queue = malloc((n_w + 1) * sizeof(int));
+    int n_queued = 0;
+    for (int w = 0; w < n_w; w++) {
+        if (model->words[w].string && model->words[w].is_sentence_ender) {
+            viable[w] = true;
+            queue[n_queued++] = w;
+        }
+    }
+    for (int head = 0; head < n_queued; head++) {
+        int w = queue[head];
+        for (int i = 0; i < view->n_prev[w]; i++) {
+            if (!viable[view->prev[w][i]]) {
+                viable[view->prev[w][i]] = true;
+                queue[n_queued++] = view->prev[w][i];
+            }
+        }
+    }
+    free(queue);
+    long n_links = 0;
+    for (int w = 0; w < n_w; w++) {
+        Word* word = model->words + w;
+        if (!word->string) continue;  // removed from a live model
+        if (!viable[w]) view->n_pruned++;
+        else for (int i = 0; i < word->n_nw; i++) n_links += viable[word->next_words[i]];
+    }
+    view->n_next = calloc(n_w + 1, sizeof(int));
+    view->next = malloc((n_w + 1) * sizeof(int*));
+    view->next_cap = calloc(n_w + 1, sizeof(int));
+    view->links = malloc((n_links + 1) * sizeof(int));
+    if (model->huge_pages) {  // the arrays every walk step reads
+        advise_huge_pages(view->n_next, (n_w + 1) * sizeof(int));
+        advise_huge_pages(view->next, (n_w + 1) * sizeof(int*));
+        advise_huge_pages(view->links, (n_links + 1) * sizeof(int));
+    }
+    link = view->links;
+    for (int w = 0; w < n_w; w++) {
+        Word* word = model->words + w;
+        view->next[w] = link;
+        if (!viable[w]) continue;
+        for (int i = 0; i < word->n_nw; i++) {
+            if (viable[word->next_words[i]]) link[view->n_next[w]++] = word->next_words[i];
+        }
+        link += view->n_next[w];
+    }
+    fill_view_starts(model, view);
+    view->memory = sizeof(GenerationView) + (n_w + 1) * (5 * sizeof(int) + 2 * sizeof(int*) + sizeof(bool));
+    view->memory += (n_links + 1 + n_entries + 1) * sizeof(int);
+    return view;
+}
+
+/*  Function: fill_view_starts
+*   --------------------------
+*   Fills the view's starting words afresh from sentence_starting_words.
+*/
+void fill_view_starts(Model* model, GenerationView* view) {
+    free(view->starts);
+    view->starts = malloc((model->n_ssw + 1) * sizeof(int));
+    view->n_starts = 0;
+    for (int i = 0; i < model->n_ssw; i++) {
+        int start = model->sentence_starting_words[i];
+        if (view->viable[start]) view->starts[view->n_starts++] = start;
+    }
+    view->starts_stale = false;
+}
+
+/*  Function: add_view_word
+*   -----------------------
+*   Brings a word just created in an exact model into the view, pruned and with empty lists,
+*   growing the per-word arrays if needed.
+*/
+void add_view_word(GenerationView* view, int word) {
+    if (word == view->words_cap) {
+        int cap = 2 * view->words_cap + 64;
+        view->n_next = realloc(view->n_next, (cap + 1) * sizeof(int));
+        view->next = realloc(view->next, (cap + 1) * sizeof(int*));
+        view->next_cap = realloc(view->next_cap, (cap + 1) * sizeof(int));
+        view->n_prev = realloc(view->n_prev, (cap + 1) * sizeof(int));
+        view->prev = realloc(view->prev, (cap + 1) * sizeof(int*));
+        view->prev_cap = realloc(view->prev_cap, (cap + 1) * sizeof(int));
+        view->viable = realloc(view->viable, (cap + 1) * sizeof(bool));
+        view->memory += (cap - view->words_cap) * (5 * sizeof(int) + 2 * sizeof(int*) + sizeof(bool));
+        view->words_cap = cap;
+    }
+    view->n_next[word] = view->next_cap[word] = 0;
+    view->n_prev[word] = view->prev_cap[word] = 0;
+    view->next[word] = view->prev[word] = NULL;
+    view->viable[word] = false;
+    view->n_w = word + 1;
+    view->n_pruned++;
+}
+
+/*  Function: add_view_link
+*   -----------------------
+*   Brings an entry just appended to word's next_words into the view.  The entry always
+*   joins next_word's predecessors.  If next_word is viable, the entry joins word's list
+*   when word is viable too, and otherwise word becomes viable, which adds the entry along
+*   with the rest of its list.
+*/
+void add_view_link(Model* model, GenerationView* view, int word, int next_word) {
+    append_to_list(view, view->prev, view->n_prev, view->prev_cap, next_word, word);
+    if (!view->viable[next_word]) return;
+    if (view->viable[word]) append_to_list(view, view->next, view->n_next, view->next_cap, word, next_word);
+    else make_viable(model, view, word);
+}
+
+/*  Function: make_viable
+*   ---------------------
+*   Marks word viable and spreads the change backward through predecessor lists, stopping at
+*   words that were viable already, so only the words whose state changes are visited.  A
+*   word is only marked when it is taken from the queue, and then fills its own list from
+*   the viable words it leads to and joins the lists of its viable predecessors, so every
+*   entry between two viable words is added exactly once.  The starting words are refilled
+*   before the next search.
+*/
+void make_viable(Model* model, GenerationView* view, int word) {
+    int n_queued = 0;
+    view->queue_cap = view->queue_cap ? view->queue_cap : 64;
+    view->queue = view->queue ? view->queue : malloc(view->queue_cap * sizeof(int));
+    view->queue[n_queued++] = word;
+    while (n_queued) {
+        int w = view->queue[--n_queued];
+        if (view->viable[w]) continue;
+        view->viable[w] = true;
+        view->n_pruned--;
+        view->starts_stale = true;
+        Word* this_word = model->words + w;
+        for (int i = 0; i < this_word->n_nw; i++) {
+            int next_word = this_word->next_words[i];
+            if (view->viable[next_word]) append_to_list(view, view->next, view->n_next, view->next_cap, w, next_word);
+        }
+        for (int i = 0; i < view->n_prev[w]; i++) {
+            int previous = view->prev[w][i];
+            if (previous == w) continue;  // a self-link was added with the word's own list
+            if (view->viable[previous]) append_to_list(view, view->next, view->n_next, view->next_cap, previous, w);
+            else {
+                if (n_queued == view->queue_cap) {
+                    view->queue_cap *= 2;
+                    view->queue = realloc(view->queue, view->queue_cap * sizeof(int));
+                }
+                view->queue[n_queued++] = previous;
+            }
+        }
+    }
+}
+
+/*  Function: append_to_list
+*   ------------------------
+*   Appends entry to word's list among lists, moving the list out of its shared block, or
+*   to a larger array of its own, when it has no room left.
+*/
+void append_to_list(GenerationView* view, int** lists, int* sizes, int* caps, int word, int entry) {
+    if (sizes[word] == caps[word] || !caps[word]) {
+        int cap = 2 * sizes[word] + 4;
+        int* list = malloc(cap * sizeof(int));
+        if (sizes[word]) memcpy(list, lists[word], sizes[word] * sizeof(int));
+        if (caps[word]) free(lists[word]);
+        view->memory += (cap - caps[word]) * sizeof(int);
+        lists[word] = list;
+        caps[word] = cap;
+    }
+    lists[word][sizes[word]++] = entry;
+}
+
+/*  Function: free_generation_view
+*   ------------------------------
+*   Frees the view, including every list that moved out of its shared block, and its
+*   replicas.
+*/
+void free_generation_view(GenerationView* view) {
+    free_view_replicas(view);
+    for (int w = 0; w < view->n_w; w++) {
+        if (view->next_cap[w]) free(view->next[w]);
+        if (view->prev_cap[w]) free(view->prev[w]);
+    }
+    free(view->starts);
+    free(view->links);
+    free(view->next);
+    free(view->n_next);
+    free(view->next_cap);
+    free(view->prev_links);
+    free(view->prev);
+    free(view->n_prev);
+    free(view->prev_cap);
+    free(view->viable);
+    free(view->queue);
+    free(view);
+}
+
+/*  Function: find_words
+*   --------------------
+*   For each viable starting word, in random order, the function calls find_words_recursive
+*   to attempt to create a sentence from that initial word.  If an attempt succeeds, the
+*   function returns 'true' with a populated sentence array; if none succeed the function
+*   returns false.  The random order is kept in the search context rather than in the
+*   model, so several threads may search the same model at once.  Also returns false as soon
+*   as the search context gives up.
+*/
+bool find_words(Model* model, int length, Word* sentence[], SearchContext* context) {
+    GenerationView* view = context->view;
+    RandomOrder order;
+    start_random_order(context, &order, view->n_starts);
+    bool found = false;
+    int ssw_index;
+    while (!found && !context->given_up && (ssw_index = next_in_random_order(&order)) >= 0) {
+        if (known_failure(context, view->starts[ssw_index], length - 1)) continue;
+        sentence[0] = model->words + view->starts[ssw_index];
+        found = find_words_recursive(model, length, sentence, 0, context);
+    }
+    end_random_order(&order);
+    return found;
+}
+
+/*  Function: find_words_recursive
+*   ------------------------------
+*   First checks the base case where the recursion has found enough words to create a sentence;
+*   the function returns true all the way down the stack if the final word is a sentence ender
+*   and returns false to the previous stack frame if not.  For non-base-cases, the function
+*   tries the word's viable next words in a random order, appending each to the sentence and
+*   recursing, until one works or all have been tried.  A success at sentence end propagates
+*   a 'true' value back to the calling function; 'false' is returned when none work.  Every
+*   frame first checks whether the search has been cancelled, and a search that gives up
+*   unwinds without trying further entries.  A frame that fails records its word and
+*   remaining length in the context, and next words already recorded with the length that
+*   would remain after them are skipped, so each state is explored at most once per search
+*   and duplicate entries of a failed next_word cost only a lookup.
+*/
+bool find_words_recursive(Model* model, int length, Word* sentence[], int cur_index, SearchContext* context) {
+    if (search_stopped(context)) return false;
+    if (length == cur_index + 1) {
+        if (sentence[length - 1]->is_sentence_ender) return true;
+        else return false;
+    }
+    int this_word = sentence[cur_index] - model->words;
+    int* next = context->view->next[this_word];
+    RandomOrder order;
+    start_random_order(context, &order, context->view->n_next[this_word]);
+    bool found = false;
+    int nw_index;
+    while (!found && !context->given_up && (nw_index = next_in_random_order(&order)) >= 0) {
+        if (known_failure(context, next[nw_index], length - cur_index - 2)) continue;
+        sentence[cur_index + 1] = model->words + next[nw_index];
+        found = find_words_recursive(model, length, sentence, cur_index + 1, context);
+    }
+    end_random_order(&order);
+    if (!found && !context->given_up) record_failure(context, this_word, length - cur_index - 1);
+    return found;
+}
+
+/*  Function: search_with_restarts
+*   ------------------------------
+*   Runs find_words in attempts whose frame limits follow the Luby sequence (1, 1, 2, 1, 1,
+*   2, 4, ...) in units of RESTART_UNIT frames per word, each from a fresh random order of
+*   starting words, so that one unlucky early choice cannot keep the search in a large
+*   failing subtree.  The failures an attempt proves stay recorded in the context and are
+*   skipped by later attempts, while an attempt cut short records nothing for the frames it
+*   left unfinished.  Once RESTART_BUDGET units are spent, a last attempt runs without a
+*   limit, so a sentence is found whenever one exists.  Cutting an attempt short makes the
+*   sentences behind costly branches less likely than an uncut search would make them, so
+*   the unit is kept large enough that a search only restarts when it is truly stuck, and
+*   the sentences keep the distribution of an uncut search as closely as samples of a few
+*   hundred thousand can tell.  Returns false at once if the search is cancelled or an
+*   attempt exhausts every option.
+*/
+bool search_with_restarts(Model* model, int length, Word* sentence[], SearchContext* context) {
+    long unit = (long)RESTART_UNIT * length;
+    long units_spent = 0;
+    for (int attempt = 1; true; attempt++) {
+        long units = luby(attempt);
+        bool last = units_spent + units > RESTART_BUDGET;
+        context->frame_limit = last ? 0 : units * unit;
+        context->n_frames = 0;
+        context->given_up = false;
+        if (find_words(model, length, sentence, context)) return true;
+        if (!context->given_up || last) return false;
+        if (context->cancelled && __atomic_load_n(context->cancelled, __ATOMIC_RELAXED)) return false;
+        units_spent += units;
+    }
+}
+
+/*  Function: luby
+*   --------------
+*   Returns the ith term, counting from 1, of the Luby sequence: 2^(k-1) if i is 2^k - 1,
+*   and otherwise the same term as at i less the length of the previous complete block.
+*/
+long luby(int i) {
+    while (true) {
+        long block = 1;  // 2^k - 1 for the smallest such value at least i
+        while (block < i) block = 2 * block + 1;
+        if (block == i) return (block + 1) / 2;
+        i -= block / 2;
+    }
+}
+
+/*  Function: search_stopped
+*   ------------------------
+*   Counts a frame and returns true, marking the search as given up, if its cancellation
+*   flag has been set or the attempt has used up its frame limit.
+*/
+bool search_stopped(SearchContext* context) {
+    if (context->cancelled && __atomic_load_n(context->cancelled, __ATOMIC_RELAXED)) context->given_up = true;
+    if (context->frame_limit && ++context->n_frames > context->frame_limit) context->given_up = true;
+    return context->given_up;
+}
+
+/*  Function: failure_key
+*   ---------------------
+*   Packs a search state into a non-zero key for the failure set.
+*/
+uint64_t failure_key(int word, int remaining) {
+    return ((uint64_t)word << 32 | (uint32_t)remaining) + 1;
+}
+
+/*  Function: failure_slot
+*   ----------------------
+*   Returns the slot of the failure set at which probing for key starts, taking the high
+*   bits of a multiplicative hash.
+*/
+uint32_t failure_slot(uint64_t key, uint32_t mask) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+/*  Function: known_failure
+*   -----------------------
+*   Returns true if the search has already found that no sentence can be finished from word
+*   with remaining more words to come.  The set is only kept for remaining lengths above
+*   zero, since a last word is checked at once.
+*/
+bool known_failure(SearchContext* context, int word, int remaining) {
+    if (!context->failures || remaining < 1) return false;
+    uint64_t key = failure_key(word, remaining);
+    uint32_t mask = context->failures_mask;
+    for (uint32_t slot = failure_slot(key, mask); context->failures[slot]; slot = (slot + 1) & mask) {
+        if (context->failures[slot] == key) return true;
+    }
+    return false;
+}
+
+/*  Function: record_failure
+*   ------------------------
+*   Adds a failed state to the set, allocating the set at the first failure and doubling it
+*   whenever it becomes half full.
+*/
+void record_failure(SearchContext* context, int word, int remaining) {
+    if (remaining < 1) return;
+    if (2 * (context->n_failures + 1) > context->failures_mask + 1 || !context->failures) {
+        uint64_t* old_failures = context->failures;
+        uint32_t old_size = old_failures ? context->failures_mask + 1 : 0;
+        uint32_t size = old_failures ? 2 * old_size : MIN_FAILURE_SET_SIZE;
+        context->failures = calloc(size, sizeof(uint64_t));
+        context->failures_mask = size - 1;
+        for (uint32_t i = 0; i < old_size; i++) {
+            uint64_t key = old_failures[i];
+            if (!key) continue;
+            uint32_t slot = failure_slot(key, context->failures_mask);
+            while (context->failures[slot]) slot = (slot + 1) & context->failures_mask;
+            context->failures[slot] = key;
+        }
+        free(old_failures);
+    }
+    uint64_t key = failure_key(word, remaining);
+    uint32_t slot = failure_slot(key, context->failures_mask);
+    while (context->failures[slot]) {
+        if (context->failures[slot] == key) return;
+        slot = (slot + 1) & context->failures_mask;
+    }
+    context->failures[slot] = key;
+    context->n_failures++;
+}
+
+/*  Function: start_random_order
+*   ----------------------------
+*   Starts a random order over n positions.  Nothing is allocated until the order is laid out.
+*/
+void start_random_order(SearchContext* context, RandomOrder* order, int n) {
+    order->context = context;
+    order->n = n;
+    order->n_drawn = 0;
+    order->offset = -1;
+    order->n_left = 0;
+}
+
+/*  Function: next_in_random_order
+*   ------------------------------
+*   Returns a position not yet returned, each equally likely, or -1 once all have been.
+*   While fewer than LAZY_DRAWS positions and under half of them have been drawn, draws
+*   until it finds a new one, which takes at most two tries on average.
+*/
+int next_in_random_order(RandomOrder* order) {
+    if (order->offset < 0) {
+        if (order->n_drawn < LAZY_DRAWS && 2 * order->n_drawn < order->n) {
+            while (true) {
+                int position = random_int(0, order->n - 1);
+                bool seen = false;
+                for (int i = 0; i < order->n_drawn && !seen; i++) seen = order->drawn[i] == position;
+                if (!seen) return order->drawn[order->n_drawn++] = position;
+            }
+        }
+        lay_out_random_order(order);
+    }
+    if (!order->n_left) return -1;
+    int* positions = order->context->scratch + order->offset;
+    int pick = random_int(0, order->n_left - 1);
+    int position = positions[pick];
+    positions[pick] = positions[--order->n_left];
+    return position;
+}
+
+/*  Function: lay_out_random_order
+*   ------------------------------
+*   Pushes a slice holding every position not yet drawn onto the search's scratch stack,
+*   growing the stack as needed.  The slice starts as all positions in order, and the drawn
+*   ones are swapped out from the largest down, so that each is still at its own index when
+*   its turn comes.  Called while the order's frame is the innermost one, so its slice sits
+*   above those of the frames around it.
+*/
+void lay_out_random_order(RandomOrder* order) {
+    SearchContext* context = order->context;
+    if (context->n_scratch + order->n > context->scratch_cap) {
+        int cap = 2 * context->scratch_cap;
+        if (cap < context->n_scratch + order->n) cap = context->n_scratch + order->n;
+        if (cap < MIN_SCRATCH_SIZE) cap = MIN_SCRATCH_SIZE;
+        context->scratch = realloc(context->scratch, cap * sizeof(int));
+        context->scratch_cap = cap;
+    }
+    order->offset = context->n_scratch;
+    int* positions = context->scratch + order->offset;
+    for (int position = 0; position < order->n; position++) positions[position] = position;
+    int* drawn = order->drawn;
+    for (int i = 1; i < order->n_drawn; i++) {  // insertion sort, largest first
+        int position = drawn[i], j = i;
+        for (; j > 0 && drawn[j - 1] < position; j--) drawn[j] = drawn[j - 1];
+        drawn[j] = position;
+    }
+    order->n_left = order->n;
+    for (int i = 0; i < order->n_drawn; i++) positions[drawn[i]] = positions[--order->n_left];
+    context->n_scratch += order->n_left;
+}
+
+/*  Function: end_random_order
+*   --------------------------
+*   Pops the order's slice, if it was laid out, off the scratch stack.  Orders must end in
+*   the reverse of the order they started.
+*/
+void end_random_order(RandomOrder* order) {
+    if (order->offset >= 0) order->context->n_scratch = order->offset;
+}
+
+/*  Function: combine_words
+*   -----------------------
 *   Transforms the array of Word structs into a string containing all the words,
 *   making sure to capitalize the initial word and add a period to the final
-*   word.  Records the location of the heap-allocated string in the model's
-*   sentences array and returns a pointer to the heap-allocated string.
+*   word.  Returns a pointer to the heap-allocated string, which belongs to the
+*   caller.
 */
 char* combine_words(Word* sentence[], int length) {
     char* sentence_string = calloc(1, 1);
@@ -357,13 +2792,298 @@ char* combine_words(Word* sentence[], int length) {
     return sentence_string;
 }
 
+/*  Function: score_sentence
+*   ------------------------
+*   Splits the sentence into words the same way the model's source text was split, then adds
+*   up the log-probabilities of the first word starting a sentence and of each following word
+*   coming after the one before it, counting repeated entries in sentence_starting_words and
+*   next_words.  Returns -INFINITY if any step never occurs in the model or the last word
+*   never ends a sentence.
+*/
+double score_sentence(Model* model, const char* sentence) {
+    FILE* text = fmemopen((void*)sentence, strlen(sentence), "r");
+    if (!text) return -INFINITY;
+    double score = 0;
+    Word* last_word = NULL;
+    bool ends_sentence = false;
+    while (true) {
+        char next_word_buf[MAX_WORD_LENGTH + 1];
+        if (scan_next_word(text, next_word_buf)) break;
+        if (ends_sentence) {  // the previous word ended the sentence early
+            score = -INFINITY;
+            break;
+        }
+        ends_sentence = check_if_ends_sentence(next_word_buf);
+        if (!last_word) *next_word_buf = tolower(*next_word_buf);
+        Word* word = search_words(model, next_word_buf);
+        int n_entries, n_matches;
+        if (!last_word) {
+            n_entries = model->n_ssw;
+            n_matches = word ? count_entries(model->sentence_starting_words, n_entries, word - model->words) : 0;
+        } else {
+            n_entries = last_word->n_nw;
+            n_matches = word ? count_entries(last_word->next_words, n_entries, word - model->words) : 0;
+        }
+        if (!n_matches) {
+            score = -INFINITY;
+            break;
+        }
+        score += log((double)n_matches / n_entries);
+        last_word = word;
+    }
+    fclose(text);
+    if (!last_word || !last_word->is_sentence_ender) return -INFINITY;
+    return score;
+}
+
+/*  Function: start_random_stream
+*   -----------------------------
+*   Sets the stream's key from the seed and index, each mixed in turn, and its counter to 0.
+*/
+void start_random_stream(RandomStream* stream, uint64_t seed, uint64_t index) {
+    uint64_t key = mix_seed(mix_seed(seed) ^ index);
+    stream->key[0] = (uint32_t)key;
+    stream->key[1] = (uint32_t)(key >> 32);
+    stream->counter = 0;
+}
+
+/*  Function: hash_draw
+*   -------------------
+*   Returns the draw a RandomStream with the key makes when its counter is counter: the
+*   counter mixed with each half of the key in turn.  For a given key, different counters
+*   give different draws.  Works in 32-bit lanes so that hash_draws can do the same.
+*/
+uint32_t hash_draw(const uint32_t key[], uint32_t counter) {
+    return mix_draw(mix_draw(counter ^ key[0]) ^ key[1]);
+}
+
+/*  Function: mix_draw
+*   ------------------
+*   Returns x with its bits mixed by an invertible hash (two multiply-xorshift rounds).
+*/
+uint32_t mix_draw(uint32_t x) {
+    x = (x ^ x >> 16) * 0x7feb352du;
+    x = (x ^ x >> 15) * 0x846ca68bu;
+    return x ^ x >> 16;
+}
+
+/*  Function: mix_seed
+*   ------------------
+*   Returns x with its bits mixed by splitmix64's finalizer.
+*/
+uint64_t mix_seed(uint64_t x) {
+    x = (x ^ x >> 30) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ x >> 27) * 0x94d049bb133111ebULL;
+    return x ^ x >> 31;
+}
+
+/*  Function: count_entries
+*   -----------------------
+*   Returns the number of times the word index appears in the array.
+*/
+int count_entries(int array[], int n_elems, int word) {
+    int count = 0;
+    for (int i = 0; i < n_elems; i++) {
+        if (array[i] == word) count++;
+    }
+    return count;
+}
+
+/*  Function: save_model
+*   --------------------
+*   Writes the model to file in the format described at ModelFileHeader.  Words removed from
+*   a live model are skipped and the rest renumbered so the file's words are contiguous.
+*   Returns 0 on success, -1 if a write failed.
+*/
+int save_model(Model* model, FILE* file) {
+    ModelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_FILE_VERSION;
+    header.n_ssw = model->n_ssw;
+    int* renumbered = malloc((model->n_w + 1) * sizeof(int));
+    for (int i = 0; i < model->n_w; i++) {
+        Word* word = model->words + i;
+        renumbered[i] = word->string ? (int)header.n_w++ : -1;
+        if (!word->string) continue;
+        header.n_links += word->n_nw;
+        header.strings_size += strlen(word->string) + 1;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint32_t string_offset = 0, first_link = 0;
+    for (int i = 0; i < model->n_w; i++) {
+        Word* word = model->words + i;
+        if (!word->string) continue;
+        FileWord file_word = {string_offset, word->n_occurrences, word->is_sentence_ender, first_link, word->n_nw};
+        written &= fwrite(&file_word, sizeof(file_word), 1, file) == 1;
+        string_offset += strlen(word->string) + 1;
+        first_link += word->n_nw;
+    }
+    for (int i = 0; i < model->n_w; i++) {
+        Word* word = model->words + i;
+        if (!word->string) continue;
+        for (int j = 0; j < word->n_nw; j++) {
+            int32_t link = renumbered[word->next_words[j]];
+            written &= fwrite(&link, sizeof(link), 1, file) == 1;
+        }
+    }
+    for (int i = 0; i < model->n_ssw; i++) {
+        int32_t start = renumbered[model->sentence_starting_words[i]];
+        written &= fwrite(&start, sizeof(start), 1, file) == 1;
+    }
+    for (int i = 0; i < model->n_w; i++) {
+        char* string = model->words[i].string;
+        if (string) written &= fwrite(string, strlen(string) + 1, 1, file) == 1;
+    }
+    free(renumbered);
+    return written ? 0 : -1;
+}
+
+/*  Function: load_model
+*   --------------------
+*   Maps a file written by save_model and wraps a read-only model around it.  Only the Word
+*   structs and the word index are allocated; strings and successor arrays are used in place,
+*   so processes loading the same file share its pages.  Returns NULL if the file cannot be
+*   opened or is not a valid model file.
+*/
+Model* load_model(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (!fstat(fd, &info) && info.st_size >= (off_t)sizeof(ModelFileHeader)) {
+        mapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) return NULL;
+    if (!check_model_file(mapping, info.st_size)) {
+        munmap(mapping, info.st_size);
+        return NULL;
+    }
+    ModelFileHeader* header = mapping;
+    FileWord* file_words = (FileWord*)(header + 1);
+    int* links = (int*)(file_words + header->n_w);
+    int* starts = links + header->n_links;
+    char* strings = (char*)(starts + header->n_ssw);
+    Model* model = initialize_model();
+    model->n_w = model->words_cap = header->n_w;
+    model->words = malloc((model->n_w + 1) * sizeof(Word));
+    for (int i = 0; i < model->n_w; i++) {
+        Word* word = model->words + i;
+        word->string = strings + file_words[i].string_offset;
+        word->n_occurrences = file_words[i].n_occurrences;
+        word->is_sentence_ender = file_words[i].is_sentence_ender;
+        word->n_nw = file_words[i].n_links;
+        word->nw_cap = 0;
+        word->next_words = links + file_words[i].first_link;
+    }
+    model->n_ssw = header->n_ssw;
+    model->sentence_starting_words = starts;
+    uint32_t index_size = MIN_WORD_INDEX_SIZE;
+    while (index_size < 2 * (uint32_t)model->n_w) index_size *= 2;
+    resize_word_index(model, index_size);
+    model->new_sentence = false;
+    model->mapping = mapping;
+    model->mapping_size = info.st_size;
+    return model;
+}
+
+/*  Function: check_model_file
+*   --------------------------
+*   Returns true if the size bytes at mapping hold a model file that load_model can use
+*   without reading out of bounds: the sections add up to the file size, every string is
+*   terminated, and every word index and successor range lies inside the file.
+*/
+bool check_model_file(void* mapping, size_t size) {
+    ModelFileHeader* header = mapping;
+    if (memcmp(header->magic, MODEL_FILE_MAGIC, sizeof(header->magic))) return false;
+    if (header->version != MODEL_FILE_VERSION || header->n_w > INT_MAX / 2 || header->n_ssw > INT_MAX) return false;
+    if (header->n_links > size || header->strings_size > size) return false;
+    uint64_t expected = sizeof(ModelFileHeader) + (uint64_t)header->n_w * sizeof(FileWord)
+                        + (header->n_links + header->n_ssw) * sizeof(int32_t) + header->strings_size;
+    if (expected != size) return false;
+    FileWord* file_words = (FileWord*)(header + 1);
+    int* links = (int*)(file_words + header->n_w);
+    char* strings = (char*)(links + header->n_links + header->n_ssw);
+    if (header->strings_size && strings[header->strings_size - 1] != '\0') return false;
+    for (uint32_t i = 0; i < header->n_w; i++) {
+        if (file_words[i].string_offset >= header->strings_size || file_words[i].n_links > INT_MAX) return false;
+        if ((uint64_t)file_words[i].first_link + file_words[i].n_links > header->n_links) return false;
+    }
+    for (uint64_t i = 0; i < header->n_links + header->n_ssw; i++) {
+        if (links[i] < 0 || (uint32_t)links[i] >= header->n_w) return false;
+    }
+    return true;
+}
+
+/*  Function: free_allocated
+*   ------------------------
+*   Frees the model along with every array, string, sketch and mapping it holds.
+*/
+void free_allocated(Model* model) {
+    if (model->cache) free_sentence_cache(model->cache);
+    for (int i = 0; i < model->words_cap; i++) {
+        if (model->words[i].nw_cap) free(model->words[i].next_words);
+        if (!model->mapping && i < model->n_w) free(model->words[i].string);
+    }
+    free(model->words);
+    if (model->ssw_cap) free(model->sentence_starting_words);
+    free(model->word_index);
+    StreamState* stream = model->stream;
+    if (stream) {
+        hh_free(stream->word_counts);
+        hh_free(stream->bigram_counts);
+        free(stream);
+    }
+    LiveState* live = model->live;
+    if (live) {
+        for (int i = 0; i < MAX_WORDS_IN_MODEL; i++) {
+            free(live->words[i].link_targets);
+            free(live->words[i].link_weights);
+        }
+        for (int i = 0; i < live->n_ring; i++) free(live->ring[(live->ring_start + i) % live->window]);
+        free(live->ring);
+        free(live->current);
+        free(live);
+    }
+    if (model->view) free_generation_view(model->view);
+    pthread_mutex_destroy(&model->view_lock);
+    if (model->mapping) munmap(model->mapping, model->mapping_size);
+    free(model);
+}
+
+/*  Function: random_fraction
+*   -------------------------
+*   Returns a random double in [0, 1), built from two draws of random_int so that it has 60
+*   random bits rather than the 31 of one.
+*/
+double random_fraction() {
+    double high = random_int(0, (1 << 30) - 1);
+    double low = random_int(0, (1 << 30) - 1);
+    return (high * (1 << 30) + low) / ((double)(1 << 30) * (1 << 30));
+}
+
 /*  Function: random_int
 *   --------------------
-*   Returns a random integer in the range of the two passed bounds, inclusive.
+*   Returns a random integer in the range of the two passed bounds, inclusive.  While the
+*   thread has a current_stream, the integer is the stream's next draw scaled to the range
+*   by taking the high half of their product, which the vector walks can do as well.
+*   Otherwise each thread draws from its own rand_r state, seeded from the clock and the
+*   address of that state the first time the thread asks for a number.
 */
 int random_int(int lower_bound, int upper_bound) {
+    if (current_stream) {
+        uint32_t draw = hash_draw(current_stream->key, current_stream->counter++);
+        return lower_bound + (int)(((uint64_t)draw * (uint32_t)(upper_bound - lower_bound + 1)) >> 32);
+    }
+    static __thread unsigned int random_state = 0;
+    static __thread bool seeded = false;
+    if (!seeded) {
+        random_state = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&random_state;
+        seeded = true;
+    }
     int range = upper_bound - lower_bound + 1;
-    int random_int = (rand() % range) + lower_bound;
+    int random_int = (rand_r(&random_state) % range) + lower_bound;
     assert(random_int >= lower_bound && random_int <= upper_bound);
     return random_int;
 }
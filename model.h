@@ -3,6 +3,9 @@
 *   for Argo coding challenge
 */
 
+#include <stdbool.h>
+#include <stdint.h>
+
 
 /*  Struct: Model
 *   -------------
@@ -18,6 +21,41 @@ typedef struct ModelImplementation Model;
 */
 Model* create_model(FILE* text);
 
+/*  Function: create_streaming_model
+*   --------------------------------
+*   Creates an empty model for text too large to count exactly.  Word and bigram
+*   counts are approximated in sketches that never exceed memory_budget bytes,
+*   and only the most frequent words and bigrams are kept in the model.  The
+*   model's own arrays, rebuilt from the sketches, are not part of the budget:
+*   they can hold up to 10000 words of 100 successors each.  Feed it with
+*   ingest_text.
+*/
+Model* create_streaming_model(size_t memory_budget);
+
+/*  Function: create_windowed_model
+*   -------------------------------
+*   Creates an empty model for continuously arriving text that only reflects the
+*   last window sentences ingested.  Counts from older sentences are subtracted
+*   as they fall out of the window, or earlier if the model would otherwise
+*   exceed 10000 distinct words.  Feed it with ingest_text.
+*/
+Model* create_windowed_model(int window);
+
+/*  Function: create_decaying_model
+*   -------------------------------
+*   Creates an empty model for continuously arriving text in which every count
+*   loses half its weight each time another half_life sentences are ingested.
+*   Feed it with ingest_text.
+*/
+Model* create_decaying_model(double half_life);
+
+/*  Function: ingest_text
+*   ---------------------
+*   Adds the words of the source text to an existing model, as if the text had
+*   been appended to everything ingested before.
+*/
+void ingest_text(Model* model, FILE* text);
+
 /*  Function: print_model
 *   ---------------------
 *   Prints all elements in the model.
@@ -28,15 +66,135 @@ void print_model(Model* model);
 *   ---------------------------
 *   Creates a randomly-generated sentence of the specified word-length based on
 *   the language model referenced by the Model* pointer.  Returns a char* pointer
-*   to the sentence.
+*   to the heap-allocated sentence, or NULL if no sentence of that length can be
+*   made.  Safe to call from several threads at once as long as no text is being
+*   ingested into the model.
 */
 char* generate_sentence(Model* model, int length);
 
+/*  Function: generate_sentence_cancellable
+*   ---------------------------------------
+*   Like generate_sentence, but the search stops and returns NULL soon after
+*   another thread sets *cancelled to true.  cancelled may be NULL.
+*/
+char* generate_sentence_cancellable(Model* model, int length, const bool* cancelled);
+
+/*  Function: generate_sentence_portfolio
+*   -------------------------------------
+*   Like generate_sentence, but races n_searches independently randomized searches for the
+*   sentence, all but one on the library's worker pool, and returns the first sentence any
+*   of them finds; the rest are cancelled.  The searches run into dead ends in different
+*   places, so this cuts the long waits that an unlucky search sometimes has on models
+*   where few sentences of the length exist.  With n_searches of 1 or less it is the same
+*   as generate_sentence.
+*/
+char* generate_sentence_portfolio(Model* model, int length, int n_searches);
+
+/*  Function: enable_sentence_cache
+*   -------------------------------
+*   Starts a background thread that keeps about capacity pregenerated sentences
+*   of the lengths asked of generate_sentence, shared among the lengths by how
+*   often each was asked for recently.  generate_sentence then returns a ready
+*   sentence whenever there is one, and generates one as usual when there is
+*   not.  The model cannot ingest more text afterwards.
+*/
+void enable_sentence_cache(Model* model, int capacity);
+
+/*  Function: generate_sentences
+*   ----------------------------
+*   Creates n randomly-generated sentences of the same word-length, sharing the
+*   work of finding which words can lead to a sentence of that length.  Stores
+*   heap-allocated sentences in sentences and returns n, or returns 0 (storing
+*   nothing) if no sentence of that length can be made.
+*/
+int generate_sentences(Model* model, int length, int n, char* sentences[]);
+
+/*  Function: find_reachable
+*   ------------------------
+*   Returns a heap-allocated table of bitsets marking which words can still end
+*   a sentence of length words, for generate_sentences_from.  The table stays
+*   valid for as long as the model ingests no more text, and belongs to the
+*   caller, who frees it with free.
+*/
+uint64_t* find_reachable(Model* model, int length);
+
+/*  Function: reachable_size
+*   ------------------------
+*   Returns the number of bytes in the table find_reachable makes for length.
+*/
+size_t reachable_size(Model* model, int length);
+
+/*  Function: generate_sentences_from
+*   ---------------------------------
+*   Like generate_sentences, but walks a table made by find_reachable for the
+*   same model and length instead of working one out, so that callers making
+*   many batches of one length pay for the table once.  Several threads may
+*   share a table.
+*/
+int generate_sentences_from(Model* model, int length, uint64_t reachable[], int n, char* sentences[]);
+
+/*  Function: generate_sentence_seeded
+*   ----------------------------------
+*   Like generate_sentence, but every random choice comes from a counter-based
+*   generator keyed by seed and index, so the same model, length, seed and
+*   index always give the same sentence, on any thread or machine.  The
+*   sentence cache is not used.
+*/
+char* generate_sentence_seeded(Model* model, int length, uint64_t seed, uint64_t index);
+
+/*  Function: generate_sentences_seeded
+*   -----------------------------------
+*   Like generate_sentences, but sentence i is drawn from a counter-based
+*   generator keyed by seed and first_index + i, and the work is split among
+*   n_threads threads, or one per processor if n_threads is not positive.
+*   The sentences do not depend on the number of threads, or on whether
+*   the processor has AVX2, so ranges of indices made on different machines
+*   from the same model file add up to the same batch as a single run.
+*/
+int generate_sentences_seeded(Model* model, int length, uint64_t seed, uint64_t first_index, int n, char* sentences[], int n_threads);
+
+/*  Function: generate_sentences_exact
+*   ----------------------------------
+*   Like generate_sentences, but each sentence is drawn with exactly the probability that
+*   the model produces it, counting every word's bigram probability, among all sentences of
+*   the given length.  generate_sentence and generate_sentences instead pick uniformly among
+*   the words that can still finish the sentence, which favours words with few ways to
+*   finish it.  Uses a table of length doubles per word in the model while it runs.
+*/
+int generate_sentences_exact(Model* model, int length, int n, char* sentences[]);
+
+/*  Function: score_sentence
+*   ------------------------
+*   Returns the natural log of the probability that the model produces the
+*   given sentence: that its first word starts a sentence, that each word
+*   follows the one before it, and that its last word ends it.  Returns
+*   -INFINITY if the model can never produce the sentence.  Like
+*   generate_sentence, it may be called from several threads at once as long as
+*   no text is being ingested into the model.
+*/
+double score_sentence(Model* model, const char* sentence);
+
+/*  Function: save_model
+*   --------------------
+*   Writes the model to an open file in a form load_model can map straight
+*   back in.  Model files use the byte order of the machine that wrote them.
+*   Returns 0 on success, or -1 if writing failed.
+*/
+int save_model(Model* model, FILE* file);
+
+/*  Function: load_model
+*   --------------------
+*   Maps the model file at path, written by save_model, into memory and returns
+*   a read-only model backed by it; several processes loading the same file
+*   share one copy of it.  The model cannot ingest text.  Returns NULL if the
+*   file cannot be read or is not a model file.
+*/
+Model* load_model(const char* path);
+
 /*  Function: free_allocated
 *   ------------------------
-*   Frees heap-allocated memory associated with the model and all generated
-*   sentences.  Warning: will free memory holding generated sentences, so be
-*   sure to save them elsewhere before calling and do not attempt to access
-*   them afterwards.
+*   Frees the model and all memory associated with it.  Sentences returned by
+*   generate_sentence and generate_sentences belong to the caller and are not
+*   freed.
 */
 void free_allocated(Model* model);
\ No newline at end of file
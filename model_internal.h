@@ -0,0 +1,186 @@
+/*  model_internal.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   The model's own data structures, shared by model.c and the files that work
+*   on a model's words directly.  Not for clients of the library, which only
+*   see the Model reference of model.h.  Include model.h, pthread.h, sketch.h
+*   and cache.h first.
+*/
+
+#define MAX_WORD_LENGTH 50  // hard-coded into fscanf format string
+#define MAX_WORDS_IN_MODEL 10000  // for streaming and live models; exact models grow as needed
+
+/*  Struct: Word
+*   ------------
+*   Data structure storing the information for each word in the model.  A word that
+*   followed this one n times appears n times in next_words.
+*/
+typedef struct Word {
+    char* string;   // pointer to the string
+    int n_occurrences; // number of times this word appeared in the text
+    bool is_sentence_ender;  // if the word has been found to end a sentence
+    int n_nw;  // size of next_words
+    int nw_cap;  // allocated size of next_words, 0 if it lies in a mapped model file
+    int* next_words; // array of indices of any words that followed
+} Word;
+
+/*  Struct: ModelImplementation
+*   ---------------------------
+*   Data structure that stores the model.  Contains an array of Word structs, along
+*   with an array of indices of all words that start sentences.  In a model loaded
+*   from a file, the strings, next_words and sentence_starting_words arrays all lie
+*   in the read-only mapping of the file.
+*/
+struct ModelImplementation {
+    int n_w; // size of words
+    int words_cap;  // allocated size of words
+    Word* words; // array of every word, stored as Word structs
+    int n_ssw;  // size of sentence_starting_words
+    int ssw_cap;  // allocated size of sentence_starting_words, 0 if mapped
+    int* sentence_starting_words;  // array of indices of all words that start sentences
+    int* word_index;  // indices into words by string hash, -1 if empty
+    uint32_t index_mask;  // size of word_index - 1; the size is a power of two
+    int last_word;  // index of the last word ingested, to be linked to the next one
+    bool new_sentence;  // if the next word ingested begins a sentence
+    struct StreamState* stream;  // non-NULL if the model is built from sketches
+    struct LiveState* live;  // non-NULL if counts expire or decay as text arrives
+    SentenceCache* cache;  // pregenerated sentences, or NULL
+    void* mapping;  // start of the mapped model file, or of its copy in huge pages, or NULL
+    size_t mapping_size;
+    bool huge_pages;  // if large arrays should be backed by huge pages
+    bool node_replicas;  // if seeded batches walk a copy of the view on each NUMA node
+    struct GenerationView* view;  // pruned lists for searching, built on demand, or NULL
+    pthread_mutex_t view_lock;  // held while the view is rebuilt
+};
+
+/*  Struct: GenerationView
+*   ----------------------
+*   The model's successor and starting-word lists with every entry that cannot lead to a
+*   sentence ender stripped out, for the backtracking search to follow.  A word is pruned
+*   when it does not end sentences and none of its successors can lead to one, which takes
+*   in words with no successors and, transitively, words that only lead to them.  Pruned
+*   words keep empty lists and are never entered, since no list holds them.  The view also
+*   keeps every word's predecessors, pruned or not, so that text ingested into an exact
+*   model can update it in place.  Lists start out packed in one shared block each; a list
+*   that has to grow moves to an array of its own, marked by a non-zero capacity.  The view
+*   is the only derived structure updated in place: the per-length tables made by
+*   find_reachable are not, since every caller either makes a fresh one per batch or keeps
+*   them only for a model that takes no more text (the sentence cache and the server).
+*/
+typedef struct GenerationView {
+    int n_w;  // words the per-word arrays cover
+    int words_cap;  // words the per-word arrays have room for
+    int* n_next;  // parallel to the model's words, size of each next array
+    int** next;  // parallel to the model's words, the viable entries of next_words
+    int* next_cap;  // parallel to the model's words, room in a moved next array, or 0
+    int* links;  // shared block for the next arrays
+    int* n_prev;  // parallel to the model's words, size of each prev array
+    int** prev;  // parallel to the model's words, one entry per next_words entry naming it
+    int* prev_cap;  // parallel to the model's words, room in a moved prev array, or 0
+    int* prev_links;  // shared block for the prev arrays
+    bool* viable;  // parallel to the model's words, if the word can lead to a sentence ender
+    int n_starts;
+    int* starts;  // the viable entries of sentence_starting_words
+    bool starts_stale;  // if a word has become viable since starts was filled
+    int* queue;  // words waiting to be made viable, while an update spreads
+    int queue_cap;
+    int n_pruned;  // words that cannot lead to a sentence ender
+    struct GenerationView** replicas;  // per NUMA node copies of the walk lists, built on demand, or NULL
+    size_t memory;  // bytes allocated for the view, and for its replicas
+} GenerationView;
+
+/*  Struct: StreamState
+*   -------------------
+*   Bounded-memory counters for a streaming model.  Words and bigrams are kept
+*   as heavy hitters, and how often each word starts or ends a sentence is kept
+*   in tallies on the word's entry.  The regular arrays of the model are rebuilt from
+*   these every COMPACTION_INTERVAL words and at the end of each ingest.
+*/
+typedef struct StreamState {
+    HeavyHitters* word_counts;
+    HeavyHitters* bigram_counts;
+    char last_word[MAX_WORD_LENGTH + 1];
+    int n_since_compaction;  // words streamed since the last compaction
+} StreamState;
+
+/*  Struct: LiveWord
+*   ----------------
+*   Counts behind one Word of a live model.  Weights are in units of the model's current
+*   scale, so that decaying every count is just a change of scale.  The distinct successors
+*   and their bigram weights are the source of truth; the Word's next_words array is a
+*   sampling table derived from them and is only rebuilt when the word is dirty.
+*/
+typedef struct LiveWord {
+    double weight;  // occurrences
+    double start_weight;  // occurrences at the start of a sentence
+    double end_weight;  // occurrences at the end of a sentence
+    int n_links;  // size of link_targets and link_weights
+    int links_cap;
+    int* link_targets;  // indices of every distinct word that followed
+    double* link_weights;  // bigram counts for each of link_targets
+    int starter_pos;  // position in the model's starters, or -1
+    bool dirty;  // if next_words or is_sentence_ender is out of date
+} LiveWord;
+
+/*  Struct: LiveState
+*   -----------------
+*   State of a live model.  In window mode the last window sentences are kept as arrays of
+*   word indices in a ring, and each one's counts are subtracted when it falls out.  In decay
+*   mode each completed sentence multiplies scale by growth, which shrinks every existing
+*   count relative to new ones; once scale reaches PRUNE_SCALE all weights are divided
+*   through and light counts are dropped.  Words whose counts reach zero (or drop below
+*   MIN_LIVE_WEIGHT) are removed and their slots reused.
+*/
+typedef struct LiveState {
+    int window;  // sentences kept in window mode, 0 in decay mode
+    double growth;  // per-sentence growth of scale in decay mode, 1 in window mode
+    double scale;  // weight of one new occurrence
+    LiveWord words[MAX_WORDS_IN_MODEL];  // parallel to the model's words
+    int** ring;  // completed sentences in the window, as word indices ending in -1
+    int ring_start;  // position of the oldest sentence in ring
+    int n_ring;  // number of sentences in ring
+    int* current;  // indices of the words of the sentence in progress
+    int n_current;
+    int current_cap;
+    int starters[MAX_WORDS_IN_MODEL];  // indices of words with start weight
+    int n_starters;
+    bool starters_dirty;  // if sentence_starting_words is out of date
+    int dirty[MAX_WORDS_IN_MODEL];  // indices of dirty words
+    int n_dirty;
+    int free_words[MAX_WORDS_IN_MODEL];  // indices of removed words, for reuse
+    int n_free;
+    int slots[MAX_WORDS_IN_MODEL];  // scratch for refresh_live_words
+    double weights[MAX_WORDS_IN_MODEL];  // scratch for refresh_live_words
+} LiveState;
+
+/*  Function: compare_by_frequency / compare_alphabetically / compare_ints
+*   ----------------------------------------------------------------------
+*   Provided by model.c.  qsort comparators for arrays of Word pointers, most
+*   occurrences first or by string alone, and for ascending ints.
+*/
+int compare_by_frequency(const void* a, const void* b);
+int compare_alphabetically(const void* a, const void* b);
+int compare_ints(const void* a, const void* b);
+
+/*  Function: resize_word_index / get_generation_view / free_generation_view
+*   ------------------------------------------------------------------------
+*   Provided by model.c.  resize_word_index refills the hash table from strings
+*   to words at the given size, a power of two.  get_generation_view returns
+*   the model's generation view, building it first if there is none, and
+*   free_generation_view frees one, which is then built again when next needed.
+*   build_generation_view builds a fresh view without attaching it to the
+*   model, which test_model compares with one kept up to date as text arrives.
+*/
+void resize_word_index(Model* model, uint32_t size);
+GenerationView* get_generation_view(Model* model);
+GenerationView* build_generation_view(Model* model);
+void free_generation_view(GenerationView* view);
+
+/*  Variable: use_vector_kernels
+*   ----------------------------
+*   Provided by model.c.  True unless cleared, as test_model does, to make the
+*   walks and reachable tables use their scalar kernels even on a processor with
+*   AVX2.  Both kernels give the same results.
+*/
+extern bool use_vector_kernels;
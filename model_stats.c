@@ -0,0 +1,81 @@
+/*  model_stats.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "model.h"
+#include "stats.h"
+#include "options.h"
+
+//  -------Function prototypes-------
+void print_memory(const char* label, size_t bytes);
+//  ---------------------------------
+
+/*	Function: main
+*	--------------
+*	Invocation: model_stats [-b budget_kb | -w window | -d half_life] text_file
+*	            model_stats -m model_file
+*	Creates the model as print_model would, or loads a model file written by build_model
+*	with -m, then prints a summary of its shape and memory use.
+*/
+int main(int argc, char* argv[]) {
+	Model* model = NULL;
+	bool model_file = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "b:w:d:m")) != -1) {
+		if (opt == 'm') model_file = true;
+		else if (!parse_model_option(opt, optarg, &model)) exit(1);
+	}
+	if (argc - optind != 1) {
+		printf("Please invoke as: model_stats [-b budget_kb | -w window | -d half_life] text_file\n");
+		printf("               or model_stats -m model_file\n");
+		exit(1);
+	}
+	if (model_file) {
+		model = load_model(argv[optind]);
+		if (!model) {
+			printf("Model could not be loaded from %s.\n", argv[optind]);
+			exit(1);
+		}
+	} else model = build_model_from(model, argv[optind]);
+	ModelStats stats;
+	compute_model_stats(model, &stats);
+	int n_words = stats.n_words ? stats.n_words : 1;
+	printf("----------STATS----------\n");
+	printf("Vocabulary:          %d words\n", stats.n_words);
+	printf("Tokens:              %ld\n", stats.n_tokens);
+	printf("Successor entries:   %ld\n", stats.n_links);
+	printf("Distinct bigrams:    %ld\n", stats.n_edges);
+	printf("Fan-out:             p50 %d, p99 %d, max %d\n", stats.p50_fan_out, stats.p99_fan_out, stats.max_fan_out);
+	printf("Dead ends:           %d (%.2f%%)\n", stats.n_dead_ends, 100.0 * stats.n_dead_ends / n_words);
+	printf("Pruned:              %d (%.2f%%) cannot reach a sentence ender\n", stats.n_pruned, 100.0 * stats.n_pruned / n_words);
+	printf("Sentence starters:   %d words, %d starts\n", stats.n_starters, stats.n_starts);
+	printf("Sentence enders:     %d words\n", stats.n_enders);
+	printf("Components:          %d, largest %d words, %d single words\n", stats.n_components, stats.largest_component, stats.n_singleton_components);
+	printf("---Memory:\n");
+	print_memory("Words", stats.memory_words);
+	print_memory("Strings", stats.memory_strings);
+	print_memory("Successor arrays", stats.memory_links);
+	print_memory("Starting words", stats.memory_starts);
+	print_memory("Word index", stats.memory_index);
+	print_memory("Mapped file", stats.memory_mapping);
+	print_memory("Sketches", stats.memory_stream);
+	print_memory("Live counts", stats.memory_live);
+	print_memory("Generation view", stats.memory_view);
+	print_memory("Total", stats.memory_total);
+	printf("-------------------------\n");
+	free_allocated(model);
+	return 0;
+}
+
+/*	Function: print_memory
+*	----------------------
+*	Prints one line of the memory breakdown, in kilobytes.
+*/
+void print_memory(const char* label, size_t bytes) {
+	printf("  %-18s %10.1f KB\n", label, bytes / 1024.0);
+}
@@ -0,0 +1,215 @@
+/*  nodes.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: finds the machine's NUMA nodes and gives each one its own copy of
+*   the walk lists of a model's generation view, so that the threads of a
+*   seeded batch, bound to the nodes in turn by model.c, never wait on another
+*   node's memory for a step.
+*   -------------------------
+*   Design choices & notes:
+*    - The topology is read from /sys rather than through libnuma, and
+*      memory is placed by first touch rather than mbind: each copy is made by
+*      a thread already bound to its node.
+*    - Only the lists a walk reads are copied.  Word strings, read once per
+*      finished sentence, stay shared.
+*    - Everything falls back to one node: off Linux, without a topology
+*      directory, or where the node count is 1, enable_node_replicas leaves
+*      the model alone.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE  // for processor sets and thread affinity
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "pages.h"
+#include "nodes.h"
+#ifdef __linux__
+#include <sched.h>
+#define NODE_REPLICAS  // threads may be bound to NUMA nodes
+#endif
+
+#define NODE_TOPOLOGY_DIR "/sys/devices/system/node"
+
+/*  Struct: NumaNode
+*   ----------------
+*   One NUMA node with processors, as listed under NODE_TOPOLOGY_DIR.  The nodes are found
+*   once per process, by the first call to enable_node_replicas.
+*/
+#ifdef NODE_REPLICAS
+typedef struct NumaNode {
+    cpu_set_t cpus;
+} NumaNode;
+
+static NumaNode* numa_nodes = NULL;
+#endif
+static int n_numa_nodes = 0;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+
+//  -------Function prototypes-------
+GenerationView* copy_walk_lists(Model* model, GenerationView* view);
+void discover_nodes(void);
+#ifdef NODE_REPLICAS
+bool read_id_list(const char* path, cpu_set_t* ids);
+#endif
+//  ---------------------------------
+
+
+/*  Function: numa_node_count
+*   -------------------------
+*   Returns n_numa_nodes, which only changes under topology_once.
+*/
+int numa_node_count(void) {
+    return n_numa_nodes;
+}
+
+/*  Function: bind_to_node
+*   ----------------------
+*   Sets the affinity of attr to the node's processors.
+*/
+void bind_to_node(pthread_attr_t* attr, int node) {
+#ifdef NODE_REPLICAS
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &numa_nodes[node].cpus);
+#endif
+}
+
+/*  Function: get_node_view
+*   -----------------------
+*   Returns the replica of the model's generation view for the NUMA node, first copying it
+*   under the model's lock if there is none, from the calling thread, which is bound to the
+*   node.
+*/
+GenerationView* get_node_view(Model* model, int node) {
+    GenerationView* view = get_generation_view(model);
+    pthread_mutex_lock(&model->view_lock);
+    if (!view->replicas) view->replicas = calloc(n_numa_nodes, sizeof(GenerationView*));
+    if (!view->replicas[node]) {
+        view->replicas[node] = copy_walk_lists(model, view);
+        view->memory += view->replicas[node]->memory;
+    }
+    GenerationView* replica = view->replicas[node];
+    pthread_mutex_unlock(&model->view_lock);
+    return replica;
+}
+
+/*  Function: copy_walk_lists
+*   -------------------------
+*   Returns a view holding only what walk_sentences reads, the successor and starting-word
+*   lists, copied into fresh blocks.
+*/
+GenerationView* copy_walk_lists(Model* model, GenerationView* view) {
+    int n_w = view->n_w;
+    long n_links = 0;
+    for (int w = 0; w < n_w; w++) n_links += view->n_next[w];
+    GenerationView* replica = calloc(1, sizeof(GenerationView));
+    replica->n_w = replica->words_cap = n_w;
+    replica->n_next = malloc((n_w + 1) * sizeof(int));
+    replica->next = malloc((n_w + 1) * sizeof(int*));
+    replica->links = malloc((n_links + 1) * sizeof(int));
+    if (model->huge_pages) {
+        advise_huge_pages(replica->n_next, (n_w + 1) * sizeof(int));
+        advise_huge_pages(replica->next, (n_w + 1) * sizeof(int*));
+        advise_huge_pages(replica->links, (n_links + 1) * sizeof(int));
+    }
+    memcpy(replica->n_next, view->n_next, n_w * sizeof(int));
+    int* link = replica->links;
+    for (int w = 0; w < n_w; w++) {
+        replica->next[w] = link;
+        memcpy(link, view->next[w], view->n_next[w] * sizeof(int));
+        link += view->n_next[w];
+    }
+    replica->n_starts = view->n_starts;
+    replica->starts = malloc((view->n_starts + 1) * sizeof(int));
+    memcpy(replica->starts, view->starts, view->n_starts * sizeof(int));
+    replica->memory = sizeof(GenerationView) + (n_w + 1) * (sizeof(int) + sizeof(int*));
+    replica->memory += (n_links + 1 + view->n_starts + 1) * sizeof(int);
+    return replica;
+}
+
+/*  Function: free_view_replicas
+*   ----------------------------
+*   Frees the view's node replicas, if it has any.
+*/
+void free_view_replicas(GenerationView* view) {
+    if (!view->replicas) return;
+    for (int i = 0; i < n_numa_nodes; i++) {
+        GenerationView* replica = view->replicas[i];
+        if (!replica) continue;
+        view->memory -= replica->memory;
+        free(replica->starts);
+        free(replica->links);
+        free(replica->next);
+        free(replica->n_next);
+        free(replica);
+    }
+    free(view->replicas);
+    view->replicas = NULL;
+}
+
+/*  Function: enable_node_replicas
+*   ------------------------------
+*   Finds the machine's NUMA nodes, if not yet found, and if there is more than one, marks
+*   the model for generate_sentences_seeded to spread its threads across them.  Returns the
+*   number of nodes, or 1 if the model is left alone.
+*/
+int enable_node_replicas(Model* model) {
+    pthread_once(&topology_once, discover_nodes);
+    if (n_numa_nodes < 2) return 1;
+    model->node_replicas = true;
+    return n_numa_nodes;
+}
+
+/*  Function: discover_nodes
+*   ------------------------
+*   Fills numa_nodes with the online nodes listed under NODE_TOPOLOGY_DIR that have
+*   processors, skipping nodes with memory only.  Leaves none where there is no such
+*   directory, as on systems other than Linux.
+*/
+void discover_nodes(void) {
+#ifdef NODE_REPLICAS
+    cpu_set_t online;
+    if (!read_id_list(NODE_TOPOLOGY_DIR "/online", &online)) return;
+    numa_nodes = malloc((CPU_COUNT(&online) + 1) * sizeof(NumaNode));
+    for (int id = 0; id < CPU_SETSIZE; id++) {
+        if (!CPU_ISSET(id, &online)) continue;
+        char path[sizeof(NODE_TOPOLOGY_DIR) + 32];
+        sprintf(path, NODE_TOPOLOGY_DIR "/node%d/cpulist", id);
+        NumaNode* node = numa_nodes + n_numa_nodes;
+        if (read_id_list(path, &node->cpus) && CPU_COUNT(&node->cpus)) n_numa_nodes++;
+    }
+#endif
+}
+
+#ifdef NODE_REPLICAS
+/*  Function: read_id_list
+*   ----------------------
+*   Reads a list of ids in the kernel's format, such as "0-3,8-11", from the file into the
+*   set.  Returns false if the file could not be opened.
+*/
+bool read_id_list(const char* path, cpu_set_t* ids) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    CPU_ZERO(ids);
+    int first, last;
+    char separator = ',';
+    while (separator == ',' && fscanf(file, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(file, "%c", &separator) == 1 && separator == '-') {
+            if (fscanf(file, "%d%c", &last, &separator) < 1) break;
+        }
+        for (int id = first; id <= last && id < CPU_SETSIZE; id++) CPU_SET(id, ids);
+    }
+    fclose(file);
+    return true;
+}
+#endif
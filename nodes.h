@@ -0,0 +1,43 @@
+/*  nodes.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Spreading seeded batches across the NUMA nodes of a machine, each node
+*   walking its own copy of the model's successor lists.  The functions after
+*   enable_node_replicas are used by model.c.  Include model.h and pthread.h
+*   first.
+*/
+
+/*  Function: enable_node_replicas
+*   ------------------------------
+*   On a machine with several NUMA nodes, has generate_sentences_seeded bind
+*   its threads to the nodes in turn and give each node its own copy of the
+*   successor lists the walks read, so that no step waits on another node's
+*   memory.  The nodes are read from /sys.  The copies are made by the first
+*   batch and again after text is ingested.  Returns the number of nodes, or
+*   1 if there is only one node, or none could be found, and nothing changes.
+*/
+int enable_node_replicas(Model* model);
+
+/*  Function: numa_node_count
+*   -------------------------
+*   Returns the number of nodes found by enable_node_replicas, or 0 before it
+*   is first called.
+*/
+int numa_node_count(void);
+
+/*  Function: bind_to_node
+*   ----------------------
+*   Sets the attributes of a thread about to be created to run it on the
+*   processors of the node.  Does nothing where nodes are not supported.
+*/
+void bind_to_node(pthread_attr_t* attr, int node);
+
+/*  Function: get_node_view / free_view_replicas
+*   --------------------------------------------
+*   get_node_view returns the node's copy of the walk lists of the model's
+*   generation view, made by the calling thread, bound to the node, the first
+*   time it is asked for.  free_view_replicas frees a view's copies.
+*/
+struct GenerationView* get_node_view(Model* model, int node);
+void free_view_replicas(struct GenerationView* view);
@@ -0,0 +1,62 @@
+/*  options.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: parses the -b, -w and -d model options for the tools, and feeds
+*   the named text file to the model they chose.
+*   -------------------------
+*   Design choices & notes:
+*    - A window is a whole number of sentences, so -w is read as an integer
+*      and rejected rather than truncated if it has a fraction; the budget and
+*      half-life may be fractional.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "model.h"
+#include "options.h"
+
+/*  Function: parse_model_option
+*   ----------------------------
+*   Reads the argument as a positive integer for -w and a positive number otherwise, then
+*   creates the model.
+*/
+bool parse_model_option(int opt, const char* arg, Model** model) {
+    if (opt != 'b' && opt != 'w' && opt != 'd') return false;
+    if (opt == 'w') {
+        char* end;
+        long long window = strtoll(arg, &end, 10);
+        if (end == arg || *end || window < 1 || window > INT_MAX) {
+            printf("Option -w could not be read.\n");
+            exit(1);
+        }
+        *model = create_windowed_model((int)window);
+        return true;
+    }
+    double value = 0;
+    if (sscanf(arg, "%lf", &value) != 1 || value <= 0) {
+        printf("Option -%c could not be read.\n", opt);
+        exit(1);
+    }
+    if (opt == 'b') *model = create_streaming_model((size_t)(value * 1024));
+    else *model = create_decaying_model(value);
+    return true;
+}
+
+/*  Function: build_model_from
+*   --------------------------
+*   Opens the file and either ingests it or creates a model from it.
+*/
+Model* build_model_from(Model* model, const char* filename) {
+    FILE* text = fopen(filename, "r");
+    if (!text) {
+        printf("File %s could not be opened.\n", filename);
+        exit(1);
+    }
+    if (model) ingest_text(model, text);
+    else model = create_model(text);
+    fclose(text);
+    return model;
+}
@@ -0,0 +1,25 @@
+/*  options.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   The model options shared by the tools that build a model from text:
+*   -b budget_kb for a streaming model, -w window for a windowed one and
+*   -d half_life for a decaying one.  Include model.h and stdbool.h first.
+*/
+
+/*  Function: parse_model_option
+*   ----------------------------
+*   Given an option and its argument as returned by getopt, creates the empty
+*   model it asks for in *model and returns true, or returns false, leaving
+*   *model alone, if the option is not one of -b, -w and -d.  Exits if the
+*   argument cannot be read.
+*/
+bool parse_model_option(int opt, const char* arg, Model** model);
+
+/*  Function: build_model_from
+*   --------------------------
+*   Reads the text file into model, if an option created one, or otherwise
+*   creates an exact model from it, and returns the model.  Exits if the file
+*   cannot be opened.
+*/
+Model* build_model_from(Model* model, const char* filename);
@@ -0,0 +1,114 @@
+/*  pages.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: backs a model's large arrays with 2 MB pages, which cuts the TLB
+*   misses of walks that jump between words all over a large model.  A loaded
+*   model's file is copied into huge pages, and the words array and the tables
+*   built for generating are advised to use transparent huge pages.
+*   -------------------------
+*   Design choices & notes:
+*    - Explicit huge pages are only there if the administrator reserved some,
+*      so transparent huge pages are the fallback, and where neither is
+*      available the model simply keeps its ordinary pages.
+*    - Copying a loaded model's file gives up sharing it with other processes,
+*      so a model only gets huge pages when they are asked for.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "pages.h"
+
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)  // size of the pages enable_huge_pages asks for
+
+
+//  -------Function prototypes-------
+void* map_huge_pages(size_t size);
+//  ---------------------------------
+
+
+/*  Function: enable_huge_pages
+*   ---------------------------
+*   Copies a loaded model's file into memory from map_huge_pages, read-only like the file,
+*   and points the words and starting words into the copy.  If no huge pages can be had for
+*   the copy the file stays mapped as it was, still shared.  The words array is advised to
+*   use huge pages, and the generation view is dropped so that it is built again with its
+*   walk arrays advised as well, as are the tables made for each batch from then on.
+*/
+bool enable_huge_pages(Model* model) {
+    model->huge_pages = true;
+    bool granted = advise_huge_pages(model->words, model->words_cap * sizeof(Word));
+    if (model->mapping) {
+        size_t size = (model->mapping_size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        char* copy = map_huge_pages(size);
+        if (copy) {
+            granted = true;
+            char* mapping = model->mapping;
+            memcpy(copy, mapping, model->mapping_size);
+            mprotect(copy, size, PROT_READ);
+            for (int i = 0; i < model->n_w; i++) {
+                Word* word = model->words + i;
+                word->string = copy + (word->string - mapping);
+                word->next_words = (int*)(copy + ((char*)word->next_words - mapping));
+            }
+            model->sentence_starting_words = (int*)(copy + ((char*)model->sentence_starting_words - mapping));
+            munmap(mapping, model->mapping_size);
+            model->mapping = copy;
+            model->mapping_size = size;
+        }
+    }
+    if (model->view) {
+        free_generation_view(model->view);
+        model->view = NULL;
+    }
+    return granted;
+}
+
+/*  Function: map_huge_pages
+*   ------------------------
+*   Returns size bytes (a multiple of HUGE_PAGE_SIZE) of anonymous memory backed by huge
+*   pages, to be released with munmap, or NULL if none could be had.  Explicit huge pages
+*   (MAP_HUGETLB) are tried first, which only succeeds if the system has reserved some;
+*   otherwise the memory is mapped with ordinary pages and a huge page's worth more, trimmed
+*   to the alignment, and advised to be backed by transparent huge pages.  Memory whose
+*   advice is refused is unmapped again.
+*/
+void* map_huge_pages(size_t size) {
+#ifdef MAP_HUGETLB
+    void* huge = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED) return huge;
+#endif
+    char* region = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) return NULL;
+    size_t lead = (HUGE_PAGE_SIZE - (uintptr_t)region % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+    if (lead) munmap(region, lead);
+    munmap(region + lead + size, HUGE_PAGE_SIZE - lead);
+    if (advise_huge_pages(region + lead, size)) return region + lead;
+    munmap(region + lead, size);
+    return NULL;
+}
+
+/*  Function: advise_huge_pages
+*   ---------------------------
+*   Advises the kernel to back the whole huge pages within size bytes from start with
+*   transparent huge pages.  Returns true if there were any and the advice was taken, and
+*   false if not, or if the system has no such advice.
+*/
+bool advise_huge_pages(void* start, size_t size) {
+#ifdef MADV_HUGEPAGE
+    uintptr_t first = ((uintptr_t)start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+    uintptr_t last = ((uintptr_t)start + size) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+    return last > first && !madvise((void*)first, last - first, MADV_HUGEPAGE);
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,28 @@
+/*  pages.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Backing a model's large arrays with huge pages.  Include model.h and
+*   stdbool.h first.
+*/
+
+/*  Function: enable_huge_pages
+*   ---------------------------
+*   Asks for the model's large arrays to be backed by 2 MB pages, which cut the
+*   TLB misses of a walk through a large model: its words, the file of a model
+*   loaded with load_model, and the tables built for generating.  A loaded
+*   model's file is copied into memory for this, so it is no longer shared with
+*   other processes.  Where huge pages are unavailable the model keeps using
+*   ordinary pages.  Call it before generating or enabling a cache.  Returns
+*   true if the system accepted the request for any of the memory.
+*/
+bool enable_huge_pages(Model* model);
+
+/*  Function: advise_huge_pages
+*   ---------------------------
+*   Used by model.c for the tables it builds for a model with huge pages
+*   enabled.  Asks for the whole huge pages within size bytes from start to be
+*   backed by transparent huge pages, and returns true if there were any and
+*   the request was taken.
+*/
+bool advise_huge_pages(void* start, size_t size);
@@ -4,20 +4,37 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <assert.h>
+#include <unistd.h>
 #include "model.h"
+#include "export.h"
+#include "options.h"
 
 /*	Function: main
 *	--------------
-*	Invocation: print_model [filename]
-*	Creates the model, then prints it.
+*	Invocation: print_model [-b budget_kb | -w window | -d half_life] [-f | -a] [-c] [filename]
+*	Creates the model, then prints it.  With -b, the model is built in streaming mode
+*	within a memory budget of budget_kb kilobytes; with -w, it only counts the last
+*	window sentences; with -d, its counts halve every half_life sentences.  With -f, words
+*	are listed most frequent first, and with -a, alphabetically; with -c, each successor is
+*	listed once with its count rather than once per occurrence.
 */
 int main(int argc, char* argv[]) {
-	FILE* text = fopen(argv[1], "r");
-	assert(text);
-	Model* model = create_model(text);
-	print_model(model);
-	fclose(text);
+	Model* model = NULL;
+	ModelOrder order = ORDER_INGESTED;
+	bool show_counts = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "b:w:d:fac")) != -1) {
+		if (opt == 'f') order = ORDER_BY_FREQUENCY;
+		else if (opt == 'a') order = ORDER_ALPHABETICAL;
+		else if (opt == 'c') show_counts = true;
+		else if (!parse_model_option(opt, optarg, &model)) exit(1);
+	}
+	model = build_model_from(model, argv[optind]);
+	if (write_model(model, stdout, order, show_counts) != 0) {
+		printf("Could not print model.\n");
+		exit(1);
+	}
 	return 0;
-}
\ No newline at end of file
+}
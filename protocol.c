@@ -0,0 +1,188 @@
+/*  protocol.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: byte-order helpers, request encoders and blocking frame I/O for
+*   clients of the sentence server.  The server itself reads and writes frames
+*   through its own non-blocking buffers.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+
+
+//  -------Function prototypes-------
+int write_all(int fd, const unsigned char* buf, size_t n);
+int read_all(int fd, unsigned char* buf, size_t n);
+uint32_t put_name(unsigned char* payload, uint8_t op, uint32_t id, const char* name);
+//  ---------------------------------
+
+
+/*  Function: put_u16 / put_u32 / put_u64 / get_u16 / get_u32 / get_u64
+*   -------------------------------------------------------------------
+*   Big-endian stores and loads, built up from the 16-bit versions.
+*/
+void put_u16(unsigned char* buf, uint16_t value) {
+    buf[0] = value >> 8;
+    buf[1] = value;
+}
+
+void put_u32(unsigned char* buf, uint32_t value) {
+    put_u16(buf, value >> 16);
+    put_u16(buf + 2, value);
+}
+
+void put_u64(unsigned char* buf, uint64_t value) {
+    put_u32(buf, value >> 32);
+    put_u32(buf + 4, value);
+}
+
+uint16_t get_u16(const unsigned char* buf) {
+    return (uint16_t)(buf[0] << 8 | buf[1]);
+}
+
+uint32_t get_u32(const unsigned char* buf) {
+    return (uint32_t)get_u16(buf) << 16 | get_u16(buf + 2);
+}
+
+uint64_t get_u64(const unsigned char* buf) {
+    return (uint64_t)get_u32(buf) << 32 | get_u32(buf + 4);
+}
+
+/*  Function: encode_generate_request
+*   ---------------------------------
+*   Fills in the request header followed by the word count.
+*/
+uint32_t encode_generate_request(unsigned char* payload, uint32_t id, uint16_t model, uint16_t n_words) {
+    payload[0] = OP_GENERATE;
+    put_u32(payload + 1, id);
+    put_u16(payload + 5, model);
+    put_u16(payload + REQUEST_HEADER_LENGTH, n_words);
+    return REQUEST_HEADER_LENGTH + 2;
+}
+
+/*  Function: encode_score_request
+*   ------------------------------
+*   Fills in the request header followed by the sentence text.
+*/
+uint32_t encode_score_request(unsigned char* payload, uint32_t id, uint16_t model, const char* sentence) {
+    size_t length = strlen(sentence);
+    payload[0] = OP_SCORE;
+    put_u32(payload + 1, id);
+    put_u16(payload + 5, model);
+    memcpy(payload + REQUEST_HEADER_LENGTH, sentence, length);
+    return REQUEST_HEADER_LENGTH + length;
+}
+
+/*  Function: encode_named_generate_request
+*   ---------------------------------------
+*   Fills in the request header and model name followed by the word count.
+*/
+uint32_t encode_named_generate_request(unsigned char* payload, uint32_t id, const char* name, uint16_t n_words) {
+    uint32_t length = put_name(payload, OP_GENERATE_NAMED, id, name);
+    put_u16(payload + length, n_words);
+    return length + 2;
+}
+
+/*  Function: encode_named_score_request
+*   ------------------------------------
+*   Fills in the request header and model name followed by the sentence text.
+*/
+uint32_t encode_named_score_request(unsigned char* payload, uint32_t id, const char* name, const char* sentence) {
+    uint32_t length = put_name(payload, OP_SCORE_NAMED, id, name);
+    memcpy(payload + length, sentence, strlen(sentence));
+    return length + strlen(sentence);
+}
+
+/*  Function: put_name
+*   ------------------
+*   Fills in the header of a named request (with a model index of 0) and the length-prefixed
+*   name, and returns the offset of the body.
+*/
+uint32_t put_name(unsigned char* payload, uint8_t op, uint32_t id, const char* name) {
+    size_t name_length = strlen(name);
+    payload[0] = op;
+    put_u32(payload + 1, id);
+    put_u16(payload + 5, 0);
+    payload[REQUEST_HEADER_LENGTH] = name_length;
+    memcpy(payload + REQUEST_HEADER_LENGTH + 1, name, name_length);
+    return REQUEST_HEADER_LENGTH + 1 + name_length;
+}
+
+/*  Function: connect_to_server
+*   ---------------------------
+*   Opens a stream socket and connects it to socket_path.
+*/
+int connect_to_server(const char* socket_path) {
+    struct sockaddr_un address;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*  Function: send_frame
+*   --------------------
+*   Writes the length header, then the payload.
+*/
+int send_frame(int fd, const unsigned char* payload, uint32_t length) {
+    unsigned char header[FRAME_HEADER_LENGTH];
+    put_u32(header, length);
+    if (write_all(fd, header, FRAME_HEADER_LENGTH)) return -1;
+    return write_all(fd, payload, length);
+}
+
+/*  Function: receive_frame
+*   -----------------------
+*   Reads the length header, rejects oversized frames, then reads the payload.
+*/
+int receive_frame(int fd, unsigned char* payload) {
+    unsigned char header[FRAME_HEADER_LENGTH];
+    if (read_all(fd, header, FRAME_HEADER_LENGTH)) return -1;
+    uint32_t length = get_u32(header);
+    if (length > MAX_FRAME_LENGTH) return -1;
+    if (read_all(fd, payload, length)) return -1;
+    return (int)length;
+}
+
+/*  Function: write_all
+*   -------------------
+*   Writes all n bytes, retrying after partial writes and interruptions.
+*/
+int write_all(int fd, const unsigned char* buf, size_t n) {
+    while (n) {
+        ssize_t written = write(fd, buf, n);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return -1;
+        buf += written;
+        n -= written;
+    }
+    return 0;
+}
+
+/*  Function: read_all
+*   ------------------
+*   Reads exactly n bytes, retrying after partial reads and interruptions.
+*/
+int read_all(int fd, unsigned char* buf, size_t n) {
+    while (n) {
+        ssize_t n_read = read(fd, buf, n);
+        if (n_read < 0 && errno == EINTR) continue;
+        if (n_read <= 0) return -1;
+        buf += n_read;
+        n -= n_read;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*  protocol.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Wire format spoken over the sentence server's Unix domain socket.  Every
+*   message is a frame: a 4-byte payload length followed by the payload.  All
+*   integers are big-endian.
+*
+*   Request payload:   u8 op, u32 request id, u16 model index, then
+*     OP_GENERATE:     u16 number of words, at most MAX_REQUEST_WORDS
+*     OP_SCORE:        the sentence text (not NUL-terminated)
+*     OP_GENERATE_NAMED: u8 name length, the model name, u16 number of words
+*     OP_SCORE_NAMED:  u8 name length, the model name, the sentence text
+*   Named requests ignore the model index and ask for a model from the server's
+*   model directory instead.
+*   Response payload:  u8 status, u32 request id, then on STATUS_OK
+*     OP_GENERATE:     the sentence text (not NUL-terminated)
+*     OP_SCORE:        u64 holding the bits of the log-probability (a double)
+*
+*   Responses on one connection may arrive in a different order than the
+*   requests; match them by request id.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MAX_FRAME_LENGTH 65536
+#define MAX_REQUEST_WORDS 1000  // longest sentence asked for; its text still fits in one frame
+#define FRAME_HEADER_LENGTH 4
+#define REQUEST_HEADER_LENGTH 7
+#define RESPONSE_HEADER_LENGTH 5
+
+#define OP_GENERATE 1
+#define OP_SCORE 2
+#define OP_GENERATE_NAMED 3
+#define OP_SCORE_NAMED 4
+
+#define MAX_MODEL_NAME_LENGTH 255
+
+#define STATUS_OK 0
+#define STATUS_NO_SENTENCE 1  // no sentence of that length can be made
+#define STATUS_NO_MODEL 2  // model index out of range, or no model of that name
+#define STATUS_BAD_REQUEST 3  // unknown op, malformed payload, or more than MAX_REQUEST_WORDS words
+
+/*  Function: put_u16 / put_u32 / put_u64
+*   -------------------------------------
+*   Store value big-endian at buf.
+*/
+void put_u16(unsigned char* buf, uint16_t value);
+void put_u32(unsigned char* buf, uint32_t value);
+void put_u64(unsigned char* buf, uint64_t value);
+
+/*  Function: get_u16 / get_u32 / get_u64
+*   -------------------------------------
+*   Load a big-endian value from buf.
+*/
+uint16_t get_u16(const unsigned char* buf);
+uint32_t get_u32(const unsigned char* buf);
+uint64_t get_u64(const unsigned char* buf);
+
+/*  Function: encode_generate_request
+*   ---------------------------------
+*   Writes a generate request payload to payload and returns its length.
+*/
+uint32_t encode_generate_request(unsigned char* payload, uint32_t id, uint16_t model, uint16_t n_words);
+
+/*  Function: encode_score_request
+*   ------------------------------
+*   Writes a score request payload to payload, which must have room for
+*   REQUEST_HEADER_LENGTH + strlen(sentence) bytes, and returns its length.
+*/
+uint32_t encode_score_request(unsigned char* payload, uint32_t id, uint16_t model, const char* sentence);
+
+/*  Function: encode_named_generate_request / encode_named_score_request
+*   --------------------------------------------------------------------
+*   Like encode_generate_request and encode_score_request, but address the
+*   model by name, which must be at most MAX_MODEL_NAME_LENGTH bytes.  A score
+*   request needs room for REQUEST_HEADER_LENGTH + 1 + strlen(name) +
+*   strlen(sentence) bytes.
+*/
+uint32_t encode_named_generate_request(unsigned char* payload, uint32_t id, const char* name, uint16_t n_words);
+uint32_t encode_named_score_request(unsigned char* payload, uint32_t id, const char* name, const char* sentence);
+
+/*  Function: connect_to_server
+*   ---------------------------
+*   Connects to the server listening at socket_path.  Returns the socket, or -1
+*   on failure.
+*/
+int connect_to_server(const char* socket_path);
+
+/*  Function: send_frame
+*   --------------------
+*   Writes one frame holding length bytes of payload to a blocking socket.
+*   Returns 0 on success, -1 on failure.
+*/
+int send_frame(int fd, const unsigned char* payload, uint32_t length);
+
+/*  Function: receive_frame
+*   -----------------------
+*   Reads one frame from a blocking socket into payload, which must hold
+*   MAX_FRAME_LENGTH bytes.  Returns the payload length, or -1 on failure or end
+*   of stream.
+*/
+int receive_frame(int fd, unsigned char* payload);
@@ -0,0 +1,354 @@
+/*  registry.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: a hash table of models by name, each loaded with load_model the
+*   first time it is asked for, with the resident models kept in a list from
+*   most to least recently acquired.  When the models take more than the
+*   memory budget, the least recently acquired models that nobody is using are
+*   freed.
+*   -------------------------
+*   Design choices & notes:
+*    - One mutex guards the table, the list and the counts, but it is never
+*      held while a file is loaded or a model is freed, so a slow load only
+*      holds up the threads that want that same model.  They wait on the
+*      entry's condition variable rather than loading it a second time.
+*    - Model files are mapped rather than read, so a model that is evicted
+*      and loaded again usually comes straight back from the page cache, and
+*      several server processes share one copy of each model.
+*    - A model in use is never evicted, even if that leaves the registry over
+*      budget; it becomes a candidate again once it is released.
+*    - A model grows after loading when the first generate builds its view,
+*      and again with each node replica, so its size is measured again every
+*      time it is released and the budget enforced against the new total.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "model.h"
+#include "stats.h"
+#include "registry.h"
+#include "sketch.h"
+
+#define MAX_NAME_LENGTH 255
+#define MIN_BUCKETS 64  // power of two
+
+/*  Struct: RegistryEntry
+*   ---------------------
+*   A model in the table, which may still be loading.  Threads waiting for the load count as
+*   users, so that the entry outlives them even if the load fails.
+*/
+typedef struct RegistryEntry {
+    char* name;
+    Model* model;  // NULL while loading, or if the load failed
+    size_t size;  // model_memory of model, as of its load or latest release
+    int n_users;  // acquisitions not yet released, plus threads waiting for the load
+    bool loading;
+    pthread_cond_t loaded;  // signalled when loading finishes
+    struct RegistryEntry* next;  // next entry in the same bucket, or next victim to free
+    struct RegistryEntry* newer;  // neighbours in the recency list
+    struct RegistryEntry* older;
+} RegistryEntry;
+
+/*  Struct: ModelRegistryImplementation
+*   -----------------------------------
+*   The table of entries, chained by bucket, and the recency list of loaded entries.
+*/
+struct ModelRegistryImplementation {
+    char* directory;
+    size_t memory_budget;
+    size_t resident;  // total size of loaded entries
+    pthread_mutex_t lock;
+    RegistryEntry** buckets;
+    uint32_t bucket_mask;  // number of buckets - 1
+    int n_entries;
+    RegistryEntry* newest;  // most recently acquired loaded entry
+    RegistryEntry* oldest;
+};
+
+
+//  -------Function prototypes-------
+bool check_name(const char* name);
+RegistryEntry* find_entry(ModelRegistry* registry, const char* name);
+RegistryEntry* add_entry(ModelRegistry* registry, const char* name);
+void remove_entry(ModelRegistry* registry, RegistryEntry* entry);
+void grow_buckets(ModelRegistry* registry);
+void push_newest(ModelRegistry* registry, RegistryEntry* entry);
+void unlink_entry(ModelRegistry* registry, RegistryEntry* entry);
+RegistryEntry* evict_models(ModelRegistry* registry);
+void free_entries(RegistryEntry* victims);
+Model* load_entry(ModelRegistry* registry, RegistryEntry* entry);
+//  ---------------------------------
+
+
+/*  Function: create_registry
+*   -------------------------
+*   Allocates the registry with an empty table.
+*/
+ModelRegistry* create_registry(const char* directory, size_t memory_budget) {
+    ModelRegistry* registry = malloc(sizeof(ModelRegistry));
+    registry->directory = strdup(directory);
+    registry->memory_budget = memory_budget;
+    registry->resident = 0;
+    pthread_mutex_init(&registry->lock, NULL);
+    registry->buckets = calloc(MIN_BUCKETS, sizeof(RegistryEntry*));
+    registry->bucket_mask = MIN_BUCKETS - 1;
+    registry->n_entries = 0;
+    registry->newest = NULL;
+    registry->oldest = NULL;
+    return registry;
+}
+
+/*  Function: acquire_model
+*   -----------------------
+*   Finds or creates the entry for name.  The thread that creates it loads the model with the
+*   lock released, then evicts whatever no longer fits; threads that find it still loading wait
+*   for the loader.  A failed load removes the entry from the table so that a later acquisition
+*   tries the file again, and the last of its users frees it.
+*/
+Model* acquire_model(ModelRegistry* registry, const char* name) {
+    if (!check_name(name)) return NULL;
+    pthread_mutex_lock(&registry->lock);
+    RegistryEntry* entry = find_entry(registry, name);
+    RegistryEntry* victims = NULL;
+    if (!entry) {
+        entry = add_entry(registry, name);
+        pthread_mutex_unlock(&registry->lock);
+        Model* model = load_entry(registry, entry);
+        pthread_mutex_lock(&registry->lock);
+        entry->model = model;
+        entry->loading = false;
+        if (model) {
+            registry->resident += entry->size;
+            push_newest(registry, entry);
+            victims = evict_models(registry);
+        } else remove_entry(registry, entry);
+        pthread_cond_broadcast(&entry->loaded);
+    } else {
+        entry->n_users++;
+        while (entry->loading) pthread_cond_wait(&entry->loaded, &registry->lock);
+        if (entry->model) {
+            unlink_entry(registry, entry);
+            push_newest(registry, entry);
+        }
+    }
+    Model* model = entry->model;
+    if (!model && !--entry->n_users) {
+        entry->next = victims;
+        victims = entry;
+    }
+    pthread_mutex_unlock(&registry->lock);
+    free_entries(victims);
+    return model;
+}
+
+/*  Function: release_model
+*   -----------------------
+*   Drops one use of the entry for name, evicting models if the registry is over budget.  The
+*   model is measured again first, with the lock released, so that whatever it has built
+*   since it was last measured counts towards the budget.  The use being released keeps the
+*   entry in the table meanwhile.
+*/
+void release_model(ModelRegistry* registry, const char* name) {
+    pthread_mutex_lock(&registry->lock);
+    RegistryEntry* entry = find_entry(registry, name);
+    Model* model = entry && entry->n_users > 0 ? entry->model : NULL;
+    pthread_mutex_unlock(&registry->lock);
+    if (!model) return;
+    size_t size = model_memory(model);
+    pthread_mutex_lock(&registry->lock);
+    registry->resident += size - entry->size;
+    entry->size = size;
+    entry->n_users--;
+    RegistryEntry* victims = evict_models(registry);
+    pthread_mutex_unlock(&registry->lock);
+    free_entries(victims);
+}
+
+/*  Function: registry_memory
+*   -------------------------
+*   Returns the total size of the loaded models.
+*/
+size_t registry_memory(ModelRegistry* registry) {
+    pthread_mutex_lock(&registry->lock);
+    size_t resident = registry->resident;
+    pthread_mutex_unlock(&registry->lock);
+    return resident;
+}
+
+/*  Function: free_registry
+*   -----------------------
+*   Frees every entry, its model, and the registry itself.
+*/
+void free_registry(ModelRegistry* registry) {
+    for (uint32_t i = 0; i <= registry->bucket_mask; i++) {
+        RegistryEntry* entry = registry->buckets[i];
+        while (entry) {
+            RegistryEntry* next = entry->next;
+            entry->next = NULL;
+            free_entries(entry);
+            entry = next;
+        }
+    }
+    pthread_mutex_destroy(&registry->lock);
+    free(registry->buckets);
+    free(registry->directory);
+    free(registry);
+}
+
+/*  Function: check_name
+*   --------------------
+*   Returns true if name can be used as a model name: non-empty, not too long, not starting
+*   with a dot and without slashes, so that it always names a file inside the directory.
+*/
+bool check_name(const char* name) {
+    size_t length = strlen(name);
+    return length > 0 && length <= MAX_NAME_LENGTH && name[0] != '.' && !strchr(name, '/');
+}
+
+/*  Function: find_entry
+*   --------------------
+*   Returns the entry for name, or NULL if it is not in the table.
+*/
+RegistryEntry* find_entry(ModelRegistry* registry, const char* name) {
+    RegistryEntry* entry = registry->buckets[hash_key(name) & registry->bucket_mask];
+    while (entry && strcmp(entry->name, name)) entry = entry->next;
+    return entry;
+}
+
+/*  Function: add_entry
+*   -------------------
+*   Creates a loading entry for name, used by the calling thread, and adds it to the table,
+*   doubling the buckets first if there would be more entries than buckets.
+*/
+RegistryEntry* add_entry(ModelRegistry* registry, const char* name) {
+    if (registry->n_entries + 1 > (int)registry->bucket_mask + 1) grow_buckets(registry);
+    RegistryEntry* entry = malloc(sizeof(RegistryEntry));
+    entry->name = strdup(name);
+    entry->model = NULL;
+    entry->size = 0;
+    entry->n_users = 1;
+    entry->loading = true;
+    pthread_cond_init(&entry->loaded, NULL);
+    entry->newer = NULL;
+    entry->older = NULL;
+    RegistryEntry** bucket = registry->buckets + (hash_key(name) & registry->bucket_mask);
+    entry->next = *bucket;
+    *bucket = entry;
+    registry->n_entries++;
+    return entry;
+}
+
+/*  Function: remove_entry
+*   ----------------------
+*   Takes the entry out of its bucket.  The entry itself is left for the caller to free.
+*/
+void remove_entry(ModelRegistry* registry, RegistryEntry* entry) {
+    RegistryEntry** link = registry->buckets + (hash_key(entry->name) & registry->bucket_mask);
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    entry->next = NULL;
+    registry->n_entries--;
+}
+
+/*  Function: grow_buckets
+*   ----------------------
+*   Doubles the number of buckets and moves every entry into its new bucket.
+*/
+void grow_buckets(ModelRegistry* registry) {
+    uint32_t old_mask = registry->bucket_mask;
+    RegistryEntry** old_buckets = registry->buckets;
+    registry->bucket_mask = 2 * old_mask + 1;
+    registry->buckets = calloc(registry->bucket_mask + 1, sizeof(RegistryEntry*));
+    for (uint32_t i = 0; i <= old_mask; i++) {
+        RegistryEntry* entry = old_buckets[i];
+        while (entry) {
+            RegistryEntry* next = entry->next;
+            RegistryEntry** bucket = registry->buckets + (hash_key(entry->name) & registry->bucket_mask);
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(old_buckets);
+}
+
+/*  Function: push_newest
+*   ---------------------
+*   Puts a loaded entry at the most recent end of the recency list.
+*/
+void push_newest(ModelRegistry* registry, RegistryEntry* entry) {
+    entry->newer = NULL;
+    entry->older = registry->newest;
+    if (registry->newest) registry->newest->newer = entry;
+    else registry->oldest = entry;
+    registry->newest = entry;
+}
+
+/*  Function: unlink_entry
+*   ----------------------
+*   Takes a loaded entry out of the recency list.
+*/
+void unlink_entry(ModelRegistry* registry, RegistryEntry* entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else registry->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else registry->oldest = entry->newer;
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+/*  Function: evict_models
+*   ----------------------
+*   While the loaded models exceed the budget, removes the least recently acquired entries
+*   that have no users from the table.  Returns them as a list, linked through next, for the
+*   caller to free once the lock is released.
+*/
+RegistryEntry* evict_models(ModelRegistry* registry) {
+    RegistryEntry* victims = NULL;
+    RegistryEntry* entry = registry->oldest;
+    while (entry && registry->resident > registry->memory_budget) {
+        RegistryEntry* newer = entry->newer;
+        if (!entry->n_users) {
+            unlink_entry(registry, entry);
+            remove_entry(registry, entry);
+            registry->resident -= entry->size;
+            entry->next = victims;
+            victims = entry;
+        }
+        entry = newer;
+    }
+    return victims;
+}
+
+/*  Function: free_entries
+*   ----------------------
+*   Frees each entry in a list linked through next, along with its model.
+*/
+void free_entries(RegistryEntry* victims) {
+    while (victims) {
+        RegistryEntry* next = victims->next;
+        if (victims->model) free_allocated(victims->model);
+        pthread_cond_destroy(&victims->loaded);
+        free(victims->name);
+        free(victims);
+        victims = next;
+    }
+}
+
+/*  Function: load_entry
+*   --------------------
+*   Loads the model file for the entry, recording its size.  Called without the lock, by the
+*   only thread that may touch the entry's model and size until loading is cleared.
+*/
+Model* load_entry(ModelRegistry* registry, RegistryEntry* entry) {
+    char path[strlen(registry->directory) + strlen(entry->name) + sizeof("/.model")];
+    sprintf(path, "%s/%s.model", registry->directory, entry->name);
+    Model* model = load_model(path);
+    if (model) entry->size = model_memory(model);
+    return model;
+}
@@ -0,0 +1,53 @@
+/*  registry.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Shared set of read-only models loaded on demand from a directory of model
+*   files, evicting the least recently used models to stay within a memory
+*   budget.  Include model.h first.
+*/
+
+/*  Struct: ModelRegistry
+*   ---------------------
+*   Reference to a registry of models.
+*/
+typedef struct ModelRegistryImplementation ModelRegistry;
+
+/*  Function: create_registry
+*   -------------------------
+*   Creates an empty registry that loads the model called name from the file
+*   name.model in directory, and keeps at most memory_budget bytes of models
+*   that are not in use.
+*/
+ModelRegistry* create_registry(const char* directory, size_t memory_budget);
+
+/*  Function: acquire_model
+*   -----------------------
+*   Returns the model called name, loading it first if it is not resident.  If
+*   another thread is already loading it, waits for that load instead of
+*   starting another.  The model stays resident until every acquisition of it
+*   has been released.  Returns NULL if there is no such model file.  Safe to
+*   call from several threads at once.
+*/
+Model* acquire_model(ModelRegistry* registry, const char* name);
+
+/*  Function: release_model
+*   -----------------------
+*   Gives up one successful acquisition of the model called name.  Whatever
+*   the model has built while in use, such as its generation view, counts
+*   towards the memory budget from then on.  The model must not be used
+*   afterwards unless it is acquired again.
+*/
+void release_model(ModelRegistry* registry, const char* name);
+
+/*  Function: registry_memory
+*   -------------------------
+*   Returns the number of bytes held by resident models.
+*/
+size_t registry_memory(ModelRegistry* registry);
+
+/*  Function: free_registry
+*   -----------------------
+*   Frees the registry and every resident model.  No model may be in use.
+*/
+void free_registry(ModelRegistry* registry);
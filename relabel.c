@@ -0,0 +1,119 @@
+/*  relabel.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: renumbers the words of an exact model, by frequency or breadth
+*   first over the bigram graph, and moves its Word structs into the new order,
+*   so that a walk through the model, and through a model file saved after it,
+*   touches fewer cache lines and pages.
+*   -------------------------
+*   Design choices & notes:
+*    - The breadth-first order is plain BFS from the starting words, most
+*      frequent first, rather than reverse Cuthill-McKee; ordering each level
+*      by degree adds nothing for a walk that only follows edges forward.
+*    - Only models built from text in this process are relabeled.  A mapped
+*      model's arrays lie in its read-only file, and streaming and live models
+*      rebuild or reuse their words' slots as counts come and go, which would
+*      undo the order.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "relabel.h"
+
+
+//  -------Function prototypes-------
+int label_reached_words(Model* model, int new_index[], int old_at[], int n_labeled, int head);
+//  ---------------------------------
+
+
+/*  Function: relabel_model
+*   -----------------------
+*   Works out each word's new index, old_at listing the words in their new order, then moves
+*   the Word structs into a new array in that order and rewrites every index held elsewhere.
+*   Each successor list is sorted as well, so that a word's successors are visited in address
+*   order and repeated entries sit together; generation draws entries uniformly, so the order
+*   of a list does not matter to it.  The generation view is dropped and rebuilt when next
+*   needed, and the word index is filled again at its current size.
+*/
+void relabel_model(Model* model, RelabelOrder order) {
+    if (model->mapping || model->stream || model->live || model->cache) {
+        printf("Only an exact model without a sentence cache can be relabeled.\n");
+        exit(1);
+    }
+    int n_w = model->n_w;
+    Word** by_frequency = malloc((n_w + 1) * sizeof(Word*));
+    for (int i = 0; i < n_w; i++) by_frequency[i] = model->words + i;
+    qsort(by_frequency, n_w, sizeof(Word*), compare_by_frequency);
+    int* new_index = malloc((n_w + 1) * sizeof(int));
+    int* old_at = malloc((n_w + 1) * sizeof(int));
+    if (order == RELABEL_BY_FREQUENCY) {
+        for (int i = 0; i < n_w; i++) old_at[i] = by_frequency[i] - model->words;
+    } else {
+        for (int i = 0; i < n_w; i++) new_index[i] = -1;
+        int n_labeled = 0;
+        for (int i = 0; i < model->n_ssw; i++) new_index[model->sentence_starting_words[i]] = 0;
+        for (int i = 0; i < n_w; i++) {  // starting words first, the most frequent leading
+            int word = by_frequency[i] - model->words;
+            if (!new_index[word]) old_at[n_labeled++] = word;
+        }
+        for (int i = 0; i < n_labeled; i++) new_index[old_at[i]] = i;
+        n_labeled = label_reached_words(model, new_index, old_at, n_labeled, 0);
+        for (int i = 0; i < n_w; i++) {  // words no starting word leads to, with what they lead to
+            int word = by_frequency[i] - model->words;
+            if (new_index[word] >= 0) continue;
+            new_index[word] = n_labeled;
+            old_at[n_labeled] = word;
+            n_labeled = label_reached_words(model, new_index, old_at, n_labeled + 1, n_labeled);
+        }
+    }
+    for (int i = 0; i < n_w; i++) new_index[old_at[i]] = i;
+    Word* words = malloc((model->words_cap + 1) * sizeof(Word));
+    for (int i = 0; i < model->words_cap; i++) {
+        words[i] = model->words[i < n_w ? old_at[i] : i];
+        if (i >= n_w) continue;
+        for (int j = 0; j < words[i].n_nw; j++) words[i].next_words[j] = new_index[words[i].next_words[j]];
+        qsort(words[i].next_words, words[i].n_nw, sizeof(int), compare_ints);
+    }
+    for (int i = 0; i < model->n_ssw; i++) {
+        model->sentence_starting_words[i] = new_index[model->sentence_starting_words[i]];
+    }
+    if (model->last_word >= 0) model->last_word = new_index[model->last_word];
+    free(model->words);
+    model->words = words;
+    resize_word_index(model, model->index_mask + 1);
+    if (model->view) {
+        free_generation_view(model->view);
+        model->view = NULL;
+    }
+    free(by_frequency);
+    free(new_index);
+    free(old_at);
+}
+
+/*  Function: label_reached_words
+*   -----------------------------
+*   Labels words breadth first for relabel_model.  The words in old_at from head up to
+*   n_labeled are labeled but not yet expanded; each in turn gives the next labels to those
+*   of its successors that have none, in the order they first followed it.  Returns the
+*   number of words labeled once no labeled word is left to expand.
+*/
+int label_reached_words(Model* model, int new_index[], int old_at[], int n_labeled, int head) {
+    for (; head < n_labeled; head++) {
+        Word* word = model->words + old_at[head];
+        for (int i = 0; i < word->n_nw; i++) {
+            int next_word = word->next_words[i];
+            if (new_index[next_word] >= 0) continue;
+            new_index[next_word] = n_labeled;
+            old_at[n_labeled++] = next_word;
+        }
+    }
+    return n_labeled;
+}
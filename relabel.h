@@ -0,0 +1,29 @@
+/*  relabel.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Renumbering a model's words so that the words a walk visits together sit
+*   together in memory and in saved model files.  Include model.h first.
+*/
+
+/*  Enum: RelabelOrder
+*   ------------------
+*   Order in which relabel_model numbers words: by number of occurrences (most
+*   first), or breadth first over the bigram graph from the sentence-starting
+*   words, most frequent first.
+*/
+typedef enum RelabelOrder {
+    RELABEL_BY_FREQUENCY,
+    RELABEL_BY_BFS
+} RelabelOrder;
+
+/*  Function: relabel_model
+*   -----------------------
+*   Renumbers the words of an exact model in the given order, so that the words
+*   a walk visits most sit close together in memory, and saves written afterward
+*   lay the file out the same way.  ORDER_INGESTED then lists words in the new
+*   order.  Call it once the text is ingested, before generating, enabling a
+*   cache or creating enumerators.  Exits if the model is not an exact model
+*   built from text in this process.
+*/
+void relabel_model(Model* model, RelabelOrder order);
@@ -0,0 +1,73 @@
+/*  sentence_client.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "protocol.h"
+
+/*	Function: main
+*	--------------
+*	Invocation: sentence_client [socket_path] [model_index | model_name] [n_words_in_sentence]
+*	        or: sentence_client [socket_path] [model_index | model_name] -s [sentence]
+*	Asks a running sentence_server for a sentence of the specified length, or for the
+*	log-probability of the given sentence, and prints the answer.  A model given by name
+*	is looked up in the server's model directory.
+*/
+int main(int argc, char* argv[]) {
+	int model = 0, n_words = 0;
+	int score = argc == 5 && !strcmp(argv[3], "-s");
+	if ((argc != 4 && !score) || (!score && sscanf(argv[3], "%d", &n_words) != 1)) {
+		printf("Please invoke as: sentence_client socket_path (model_index | model_name) (n_words | -s sentence)\n");
+		exit(1);
+	}
+	char* name = sscanf(argv[2], "%d", &model) == 1 ? NULL : argv[2];
+	if (name && strlen(name) > MAX_MODEL_NAME_LENGTH) {
+		printf("Model name is too long.\n");
+		exit(1);
+	}
+	if (score && strlen(argv[4]) > MAX_FRAME_LENGTH - REQUEST_HEADER_LENGTH - 1 - MAX_MODEL_NAME_LENGTH) {
+		printf("Sentence is too long.\n");
+		exit(1);
+	}
+	int fd = connect_to_server(argv[1]);
+	if (fd < 0) {
+		printf("Could not connect to %s.\n", argv[1]);
+		exit(1);
+	}
+	unsigned char* payload = malloc(MAX_FRAME_LENGTH + 1);
+	uint32_t length;
+	if (name) {
+		length = score ? encode_named_score_request(payload, 1, name, argv[4])
+			: encode_named_generate_request(payload, 1, name, n_words);
+	} else {
+		length = score ? encode_score_request(payload, 1, model, argv[4])
+			: encode_generate_request(payload, 1, model, n_words);
+	}
+	int response_length;
+	if (send_frame(fd, payload, length) || (response_length = receive_frame(fd, payload)) < RESPONSE_HEADER_LENGTH) {
+		printf("Request failed.\n");
+		exit(1);
+	}
+	close(fd);
+	unsigned char status = payload[0];
+	if (status == STATUS_NO_SENTENCE) printf("No sentences of selected length possible from this model.\n");
+	else if (status == STATUS_NO_MODEL && name) printf("No model %s on this server.\n", name);
+	else if (status == STATUS_NO_MODEL) printf("No model %d on this server.\n", model);
+	else if (status != STATUS_OK) printf("Request rejected.\n");
+	else if (score) {
+		uint64_t bits = get_u64(payload + RESPONSE_HEADER_LENGTH);
+		double log_probability;
+		memcpy(&log_probability, &bits, sizeof(bits));
+		printf("Log-probability of \"%s\": %g\n", argv[4], log_probability);
+	} else {
+		payload[response_length] = '\0';
+		printf("Random sentence of %d words: \"%s\"\n", n_words, payload + RESPONSE_HEADER_LENGTH);
+	}
+	free(payload);
+	return 0;
+}
@@ -0,0 +1,836 @@
+/*  sentence_server.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Long-running server that builds its models once and then answers generate
+*   and score requests over a Unix domain socket (see protocol.h).  One thread
+*   runs an epoll loop that accepts connections, reads requests and writes
+*   responses; the requests themselves run on a worker pool, which hands each
+*   finished response back to the loop through a queue and a wake-up pipe.
+*   With -b, generate requests for the same model and length that arrive within
+*   the batch window are run together as one call to generate_sentences.
+*   With -r, requests may also name a model file in a directory; such models are
+*   loaded on first use and evicted when unused models exceed the -M budget.
+*   With -C, each model built from a text keeps a cache of pregenerated sentences.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "model.h"
+#include "registry.h"
+#include "protocol.h"
+#include "workers.h"
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536
+#define MAX_BATCH 256  // a batch this large is run without waiting out its window
+#define DEFAULT_REGISTRY_BUDGET_MB 256
+#define REACHABLE_BUDGET_MB 64  // reachable tables kept for batches, least recently used evicted first
+
+/*	Struct: Connection
+*	------------------
+*	A client connection with its unparsed input and unsent output.  A client that shuts
+*	down its side of the socket is still answered; the connection is closed once every
+*	request it sent has been answered and flushed.  Closed connections are only freed
+*	between batches of events, once no requests are running for them, so a closed
+*	connection can still be handed a stale event or a late response (which is dropped).
+*/
+typedef struct Connection {
+	int fd;
+	unsigned char* in;
+	size_t n_in, in_cap;
+	unsigned char* out;
+	size_t out_start, n_out, out_cap;  // bytes out[out_start, n_out) are unsent
+	int n_pending;  // requests handed to the workers and not yet answered
+	bool closed;
+	bool read_closed;  // if the client has sent everything, and EPOLLIN is no longer registered
+	bool want_write;  // if EPOLLOUT is registered
+	struct Connection* next_closed;
+} Connection;
+
+/*	Struct: Server
+*	--------------
+*	Everything the event loop and the workers share.
+*/
+typedef struct Server {
+	int epoll_fd;
+	int listen_fd;
+	int wake_fds[2];  // pipe written by workers when done_head becomes non-empty
+	Model** models;
+	int n_models;
+	ModelRegistry* registry;  // models by name, or NULL
+	WorkerPool* pool;
+	pthread_mutex_t done_lock;
+	struct Job* done_head;  // finished jobs waiting to be sent
+	struct Job* done_tail;
+	Connection* closed;  // closed connections not yet freed
+	long batch_window;  // nanoseconds a batch stays open, or 0 to run requests alone
+	int n_searches;  // searches raced for each unbatched generate request
+	int timer_fd;  // fires at the deadline of the first open batch
+	struct Batch* batches;  // open batches, in order of deadline
+	struct Batch* last_batch;
+	pthread_mutex_t tables_lock;
+	struct ReachableTable* tables;  // reachable tables kept for batches, most recently used first
+	size_t table_bytes;  // total size of the kept tables
+} Server;
+
+/*	Struct: Job
+*	-----------
+*	One request on its way through a worker and back to its connection.
+*/
+typedef struct Job {
+	Server* server;
+	Connection* conn;
+	uint8_t op;  // OP_GENERATE or OP_SCORE, for named requests too
+	uint32_t id;
+	uint16_t model;
+	char* name;  // model name of a named request, or NULL
+	uint16_t n_words;
+	char* sentence;  // text to score
+	unsigned char* response;  // complete response frame
+	uint32_t response_length;
+	struct Job* next;
+} Job;
+
+/*	Struct: Batch
+*	-------------
+*	Generate requests for one model and length collected during a batch window.  Since
+*	every batch stays open for the same window, batches opened later close later, and the
+*	server's list of open batches stays in deadline order by appending.
+*/
+typedef struct Batch {
+	uint16_t model;
+	uint16_t n_words;
+	int n_jobs;
+	Job* first_job;
+	Job* last_job;
+	long long deadline;  // CLOCK_MONOTONIC nanoseconds
+	struct Batch* next;
+} Batch;
+
+/*	Struct: ReachableTable
+*	----------------------
+*	A reachable table made by find_reachable for one of the server's models and a length,
+*	kept for later batches of that model and length.  The models built from the texts never
+*	ingest more text, so the tables never go stale; they are only evicted to keep the kept
+*	tables within REACHABLE_BUDGET_MB, and never while a batch is walking them.
+*/
+typedef struct ReachableTable {
+	uint16_t model;
+	uint16_t n_words;
+	uint64_t* reachable;
+	size_t size;
+	int n_users;  // batches walking the table
+	bool kept;  // if the table is in the server's list, rather than made for one batch
+	struct ReachableTable* next;
+} ReachableTable;
+
+static volatile sig_atomic_t stopping = 0;
+
+
+//  -------Function prototypes-------
+void serve(Server* server);
+int listen_on(const char* socket_path);
+void accept_connections(Server* server);
+void read_requests(Server* server, Connection* conn);
+void parse_frames(Server* server, Connection* conn);
+void handle_request(Server* server, Connection* conn, unsigned char* payload, uint32_t length);
+void run_job(void* job_ptr);
+void add_to_batch(Server* server, Job* job);
+void close_due_batches(Server* server);
+void remove_batch(Server* server, Batch* batch);
+void arm_batch_timer(Server* server);
+void run_batch(void* batch_ptr);
+ReachableTable* batch_table(Server* server, Batch* batch);
+ReachableTable* take_table(Server* server, Batch* batch);
+void release_table(Server* server, ReachableTable* table);
+void evict_tables(Server* server);
+void finish_jobs(Server* server, Job* first, Job* last);
+long long monotonic_now();
+void send_finished_jobs(Server* server);
+void queue_response(Server* server, Connection* conn, unsigned char* frame, uint32_t length);
+unsigned char* build_response(uint8_t status, uint32_t id, const void* body, uint32_t body_length, uint32_t* length);
+void flush_output(Server* server, Connection* conn);
+void watch_connection(Server* server, Connection* conn);
+void close_connection(Server* server, Connection* conn);
+void free_closed_connections(Server* server);
+void set_nonblocking(int fd);
+void handle_stop_signal(int signal_number);
+//  ---------------------------------
+
+
+/*	Function: main
+*	--------------
+*	Invocation: sentence_server [-t n_threads] [-b batch_window_us] [-C cache_capacity]
+*	                            [-r model_directory] [-M budget_mb] [-K n_searches]
+*	                            [socket_path] [filename]...
+*	Builds one model per source text, numbered from 0 in the order given, then serves
+*	requests on socket_path until interrupted.  With -r, named requests are answered from
+*	the model files (made by build_model) in model_directory, keeping at most budget_mb
+*	megabytes of them loaded while they are not in use.  With -C, the models built from the
+*	texts keep about cache_capacity pregenerated sentences each, so that generate requests
+*	that are not batched are usually answered straight from the cache.  With -K, each
+*	generate request that is not batched races n_searches searches on the library's worker
+*	pool and is answered by whichever finds a sentence first.
+*/
+int main(int argc, char* argv[]) {
+	int n_threads = 0, cache_capacity = 0, n_searches = 1;
+	double batch_window_us = 0, budget_mb = DEFAULT_REGISTRY_BUDGET_MB;
+	char* model_directory = NULL;
+	int opt;
+	bool valid = true;
+	while ((opt = getopt(argc, argv, "t:b:C:r:M:K:")) != -1) {
+		if (opt == 't') valid = valid && sscanf(optarg, "%d", &n_threads) == 1;
+		else if (opt == 'C') valid = valid && sscanf(optarg, "%d", &cache_capacity) == 1 && cache_capacity >= 0;
+		else if (opt == 'b') valid = valid && sscanf(optarg, "%lf", &batch_window_us) == 1 && batch_window_us >= 0;
+		else if (opt == 'r') model_directory = optarg;
+		else if (opt == 'M') valid = valid && sscanf(optarg, "%lf", &budget_mb) == 1 && budget_mb >= 0;
+		else if (opt == 'K') valid = valid && sscanf(optarg, "%d", &n_searches) == 1 && n_searches >= 1;
+		else valid = false;
+	}
+	if (!valid || argc - optind < (model_directory ? 1 : 2)) {
+		printf("Please invoke as: sentence_server [-t n_threads] [-b batch_window_us] [-C cache_capacity] [-r model_directory] [-M budget_mb] [-K n_searches] socket_path filename...\n");
+		exit(1);
+	}
+	Server server;
+	server.batch_window = (long)(batch_window_us * 1000);
+	server.n_searches = n_searches;
+	server.registry = model_directory ? create_registry(model_directory, (size_t)(budget_mb * 1024 * 1024)) : NULL;
+	server.n_models = argc - optind - 1;
+	server.models = malloc(server.n_models * sizeof(Model*));
+	for (int i = 0; i < server.n_models; i++) {
+		FILE* text = fopen(argv[optind + 1 + i], "r");
+		if (!text) {
+			printf("File %s could not be opened.\n", argv[optind + 1 + i]);
+			exit(1);
+		}
+		server.models[i] = create_model(text);
+		fclose(text);
+		if (cache_capacity) enable_sentence_cache(server.models[i], cache_capacity);
+	}
+	pthread_mutex_init(&server.tables_lock, NULL);
+	server.tables = NULL;
+	server.table_bytes = 0;
+	server.listen_fd = listen_on(argv[optind]);
+	server.pool = create_worker_pool(n_threads);
+	printf("Serving %d model(s)%s%s on %s with %d worker(s).\n", server.n_models, model_directory ? " and the models in " : "",
+		model_directory ? model_directory : "", argv[optind], worker_pool_size(server.pool));
+	fflush(stdout);
+	serve(&server);
+	close(server.listen_fd);
+	unlink(argv[optind]);
+	return 0;
+}
+
+/*	Function: serve
+*	---------------
+*	Sets up the epoll instance and the wake-up pipe, then runs the event loop until a stop
+*	signal arrives.  The listening socket and the pipe are registered with pointers to their
+*	descriptors in the Server struct, and connections with their Connection struct, which
+*	is how events are told apart.
+*/
+void serve(Server* server) {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_stop_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	if (pipe(server->wake_fds)) {
+		printf("Could not create wake-up pipe.\n");
+		exit(1);
+	}
+	set_nonblocking(server->wake_fds[0]);
+	set_nonblocking(server->wake_fds[1]);
+	pthread_mutex_init(&server->done_lock, NULL);
+	server->done_head = server->done_tail = NULL;
+	server->closed = NULL;
+	server->epoll_fd = epoll_create1(0);
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = &server->listen_fd;
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event);
+	event.data.ptr = &server->wake_fds[0];
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fds[0], &event);
+	server->batches = server->last_batch = NULL;
+	server->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	event.data.ptr = &server->timer_fd;
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->timer_fd, &event);
+	struct epoll_event events[MAX_EVENTS];
+	while (!stopping) {
+		int n_events = epoll_wait(server->epoll_fd, events, MAX_EVENTS, -1);
+		if (n_events < 0) {
+			if (errno == EINTR) continue;
+			printf("epoll_wait failed.\n");
+			exit(1);
+		}
+		for (int i = 0; i < n_events; i++) {
+			void* source = events[i].data.ptr;
+			if (source == &server->listen_fd) accept_connections(server);
+			else if (source == &server->wake_fds[0]) send_finished_jobs(server);
+			else if (source == &server->timer_fd) close_due_batches(server);
+			else {
+				Connection* conn = source;
+				if (!conn->closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) read_requests(server, conn);
+				if (!conn->closed && (events[i].events & EPOLLOUT)) flush_output(server, conn);
+			}
+		}
+		free_closed_connections(server);
+	}
+}
+
+/*	Function: listen_on
+*	-------------------
+*	Creates a non-blocking listening socket bound to socket_path, replacing any stale
+*	socket file left there.
+*/
+int listen_on(const char* socket_path) {
+	struct sockaddr_un address;
+	if (strlen(socket_path) >= sizeof(address.sun_path)) {
+		printf("Socket path is too long.\n");
+		exit(1);
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socket_path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path);
+	if (fd < 0 || bind(fd, (struct sockaddr*)&address, sizeof(address)) || listen(fd, SOMAXCONN)) {
+		printf("Could not listen on %s.\n", socket_path);
+		exit(1);
+	}
+	set_nonblocking(fd);
+	return fd;
+}
+
+/*	Function: accept_connections
+*	----------------------------
+*	Accepts every pending connection and registers it for reading.
+*/
+void accept_connections(Server* server) {
+	while (true) {
+		int fd = accept(server->listen_fd, NULL, NULL);
+		if (fd < 0) return;
+		set_nonblocking(fd);
+		Connection* conn = calloc(1, sizeof(Connection));
+		conn->fd = fd;
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = conn;
+		epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+	}
+}
+
+/*	Function: read_requests
+*	-----------------------
+*	Reads everything available on the connection, handling the complete frames after each
+*	read, so that the input buffer never holds more than one partial frame and a chunk.  At
+*	end of stream the frames already read are still answered: the connection stops reading
+*	and is closed by flush_output once the last response is sent, or here if none is due.
+*	Closes the connection at once on errors, and at end of stream if it had already been
+*	reached.
+*/
+void read_requests(Server* server, Connection* conn) {
+	while (!conn->closed) {
+		if (conn->in_cap - conn->n_in < READ_CHUNK) {
+			conn->in_cap = conn->n_in + 2 * READ_CHUNK;
+			conn->in = realloc(conn->in, conn->in_cap);
+		}
+		ssize_t n_read = read(conn->fd, conn->in + conn->n_in, conn->in_cap - conn->n_in);
+		if (n_read > 0) {
+			conn->n_in += n_read;
+			parse_frames(server, conn);
+			continue;
+		}
+		if (n_read < 0 && errno == EINTR) continue;
+		if (n_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+		if (n_read < 0 || conn->read_closed) {
+			close_connection(server, conn);
+			return;
+		}
+		conn->read_closed = true;  // end of stream; a partial frame is never answered
+		if (!conn->n_pending && !conn->n_out) close_connection(server, conn);
+		else watch_connection(server, conn);
+		return;
+	}
+}
+
+/*	Function: parse_frames
+*	----------------------
+*	Handles each complete frame in the input buffer and keeps any partial frame for next
+*	time.  Closes the connection on frames longer than MAX_FRAME_LENGTH.
+*/
+void parse_frames(Server* server, Connection* conn) {
+	size_t parsed = 0;
+	while (!conn->closed && conn->n_in - parsed >= FRAME_HEADER_LENGTH) {
+		uint32_t length = get_u32(conn->in + parsed);
+		if (length > MAX_FRAME_LENGTH) {
+			close_connection(server, conn);
+			return;
+		}
+		if (conn->n_in - parsed < FRAME_HEADER_LENGTH + length) break;
+		handle_request(server, conn, conn->in + parsed + FRAME_HEADER_LENGTH, length);
+		parsed += FRAME_HEADER_LENGTH + length;
+	}
+	memmove(conn->in, conn->in + parsed, conn->n_in - parsed);
+	conn->n_in -= parsed;
+}
+
+/*	Function: handle_request
+*	------------------------
+*	Decodes one request payload into a Job and submits it to the worker pool.  A named request
+*	becomes a Job for the plain op with the model name attached.  Malformed requests, and
+*	generate requests for more than MAX_REQUEST_WORDS words, whose search would recurse too
+*	deep for a worker's stack, are answered immediately with STATUS_BAD_REQUEST.
+*/
+void handle_request(Server* server, Connection* conn, unsigned char* payload, uint32_t length) {
+	uint32_t id = length >= 5 ? get_u32(payload + 1) : 0;
+	bool named = length > REQUEST_HEADER_LENGTH && (payload[0] == OP_GENERATE_NAMED || payload[0] == OP_SCORE_NAMED);
+	uint32_t body = REQUEST_HEADER_LENGTH;
+	if (named) body += 1 + payload[REQUEST_HEADER_LENGTH];
+	uint8_t op = payload[0] == OP_GENERATE_NAMED ? OP_GENERATE : payload[0] == OP_SCORE_NAMED ? OP_SCORE : payload[0];
+	bool valid = length >= body && (!named || body > REQUEST_HEADER_LENGTH + 1)
+		&& ((op == OP_GENERATE && length == body + 2 && get_u16(payload + body) <= MAX_REQUEST_WORDS) || op == OP_SCORE);
+	if (!valid) {
+		uint32_t response_length;
+		unsigned char* response = build_response(STATUS_BAD_REQUEST, id, NULL, 0, &response_length);
+		queue_response(server, conn, response, response_length);
+		return;
+	}
+	Job* job = calloc(1, sizeof(Job));
+	job->server = server;
+	job->conn = conn;
+	job->op = op;
+	job->id = id;
+	job->model = get_u16(payload + 5);
+	if (named) job->name = strndup((char*)payload + REQUEST_HEADER_LENGTH + 1, payload[REQUEST_HEADER_LENGTH]);
+	if (job->op == OP_GENERATE) job->n_words = get_u16(payload + body);
+	else {
+		job->sentence = malloc(length - body + 1);
+		memcpy(job->sentence, payload + body, length - body);
+		job->sentence[length - body] = '\0';
+	}
+	conn->n_pending++;
+	if (server->batch_window && job->op == OP_GENERATE && !named && job->model < server->n_models) add_to_batch(server, job);
+	else submit_task(server->pool, run_job, job);
+}
+
+/*	Function: run_job
+*	-----------------
+*	Runs on a worker thread.  Finds the model, acquiring it from the registry for a named
+*	request, generates or scores the sentence, builds the response frame, and hands the job
+*	back to the event loop.
+*/
+void run_job(void* job_ptr) {
+	Job* job = job_ptr;
+	Server* server = job->server;
+	Model* model = NULL;
+	if (job->name) model = server->registry ? acquire_model(server->registry, job->name) : NULL;
+	else if (job->model < server->n_models) model = server->models[job->model];
+	if (!model) {
+		job->response = build_response(STATUS_NO_MODEL, job->id, NULL, 0, &job->response_length);
+	} else if (job->op == OP_GENERATE) {
+		char* sentence = generate_sentence_portfolio(model, job->n_words, server->n_searches);
+		if (sentence) {
+			job->response = build_response(STATUS_OK, job->id, sentence, strlen(sentence), &job->response_length);
+			free(sentence);
+		} else job->response = build_response(STATUS_NO_SENTENCE, job->id, NULL, 0, &job->response_length);
+	} else {
+		double score = score_sentence(model, job->sentence);
+		uint64_t bits;
+		memcpy(&bits, &score, sizeof(bits));
+		unsigned char body[8];
+		put_u64(body, bits);
+		job->response = build_response(STATUS_OK, job->id, body, sizeof(body), &job->response_length);
+	}
+	if (job->name && model) release_model(server->registry, job->name);
+	job->next = NULL;
+	finish_jobs(server, job, job);
+}
+
+/*	Function: add_to_batch
+*	----------------------
+*	Adds a generate job to the open batch for its model and length, opening one if needed.
+*	A batch that reaches MAX_BATCH jobs is run straight away.
+*/
+void add_to_batch(Server* server, Job* job) {
+	Batch* batch = server->batches;
+	while (batch && (batch->model != job->model || batch->n_words != job->n_words)) batch = batch->next;
+	if (!batch) {
+		batch = calloc(1, sizeof(Batch));
+		batch->model = job->model;
+		batch->n_words = job->n_words;
+		batch->deadline = monotonic_now() + server->batch_window;
+		if (server->last_batch) server->last_batch->next = batch;
+		else server->batches = batch;
+		server->last_batch = batch;
+		if (server->batches == batch) arm_batch_timer(server);
+	}
+	job->next = NULL;
+	if (batch->last_job) batch->last_job->next = job;
+	else batch->first_job = job;
+	batch->last_job = job;
+	if (++batch->n_jobs == MAX_BATCH) {
+		remove_batch(server, batch);
+		submit_task(server->pool, run_batch, batch);
+	}
+}
+
+/*	Function: close_due_batches
+*	---------------------------
+*	Runs on the timer.  Submits every batch whose window has passed.
+*/
+void close_due_batches(Server* server) {
+	uint64_t expirations;
+	ssize_t ignored = read(server->timer_fd, &expirations, sizeof(expirations));
+	(void)ignored;
+	long long now = monotonic_now();
+	while (server->batches && server->batches->deadline <= now) {
+		Batch* batch = server->batches;
+		remove_batch(server, batch);
+		submit_task(server->pool, run_batch, batch);
+	}
+}
+
+/*	Function: remove_batch
+*	----------------------
+*	Unlinks a batch from the open list, re-arming the timer if it was the first.
+*/
+void remove_batch(Server* server, Batch* batch) {
+	Batch** link = &server->batches;
+	Batch* previous = NULL;
+	while (*link != batch) {
+		previous = *link;
+		link = &(*link)->next;
+	}
+	*link = batch->next;
+	if (server->last_batch == batch) server->last_batch = previous;
+	batch->next = NULL;
+	if (!previous) arm_batch_timer(server);
+}
+
+/*	Function: arm_batch_timer
+*	-------------------------
+*	Sets the timer to the first open batch's deadline, or disarms it if none is open.
+*/
+void arm_batch_timer(Server* server) {
+	struct itimerspec timer;
+	memset(&timer, 0, sizeof(timer));
+	if (server->batches) {
+		timer.it_value.tv_sec = server->batches->deadline / 1000000000;
+		timer.it_value.tv_nsec = server->batches->deadline % 1000000000;
+	}
+	timerfd_settime(server->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/*	Function: run_batch
+*	-------------------
+*	Runs on a worker thread.  Generates one sentence per job in a single
+*	generate_sentences_from call on the batch's reachable table, then answers every job of
+*	the batch.
+*/
+void run_batch(void* batch_ptr) {
+	Batch* batch = batch_ptr;
+	Server* server = batch->first_job->server;
+	char* sentences[batch->n_jobs];
+	ReachableTable* table = batch_table(server, batch);
+	int n_made = generate_sentences_from(server->models[batch->model], batch->n_words, table->reachable, batch->n_jobs, sentences);
+	release_table(server, table);
+	int i = 0;
+	for (Job* job = batch->first_job; job; job = job->next, i++) {
+		if (n_made) {
+			job->response = build_response(STATUS_OK, job->id, sentences[i], strlen(sentences[i]), &job->response_length);
+			free(sentences[i]);
+		} else job->response = build_response(STATUS_NO_SENTENCE, job->id, NULL, 0, &job->response_length);
+	}
+	finish_jobs(server, batch->first_job, batch->last_job);
+	free(batch);
+}
+
+/*	Function: batch_table
+*	---------------------
+*	Returns the reachable table for the batch's model and length, in use by the batch until
+*	release_table, making it on the first batch that needs it.  The table is made outside the
+*	lock, so batches of other lengths go on meanwhile; if another worker made the same table
+*	first, that one is used.  A new table is kept at the front of the list, evicting the least
+*	recently used tables that no batch is walking while the kept tables are over
+*	REACHABLE_BUDGET_MB.  A table larger than the whole budget is made for its batch alone.
+*/
+ReachableTable* batch_table(Server* server, Batch* batch) {
+	pthread_mutex_lock(&server->tables_lock);
+	ReachableTable* table = take_table(server, batch);
+	pthread_mutex_unlock(&server->tables_lock);
+	if (table) return table;
+	Model* model = server->models[batch->model];
+	uint64_t* reachable = find_reachable(model, batch->n_words);
+	pthread_mutex_lock(&server->tables_lock);
+	table = take_table(server, batch);
+	if (table) free(reachable);
+	else {
+		table = malloc(sizeof(ReachableTable));
+		table->model = batch->model;
+		table->n_words = batch->n_words;
+		table->reachable = reachable;
+		table->size = reachable_size(model, batch->n_words);
+		table->n_users = 1;
+		table->kept = table->size <= (size_t)REACHABLE_BUDGET_MB << 20;
+		table->next = NULL;
+		if (table->kept) {
+			table->next = server->tables;
+			server->tables = table;
+			server->table_bytes += table->size;
+			evict_tables(server);
+		}
+	}
+	pthread_mutex_unlock(&server->tables_lock);
+	return table;
+}
+
+/*	Function: take_table
+*	--------------------
+*	Called with the tables lock held.  Returns the kept table for the batch's model and
+*	length, moved to the front of the list and counted as in use, or NULL if there is none.
+*/
+ReachableTable* take_table(Server* server, Batch* batch) {
+	for (ReachableTable** link = &server->tables; *link; link = &(*link)->next) {
+		ReachableTable* table = *link;
+		if (table->model != batch->model || table->n_words != batch->n_words) continue;
+		*link = table->next;
+		table->next = server->tables;
+		server->tables = table;
+		table->n_users++;
+		return table;
+	}
+	return NULL;
+}
+
+/*	Function: release_table
+*	-----------------------
+*	Ends a batch's use of its table.  A table made for one batch is freed; a kept table may
+*	now be evicted, if it was only kept over budget because it was in use.
+*/
+void release_table(Server* server, ReachableTable* table) {
+	bool kept = table->kept;  // the table itself may be evicted
+	pthread_mutex_lock(&server->tables_lock);
+	table->n_users--;
+	if (kept) evict_tables(server);
+	pthread_mutex_unlock(&server->tables_lock);
+	if (!kept) {
+		free(table->reachable);
+		free(table);
+	}
+}
+
+/*	Function: evict_tables
+*	----------------------
+*	Called with the tables lock held.  While the kept tables exceed REACHABLE_BUDGET_MB,
+*	frees the least recently used table that no batch is walking.
+*/
+void evict_tables(Server* server) {
+	while (server->table_bytes > (size_t)REACHABLE_BUDGET_MB << 20) {
+		ReachableTable** victim = NULL;
+		for (ReachableTable** link = &server->tables; *link; link = &(*link)->next) {
+			if (!(*link)->n_users) victim = link;
+		}
+		if (!victim) return;
+		ReachableTable* table = *victim;
+		*victim = table->next;
+		server->table_bytes -= table->size;
+		free(table->reachable);
+		free(table);
+	}
+}
+
+/*	Function: finish_jobs
+*	---------------------
+*	Appends a chain of answered jobs to the server's finished list, writing to the wake-up
+*	pipe if the list was empty (the event loop drains the whole list on each wake-up).
+*/
+void finish_jobs(Server* server, Job* first, Job* last) {
+	pthread_mutex_lock(&server->done_lock);
+	bool was_empty = !server->done_head;
+	if (server->done_tail) server->done_tail->next = first;
+	else server->done_head = first;
+	server->done_tail = last;
+	pthread_mutex_unlock(&server->done_lock);
+	if (was_empty) {
+		ssize_t ignored = write(server->wake_fds[1], "", 1);
+		(void)ignored;  // a full pipe already guarantees a wake-up
+	}
+}
+
+/*	Function: monotonic_now
+*	-----------------------
+*	Returns the CLOCK_MONOTONIC time in nanoseconds.
+*/
+long long monotonic_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*	Function: send_finished_jobs
+*	----------------------------
+*	Drains the wake-up pipe, takes the whole finished list, and queues each response on its
+*	connection.
+*/
+void send_finished_jobs(Server* server) {
+	char drain[256];
+	while (read(server->wake_fds[0], drain, sizeof(drain)) > 0);
+	pthread_mutex_lock(&server->done_lock);
+	Job* job = server->done_head;
+	server->done_head = server->done_tail = NULL;
+	pthread_mutex_unlock(&server->done_lock);
+	while (job) {
+		Job* next = job->next;
+		Connection* conn = job->conn;
+		conn->n_pending--;
+		queue_response(server, conn, job->response, job->response_length);
+		free(job->sentence);
+		free(job->name);
+		free(job);
+		job = next;
+	}
+}
+
+/*	Function: queue_response
+*	------------------------
+*	Appends a response frame to the connection's output, frees the frame, and tries to send.
+*	Responses for closed connections are dropped.
+*/
+void queue_response(Server* server, Connection* conn, unsigned char* frame, uint32_t length) {
+	if (conn->closed) {
+		free(frame);
+		return;
+	}
+	if (conn->out_cap - conn->n_out < length) {
+		memmove(conn->out, conn->out + conn->out_start, conn->n_out - conn->out_start);
+		conn->n_out -= conn->out_start;
+		conn->out_start = 0;
+		if (conn->out_cap - conn->n_out < length) {
+			conn->out_cap = 2 * (conn->n_out + length);
+			conn->out = realloc(conn->out, conn->out_cap);
+		}
+	}
+	memcpy(conn->out + conn->n_out, frame, length);
+	conn->n_out += length;
+	free(frame);
+	flush_output(server, conn);
+}
+
+/*	Function: build_response
+*	------------------------
+*	Returns a heap-allocated response frame with the given status, id and body, storing its
+*	total length in length.
+*/
+unsigned char* build_response(uint8_t status, uint32_t id, const void* body, uint32_t body_length, uint32_t* length) {
+	*length = FRAME_HEADER_LENGTH + RESPONSE_HEADER_LENGTH + body_length;
+	unsigned char* frame = malloc(*length);
+	put_u32(frame, RESPONSE_HEADER_LENGTH + body_length);
+	frame[FRAME_HEADER_LENGTH] = status;
+	put_u32(frame + FRAME_HEADER_LENGTH + 1, id);
+	if (body_length) memcpy(frame + FRAME_HEADER_LENGTH + RESPONSE_HEADER_LENGTH, body, body_length);
+	return frame;
+}
+
+/*	Function: flush_output
+*	----------------------
+*	Writes as much pending output as the socket accepts, and registers for EPOLLOUT exactly
+*	while some output remains.  Closes a connection whose client has stopped sending once
+*	nothing is left to answer or send.
+*/
+void flush_output(Server* server, Connection* conn) {
+	while (conn->out_start < conn->n_out) {
+		ssize_t written = write(conn->fd, conn->out + conn->out_start, conn->n_out - conn->out_start);
+		if (written < 0 && errno == EINTR) continue;
+		if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		if (written <= 0) {
+			close_connection(server, conn);
+			return;
+		}
+		conn->out_start += written;
+	}
+	if (conn->out_start == conn->n_out) conn->out_start = conn->n_out = 0;
+	if (conn->read_closed && !conn->n_pending && !conn->n_out) {
+		close_connection(server, conn);
+		return;
+	}
+	bool want_write = conn->n_out > 0;
+	if (want_write != conn->want_write) {
+		conn->want_write = want_write;
+		watch_connection(server, conn);
+	}
+}
+
+/*	Function: watch_connection
+*	--------------------------
+*	Registers the connection for the events it is waiting for: EPOLLIN until the client has
+*	stopped sending, and EPOLLOUT while output remains.
+*/
+void watch_connection(Server* server, Connection* conn) {
+	struct epoll_event event;
+	event.events = (conn->read_closed ? 0 : EPOLLIN) | (conn->want_write ? EPOLLOUT : 0);
+	event.data.ptr = conn;
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+/*	Function: close_connection
+*	--------------------------
+*	Stops watching and closes the socket, and puts the connection on the closed list for
+*	free_closed_connections.
+*/
+void close_connection(Server* server, Connection* conn) {
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	conn->closed = true;
+	conn->next_closed = server->closed;
+	server->closed = conn;
+}
+
+/*	Function: free_closed_connections
+*	---------------------------------
+*	Frees every closed connection that has no requests running, keeping the rest listed.
+*/
+void free_closed_connections(Server* server) {
+	Connection** link = &server->closed;
+	while (*link) {
+		Connection* conn = *link;
+		if (conn->n_pending) {
+			link = &conn->next_closed;
+			continue;
+		}
+		*link = conn->next_closed;
+		free(conn->in);
+		free(conn->out);
+		free(conn);
+	}
+}
+
+/*	Function: set_nonblocking
+*	-------------------------
+*	Adds O_NONBLOCK to the descriptor's flags.
+*/
+void set_nonblocking(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/*	Function: handle_stop_signal
+*	----------------------------
+*	Asks the event loop to stop.
+*/
+void handle_stop_signal(int signal_number) {
+	stopping = 1;
+}
@@ -0,0 +1,496 @@
+/*  sketch.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: bounded-memory frequency counting for streamed text.  A Count-Min
+*   sketch gives an upper-bound count for any key in constant space, and a
+*   Space-Saving summary keeps exact slots for the keys that matter most.
+*   -------------------------
+*   Design choices & notes:
+*    - The Count-Min sketch uses conservative update (only the minimal counters
+*      are raised), which keeps estimates for rare keys much tighter than the
+*      plain update at no extra cost.
+*    - Classic Space-Saving replaces the minimum entry on every unmonitored key,
+*      which churns the summary with one-off words.  Here an unmonitored key
+*      only replaces the minimum once its Count-Min estimate exceeds the
+*      minimum's count, and it enters with that estimate.  Both are upper
+*      bounds on the true count, so the Space-Saving guarantee still holds.
+*    - Monitored entries live in flat arrays; a min-heap over their counts
+*      finds the eviction victim and an open-addressed index finds a key's
+*      entry, so every update is O(log capacity).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sketch.h"
+
+#define CMS_DEPTH 4
+#define MIN_CMS_WIDTH 64
+#define MIN_HH_CAPACITY 16
+
+/*  Struct: CountMinSketch
+*   ----------------------
+*   depth rows of width counters, stored row after row.
+*/
+struct CountMinSketch {
+    int width;
+    int depth;
+    unsigned int* counters;
+};
+
+/*  Struct: HeavyHitters
+*   --------------------
+*   The monitored entries are stored in parallel arrays indexed by entry number.
+*   heap holds entry numbers ordered by count and heap_pos is its inverse;
+*   index holds entry numbers (or -1) by key hash, with linear probing.
+*/
+struct HeavyHitters {
+    CountMinSketch* cms;
+    int key_size;  // bytes reserved per key, including the terminating '\0'
+    int capacity;
+    int n;  // number of entries in use
+    char* keys;
+    unsigned int* counts;
+    int n_tallies;  // extra counters kept per entry
+    unsigned int* tallies;  // n_tallies per entry, entry-major
+    uint32_t* hashes;
+    int* heap;
+    int* heap_pos;
+    int* index;
+    uint32_t index_mask;  // index size - 1; the size is a power of two
+};
+
+/*  Struct: RankedEntry
+*   -------------------
+*   Entry number paired with its count, for sorting.
+*/
+typedef struct RankedEntry {
+    unsigned int count;
+    int entry;
+} RankedEntry;
+
+
+//  -------Function prototypes-------
+int cms_column(CountMinSketch* cms, uint64_t hash, int row);
+size_t fit_entries(size_t bytes, size_t entry_bytes, uint32_t* index_size);
+char* entry_key(HeavyHitters* hh, int entry);
+void heap_swap(HeavyHitters* hh, int a, int b);
+void heap_sift_down(HeavyHitters* hh, int pos);
+void heap_sift_up(HeavyHitters* hh, int pos);
+int index_lookup(HeavyHitters* hh, const char* key, uint32_t hash);
+void index_insert(HeavyHitters* hh, int entry);
+void index_remove(HeavyHitters* hh, int entry);
+int compare_ranked_entries(const void* a, const void* b);
+//  ---------------------------------
+
+
+/*  Function: hash_key
+*   ------------------
+*   64-bit FNV-1a hash of key, finished with a multiply-xorshift so that both
+*   halves are usable as independent hashes.
+*/
+uint64_t hash_key(const char* key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)key; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/*  Function: cms_column
+*   --------------------
+*   Returns the counter of the given row that hash maps to, using double hashing
+*   on the two halves of the hash instead of one hash function per row.
+*/
+int cms_column(CountMinSketch* cms, uint64_t hash, int row) {
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    return (h1 + (uint32_t)row * h2) % (uint32_t)cms->width;
+}
+
+/*  Function: cms_create
+*   --------------------
+*   Allocates a zeroed sketch with the requested dimensions.
+*/
+CountMinSketch* cms_create(int width, int depth) {
+    CountMinSketch* cms = malloc(sizeof(CountMinSketch));
+    cms->width = width;
+    cms->depth = depth;
+    cms->counters = calloc((size_t)width * depth, sizeof(unsigned int));
+    if (!cms->counters) {
+        printf("Could not allocate sketch of %d x %d counters.\n", width, depth);
+        exit(1);
+    }
+    return cms;
+}
+
+/*  Function: cms_create_for_budget
+*   -------------------------------
+*   Sizes the rows so that the counters fit in memory_budget bytes.
+*/
+CountMinSketch* cms_create_for_budget(size_t memory_budget) {
+    size_t width = memory_budget / (CMS_DEPTH * sizeof(unsigned int));
+    if (width < MIN_CMS_WIDTH) width = MIN_CMS_WIDTH;
+    return cms_create((int)width, CMS_DEPTH);
+}
+
+/*  Function: cms_add
+*   -----------------
+*   Conservative update: finds the current estimate, then raises only those
+*   counters that are below estimate + amount.
+*/
+unsigned int cms_add(CountMinSketch* cms, const char* key, unsigned int amount) {
+    uint64_t hash = hash_key(key);
+    unsigned int estimate = cms_estimate(cms, key) + amount;
+    for (int row = 0; row < cms->depth; row++) {
+        unsigned int* counter = cms->counters + (size_t)row * cms->width + cms_column(cms, hash, row);
+        if (*counter < estimate) *counter = estimate;
+    }
+    return estimate;
+}
+
+/*  Function: cms_estimate
+*   ----------------------
+*   Returns the smallest counter that key maps to.
+*/
+unsigned int cms_estimate(CountMinSketch* cms, const char* key) {
+    uint64_t hash = hash_key(key);
+    unsigned int estimate = (unsigned int)-1;
+    for (int row = 0; row < cms->depth; row++) {
+        unsigned int counter = cms->counters[(size_t)row * cms->width + cms_column(cms, hash, row)];
+        if (counter < estimate) estimate = counter;
+    }
+    return estimate;
+}
+
+/*  Function: cms_memory
+*   --------------------
+*   Returns the size of the sketch in bytes.
+*/
+size_t cms_memory(CountMinSketch* cms) {
+    return sizeof(CountMinSketch) + (size_t)cms->width * cms->depth * sizeof(unsigned int);
+}
+
+/*  Function: cms_free
+*   ------------------
+*   Frees the counters and the sketch.
+*/
+void cms_free(CountMinSketch* cms) {
+    free(cms->counters);
+    free(cms);
+}
+
+/*  Function: hh_create
+*   -------------------
+*   Gives a third of the budget to the admission sketch and the rest, less the two
+*   structs, to the monitored entries and their index, as sized by fit_entries.
+*/
+HeavyHitters* hh_create(size_t memory_budget, int key_size, int n_tallies) {
+    if (memory_budget / 3 < MIN_CMS_WIDTH * CMS_DEPTH * sizeof(unsigned int)) return NULL;
+    CountMinSketch* cms = cms_create_for_budget(memory_budget / 3);
+    size_t entry_bytes = key_size + sizeof(unsigned int) + sizeof(uint32_t) + 2 * sizeof(int)
+        + n_tallies * sizeof(unsigned int);
+    uint32_t index_size;
+    size_t capacity = fit_entries(memory_budget - cms_memory(cms) - sizeof(HeavyHitters), entry_bytes, &index_size);
+    if (capacity < MIN_HH_CAPACITY) {
+        cms_free(cms);
+        return NULL;
+    }
+    HeavyHitters* hh = malloc(sizeof(HeavyHitters));
+    hh->cms = cms;
+    hh->key_size = key_size;
+    hh->capacity = (int)capacity;
+    hh->n = 0;
+    hh->keys = malloc(capacity * key_size);
+    hh->counts = malloc(capacity * sizeof(unsigned int));
+    hh->n_tallies = n_tallies;
+    hh->tallies = n_tallies ? malloc(capacity * n_tallies * sizeof(unsigned int)) : NULL;
+    hh->hashes = malloc(capacity * sizeof(uint32_t));
+    hh->heap = malloc(capacity * sizeof(int));
+    hh->heap_pos = malloc(capacity * sizeof(int));
+    hh->index = malloc(index_size * sizeof(int));
+    for (uint32_t i = 0; i < index_size; i++) hh->index[i] = -1;
+    hh->index_mask = index_size - 1;
+    return hh;
+}
+
+/*  Function: fit_entries
+*   ---------------------
+*   Returns how many entries of entry_bytes fit in bytes together with their index, storing
+*   the index size.  The index is a power of two at least twice the capacity, so the
+*   capacity is tried both with the smallest index that a naive two slots per entry would
+*   round up to, filled as far as the remaining bytes allow, and with the index half that
+*   size, filled to half; the larger capacity wins.
+*/
+size_t fit_entries(size_t bytes, size_t entry_bytes, uint32_t* index_size) {
+    size_t naive = bytes / (entry_bytes + 2 * sizeof(int));
+    uint32_t large = 2;
+    while (large < 2 * naive) large <<= 1;
+    size_t capacity = 0;
+    *index_size = large;
+    for (uint32_t size = large; size >= 2 && size >= large / 2; size >>= 1) {
+        if (size * sizeof(int) >= bytes) continue;
+        size_t fitting = (bytes - size * sizeof(int)) / entry_bytes;
+        if (fitting > size / 2) fitting = size / 2;
+        if (fitting > capacity) {
+            capacity = fitting;
+            *index_size = size;
+        }
+    }
+    return capacity;
+}
+
+/*  Function: entry_key
+*   -------------------
+*   Returns the key storage of the given entry.
+*/
+char* entry_key(HeavyHitters* hh, int entry) {
+    return hh->keys + (size_t)entry * hh->key_size;
+}
+
+/*  Function: hh_add
+*   ----------------
+*   Counts key in the sketch, then either bumps its entry, gives it a free
+*   entry, or lets it take over the minimum entry if its estimate is larger.
+*   A taken-over entry starts with zeroed tallies.  Keys too long for the
+*   summary are only counted in the sketch.
+*/
+int hh_add(HeavyHitters* hh, const char* key) {
+    unsigned int estimate = cms_add(hh->cms, key, 1);
+    if ((int)strlen(key) >= hh->key_size) return -1;
+    uint32_t hash = (uint32_t)hash_key(key);
+    int entry = index_lookup(hh, key, hash);
+    if (entry >= 0) {
+        hh->counts[entry]++;
+        heap_sift_down(hh, hh->heap_pos[entry]);
+        return entry;
+    }
+    if (hh->n < hh->capacity) {
+        entry = hh->n++;
+        hh->heap[entry] = entry;
+        hh->heap_pos[entry] = entry;
+    } else {
+        entry = hh->heap[0];
+        if (estimate <= hh->counts[entry]) return -1;
+        index_remove(hh, entry);
+    }
+    strcpy(entry_key(hh, entry), key);
+    hh->hashes[entry] = hash;
+    hh->counts[entry] = estimate;
+    if (hh->n_tallies) memset(hh->tallies + (size_t)entry * hh->n_tallies, 0, hh->n_tallies * sizeof(unsigned int));
+    index_insert(hh, entry);
+    heap_sift_up(hh, hh->heap_pos[entry]);
+    heap_sift_down(hh, hh->heap_pos[entry]);
+    return entry;
+}
+
+/*  Function: hh_tally
+*   ------------------
+*   Adds one to the given tally of an entry returned by hh_add.
+*/
+void hh_tally(HeavyHitters* hh, int entry, int tally) {
+    hh->tallies[(size_t)entry * hh->n_tallies + tally]++;
+}
+
+/*  Function: hh_size / hh_capacity / hh_key / hh_count
+*   ---------------------------------------------------
+*   Accessors for the monitored entries.
+*/
+int hh_size(HeavyHitters* hh) {
+    return hh->n;
+}
+
+int hh_capacity(HeavyHitters* hh) {
+    return hh->capacity;
+}
+
+const char* hh_key(HeavyHitters* hh, int index) {
+    return entry_key(hh, index);
+}
+
+unsigned int hh_count(HeavyHitters* hh, int index) {
+    return hh->counts[index];
+}
+
+unsigned int hh_tally_count(HeavyHitters* hh, int index, int tally) {
+    return hh->tallies[(size_t)index * hh->n_tallies + tally];
+}
+
+/*  Function: hh_find
+*   -----------------
+*   Looks key up in the entry index.
+*/
+int hh_find(HeavyHitters* hh, const char* key) {
+    return index_lookup(hh, key, (uint32_t)hash_key(key));
+}
+
+/*  Function: hh_sort
+*   -----------------
+*   Sorts the entries by descending count, then rebuilds the heap and the index
+*   for the new entry numbering.  The reversed order is ascending by count, so
+*   it is already a valid min-heap.
+*/
+void hh_sort(HeavyHitters* hh) {
+    int n = hh->n;
+    if (n <= 0) return;
+    RankedEntry* ranked = malloc((size_t)n * sizeof(RankedEntry));
+    for (int i = 0; i < n; i++) {
+        ranked[i].count = hh->counts[i];
+        ranked[i].entry = i;
+    }
+    qsort(ranked, n, sizeof(RankedEntry), compare_ranked_entries);
+    char* keys = malloc((size_t)n * hh->key_size);
+    uint32_t* hashes = malloc((size_t)n * sizeof(uint32_t));
+    size_t tally_bytes = hh->n_tallies * sizeof(unsigned int);
+    unsigned int* tallies = hh->n_tallies ? malloc((size_t)n * tally_bytes) : NULL;
+    for (int i = 0; i < n; i++) {
+        memcpy(keys + (size_t)i * hh->key_size, entry_key(hh, ranked[i].entry), hh->key_size);
+        hashes[i] = hh->hashes[ranked[i].entry];
+        if (tallies) memcpy(tallies + (size_t)i * hh->n_tallies, hh->tallies + (size_t)ranked[i].entry * hh->n_tallies, tally_bytes);
+        hh->counts[i] = ranked[i].count;
+    }
+    memcpy(hh->keys, keys, (size_t)n * hh->key_size);
+    memcpy(hh->hashes, hashes, n * sizeof(uint32_t));
+    if (tallies) memcpy(hh->tallies, tallies, (size_t)n * tally_bytes);
+    free(keys);
+    free(hashes);
+    free(tallies);
+    free(ranked);
+    for (uint32_t i = 0; i <= hh->index_mask; i++) hh->index[i] = -1;
+    for (int i = 0; i < n; i++) {
+        hh->heap[i] = n - 1 - i;
+        hh->heap_pos[n - 1 - i] = i;
+        index_insert(hh, i);
+    }
+}
+
+/*  Function: compare_ranked_entries
+*   --------------------------------
+*   qsort comparator ordering entries by descending count.
+*/
+int compare_ranked_entries(const void* a, const void* b) {
+    unsigned int count_a = ((const RankedEntry*)a)->count;
+    unsigned int count_b = ((const RankedEntry*)b)->count;
+    return (count_a < count_b) - (count_a > count_b);
+}
+
+/*  Function: hh_memory
+*   -------------------
+*   Returns the bytes held by the sketch, the entry arrays and the index.
+*/
+size_t hh_memory(HeavyHitters* hh) {
+    size_t entry_bytes = hh->key_size + sizeof(unsigned int) + sizeof(uint32_t) + 2 * sizeof(int)
+        + hh->n_tallies * sizeof(unsigned int);
+    return sizeof(HeavyHitters) + cms_memory(hh->cms) + (size_t)hh->capacity * entry_bytes
+        + ((size_t)hh->index_mask + 1) * sizeof(int);
+}
+
+/*  Function: hh_free
+*   -----------------
+*   Frees every array, the sketch and the summary.
+*/
+void hh_free(HeavyHitters* hh) {
+    cms_free(hh->cms);
+    free(hh->keys);
+    free(hh->counts);
+    free(hh->tallies);
+    free(hh->hashes);
+    free(hh->heap);
+    free(hh->heap_pos);
+    free(hh->index);
+    free(hh);
+}
+
+/*  Function: heap_swap
+*   -------------------
+*   Swaps two heap positions and updates the inverse mapping.
+*/
+void heap_swap(HeavyHitters* hh, int a, int b) {
+    int entry_a = hh->heap[a];
+    hh->heap[a] = hh->heap[b];
+    hh->heap[b] = entry_a;
+    hh->heap_pos[hh->heap[a]] = a;
+    hh->heap_pos[hh->heap[b]] = b;
+}
+
+/*  Function: heap_sift_down
+*   ------------------------
+*   Moves the entry at pos down until both children have counts at least as
+*   large.  Called after an entry's count grows.
+*/
+void heap_sift_down(HeavyHitters* hh, int pos) {
+    while (true) {
+        int smallest = pos;
+        int left = 2 * pos + 1, right = 2 * pos + 2;
+        if (left < hh->n && hh->counts[hh->heap[left]] < hh->counts[hh->heap[smallest]]) smallest = left;
+        if (right < hh->n && hh->counts[hh->heap[right]] < hh->counts[hh->heap[smallest]]) smallest = right;
+        if (smallest == pos) return;
+        heap_swap(hh, pos, smallest);
+        pos = smallest;
+    }
+}
+
+/*  Function: heap_sift_up
+*   ----------------------
+*   Moves the entry at pos up while its parent has a larger count.
+*/
+void heap_sift_up(HeavyHitters* hh, int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (hh->counts[hh->heap[parent]] <= hh->counts[hh->heap[pos]]) return;
+        heap_swap(hh, pos, parent);
+        pos = parent;
+    }
+}
+
+/*  Function: index_lookup
+*   ----------------------
+*   Probes from the key's home slot until it finds the key or an empty slot.
+*/
+int index_lookup(HeavyHitters* hh, const char* key, uint32_t hash) {
+    for (uint32_t slot = hash & hh->index_mask; hh->index[slot] >= 0; slot = (slot + 1) & hh->index_mask) {
+        int entry = hh->index[slot];
+        if (hh->hashes[entry] == hash && !strcmp(entry_key(hh, entry), key)) return entry;
+    }
+    return -1;
+}
+
+/*  Function: index_insert
+*   ----------------------
+*   Places entry in the first empty slot at or after its home slot.
+*/
+void index_insert(HeavyHitters* hh, int entry) {
+    uint32_t slot = hh->hashes[entry] & hh->index_mask;
+    while (hh->index[slot] >= 0) slot = (slot + 1) & hh->index_mask;
+    hh->index[slot] = entry;
+}
+
+/*  Function: index_remove
+*   ----------------------
+*   Removes entry from the index with backward-shift deletion, so lookups never
+*   need tombstones: later entries of the same probe run are moved into the gap
+*   whenever their home slot does not lie between the gap and their position.
+*/
+void index_remove(HeavyHitters* hh, int entry) {
+    uint32_t gap = hh->hashes[entry] & hh->index_mask;
+    while (hh->index[gap] != entry) gap = (gap + 1) & hh->index_mask;
+    uint32_t slot = gap;
+    while (true) {
+        slot = (slot + 1) & hh->index_mask;
+        int moved = hh->index[slot];
+        if (moved < 0) break;
+        uint32_t home = hh->hashes[moved] & hh->index_mask;
+        if (((slot - home) & hh->index_mask) >= ((slot - gap) & hh->index_mask)) {
+            hh->index[gap] = moved;
+            gap = slot;
+        }
+    }
+    hh->index[gap] = -1;
+}
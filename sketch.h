@@ -0,0 +1,138 @@
+/*  sketch.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Fixed-size frequency summaries used to build models from streams too large
+*   to count exactly.  Keys are NUL-terminated strings (a word, or two words
+*   joined by a space for a bigram).
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Struct: CountMinSketch
+*   ----------------------
+*   Count-Min sketch with conservative update.  Estimates never undercount, and
+*   overcount by at most (total added) * e / width with high probability.
+*/
+typedef struct CountMinSketch CountMinSketch;
+
+/*  Struct: HeavyHitters
+*   --------------------
+*   Space-Saving summary of the most frequent keys, fronted by a Count-Min
+*   sketch that decides whether an unmonitored key has earned a slot.  Each
+*   entry can also carry a few tallies of its own, such as how often the key
+*   was seen in some role; these only count occurrences while it is monitored.
+*/
+typedef struct HeavyHitters HeavyHitters;
+
+/*  Function: hash_key
+*   ------------------
+*   Returns a well-mixed 64-bit hash of key.  Also used for the model's word index.
+*/
+uint64_t hash_key(const char* key);
+
+/*  Function: cms_create
+*   --------------------
+*   Creates a sketch with depth rows of width counters each.
+*/
+CountMinSketch* cms_create(int width, int depth);
+
+/*  Function: cms_create_for_budget
+*   -------------------------------
+*   Creates a sketch of the default depth using at most memory_budget bytes.
+*/
+CountMinSketch* cms_create_for_budget(size_t memory_budget);
+
+/*  Function: cms_add
+*   -----------------
+*   Adds amount occurrences of key and returns the new estimate for key.
+*/
+unsigned int cms_add(CountMinSketch* cms, const char* key, unsigned int amount);
+
+/*  Function: cms_estimate
+*   ----------------------
+*   Returns an upper bound on the number of times key has been added.
+*/
+unsigned int cms_estimate(CountMinSketch* cms, const char* key);
+
+/*  Function: cms_memory
+*   --------------------
+*   Returns the number of bytes held by the sketch.
+*/
+size_t cms_memory(CountMinSketch* cms);
+
+/*  Function: cms_free
+*   ------------------
+*   Frees the sketch.
+*/
+void cms_free(CountMinSketch* cms);
+
+/*  Function: hh_create
+*   -------------------
+*   Creates a heavy-hitter summary for keys of at most key_size - 1 characters,
+*   with n_tallies extra counters per entry, splitting memory_budget between the
+*   sketch and the monitored entries.  Returns NULL if the budget cannot hold
+*   even a minimal summary.
+*/
+HeavyHitters* hh_create(size_t memory_budget, int key_size, int n_tallies);
+
+/*  Function: hh_add
+*   ----------------
+*   Records one occurrence of key.  Returns the key's entry, valid until the
+*   next hh_add or hh_sort, or -1 if the key is not monitored.
+*/
+int hh_add(HeavyHitters* hh, const char* key);
+
+/*  Function: hh_tally
+*   ------------------
+*   Adds one to tally number tally of the entry returned by hh_add.
+*/
+void hh_tally(HeavyHitters* hh, int entry, int tally);
+
+/*  Function: hh_size
+*   -----------------
+*   Returns the number of keys currently monitored.
+*/
+int hh_size(HeavyHitters* hh);
+
+/*  Function: hh_capacity
+*   ---------------------
+*   Returns the maximum number of keys the summary can monitor.
+*/
+int hh_capacity(HeavyHitters* hh);
+
+/*  Function: hh_key / hh_count / hh_tally_count
+*   ---------------------------------------------
+*   Return the key, estimated count and given tally of the index-th monitored
+*   entry.  The order is arbitrary unless hh_sort has been called since the
+*   last hh_add.
+*/
+const char* hh_key(HeavyHitters* hh, int index);
+unsigned int hh_count(HeavyHitters* hh, int index);
+unsigned int hh_tally_count(HeavyHitters* hh, int index, int tally);
+
+/*  Function: hh_find
+*   -----------------
+*   Returns the index of the monitored entry for key, or -1 if key is not
+*   currently monitored.
+*/
+int hh_find(HeavyHitters* hh, const char* key);
+
+/*  Function: hh_sort
+*   -----------------
+*   Orders the monitored entries by descending count.
+*/
+void hh_sort(HeavyHitters* hh);
+
+/*  Function: hh_memory
+*   -------------------
+*   Returns the number of bytes held by the summary and its sketch.
+*/
+size_t hh_memory(HeavyHitters* hh);
+
+/*  Function: hh_free
+*   -----------------
+*   Frees the summary and its sketch.
+*/
+void hh_free(HeavyHitters* hh);
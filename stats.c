@@ -0,0 +1,229 @@
+/*  stats.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: measures a model: its vocabulary, links and fan-out, the strongly
+*   connected components of its successor graph and the words that cannot reach
+*   a sentence ender, and the memory held by each of its structures.
+*   -------------------------
+*   Design choices & notes:
+*    - Everything is found in time linear in the words and links, so the tool
+*      can be run on the largest models; the components in particular are found
+*      with an iterative Tarjan search rather than a recursive one.
+*    - The stats are computed from the model's own arrays and never build
+*      anything for generating, so measuring a model does not change its
+*      memory use.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "stats.h"
+
+
+//  -------Function prototypes-------
+void measure_components(Model* model, ModelStats* stats);
+void measure_memory(Model* model, ModelStats* stats);
+//  ---------------------------------
+
+
+/*  Function: model_memory
+*   ----------------------
+*   Sums the structures measured by measure_memory.  Holds the model's view lock meanwhile,
+*   so that a view or replica being built by another thread is counted whole or not at all.
+*/
+size_t model_memory(Model* model) {
+    ModelStats stats;
+    pthread_mutex_lock(&model->view_lock);
+    measure_memory(model, &stats);
+    pthread_mutex_unlock(&model->view_lock);
+    return stats.memory_total;
+}
+
+/*  Function: compute_model_stats
+*   -----------------------------
+*   Counts words, tokens, links, starts and enders in one pass over the words, finding each
+*   word's distinct successors with a table stamped by the word's index, so no table needs
+*   clearing.  The fan-out percentiles come from a histogram of those counts, then
+*   measure_components and measure_memory fill in the rest.
+*/
+void compute_model_stats(Model* model, ModelStats* stats) {
+    memset(stats, 0, sizeof(ModelStats));
+    int* stamps = malloc((model->n_w + 1) * sizeof(int));
+    int* histogram = calloc(model->n_w + 1, sizeof(int));  // words by number of distinct successors
+    for (int i = 0; i < model->n_w; i++) stamps[i] = -1;
+    for (int i = 0; i < model->n_w; i++) {
+        Word* word = model->words + i;
+        if (!word->string) continue;  // removed from a live model
+        stats->n_words++;
+        stats->n_tokens += word->n_occurrences;
+        stats->n_links += word->n_nw;
+        if (word->is_sentence_ender) stats->n_enders++;
+        else if (!word->n_nw) stats->n_dead_ends++;
+        int fan_out = 0;
+        for (int j = 0; j < word->n_nw; j++) {
+            int next_word = word->next_words[j];
+            if (stamps[next_word] != i) {
+                stamps[next_word] = i;
+                fan_out++;
+            }
+        }
+        stats->n_edges += fan_out;
+        histogram[fan_out]++;
+        if (fan_out > stats->max_fan_out) stats->max_fan_out = fan_out;
+    }
+    stats->n_starts = model->n_ssw;
+    for (int i = 0; i < model->n_ssw; i++) {
+        int word = model->sentence_starting_words[i];
+        if (stamps[word] != model->n_w) {
+            stamps[word] = model->n_w;
+            stats->n_starters++;
+        }
+    }
+    long n_below = 0;  // words with fewer distinct successors than fan_out
+    bool p50_found = false;
+    for (int fan_out = 0; fan_out <= stats->max_fan_out; fan_out++) {
+        n_below += histogram[fan_out];
+        if (!p50_found && 2 * n_below >= stats->n_words) {
+            stats->p50_fan_out = fan_out;
+            p50_found = true;
+        }
+        if (100 * n_below >= 99L * stats->n_words) {
+            stats->p99_fan_out = fan_out;
+            break;
+        }
+    }
+    free(histogram);
+    free(stamps);
+    measure_components(model, stats);
+    measure_memory(model, stats);
+}
+
+/*  Function: measure_components
+*   ----------------------------
+*   Finds the strongly connected components of the successor graph with Tarjan's algorithm,
+*   run iteratively: each frame of an explicit stack holds a word and how far through its
+*   next_words the search has got, so deep chains cannot overflow the call stack.  A word
+*   roots a component when no word below it on the stack reaches anything found earlier.
+*   A component is only finished after every component it reaches, so whether its words can
+*   reach a sentence ender is known as it is finished, which counts the pruned words without
+*   building the generation view.
+*/
+void measure_components(Model* model, ModelStats* stats) {
+    int n_w = model->n_w;
+    int* found = malloc((n_w + 1) * sizeof(int));  // order of discovery, -1 if not yet found
+    int* lowest = malloc((n_w + 1) * sizeof(int));  // earliest word on the stack reachable
+    bool* on_stack = calloc(n_w + 1, sizeof(bool));
+    int* stack = malloc((n_w + 1) * sizeof(int));  // words found but not yet in a component
+    int* frames = malloc((n_w + 1) * sizeof(int));  // words being searched
+    int* positions = malloc((n_w + 1) * sizeof(int));  // next link to follow for each frame
+    bool* viable = calloc(n_w + 1, sizeof(bool));  // if a finished word can reach a sentence ender
+    for (int i = 0; i < n_w; i++) found[i] = -1;
+    int n_found = 0, n_stack = 0;
+    for (int root = 0; root < n_w; root++) {
+        if (!model->words[root].string || found[root] >= 0) continue;
+        int n_frames = 0;
+        int word = root;
+        while (true) {
+            if (word >= 0) {  // first visit
+                found[word] = lowest[word] = n_found++;
+                stack[n_stack++] = word;
+                on_stack[word] = true;
+                frames[n_frames] = word;
+                positions[n_frames++] = 0;
+            }
+            int current = frames[n_frames - 1];
+            Word* current_word = model->words + current;
+            word = -1;
+            if (positions[n_frames - 1] < current_word->n_nw) {
+                int next_word = current_word->next_words[positions[n_frames - 1]++];
+                if (found[next_word] < 0) word = next_word;
+                else if (on_stack[next_word] && found[next_word] < lowest[current]) {
+                    lowest[current] = found[next_word];
+                }
+                continue;
+            }
+            if (lowest[current] == found[current]) {  // current roots a component
+                int size = 0;
+                int member;
+                do {
+                    member = stack[--n_stack];
+                    on_stack[member] = false;
+                    size++;
+                } while (member != current);
+                bool reaches_ender = false;
+                for (int i = n_stack; i < n_stack + size && !reaches_ender; i++) {
+                    Word* member_word = model->words + stack[i];
+                    reaches_ender = member_word->is_sentence_ender;
+                    for (int j = 0; j < member_word->n_nw && !reaches_ender; j++) {
+                        reaches_ender = viable[member_word->next_words[j]];
+                    }
+                }
+                for (int i = n_stack; i < n_stack + size; i++) viable[stack[i]] = reaches_ender;
+                if (!reaches_ender) stats->n_pruned += size;
+                stats->n_components++;
+                if (size == 1) stats->n_singleton_components++;
+                if (size > stats->largest_component) stats->largest_component = size;
+            }
+            if (--n_frames == 0) break;
+            int parent = frames[n_frames - 1];
+            if (lowest[current] < lowest[parent]) lowest[parent] = lowest[current];
+        }
+    }
+    free(viable);
+    free(positions);
+    free(frames);
+    free(stack);
+    free(on_stack);
+    free(lowest);
+    free(found);
+}
+
+/*  Function: measure_memory
+*   ------------------------
+*   Fills in the memory fields of stats, one per structure the model holds.  Strings and
+*   successor arrays that lie in a mapped model file count towards the mapping only.
+*/
+void measure_memory(Model* model, ModelStats* stats) {
+    stats->memory_words = sizeof(Model) + model->words_cap * sizeof(Word);
+    stats->memory_strings = 0;
+    stats->memory_links = 0;
+    for (int i = 0; i < model->words_cap; i++) {
+        stats->memory_links += model->words[i].nw_cap * sizeof(int);
+        if (!model->mapping && i < model->n_w && model->words[i].string) {
+            stats->memory_strings += strlen(model->words[i].string) + 1;
+        }
+    }
+    stats->memory_starts = model->ssw_cap * sizeof(int);
+    stats->memory_index = (model->index_mask + 1) * sizeof(int);
+    stats->memory_mapping = model->mapping_size;
+    stats->memory_stream = 0;
+    StreamState* stream = model->stream;
+    if (stream) {
+        stats->memory_stream = sizeof(StreamState) + hh_memory(stream->word_counts) + hh_memory(stream->bigram_counts);
+    }
+    stats->memory_view = model->view ? model->view->memory : 0;
+    stats->memory_live = 0;
+    LiveState* live = model->live;
+    if (live) {
+        stats->memory_live = sizeof(LiveState) + live->current_cap * sizeof(int) + live->window * sizeof(int*);
+        for (int i = 0; i < MAX_WORDS_IN_MODEL; i++) {
+            stats->memory_live += live->words[i].links_cap * (sizeof(int) + sizeof(double));
+        }
+        for (int i = 0; i < live->n_ring; i++) {
+            int* sentence = live->ring[(live->ring_start + i) % live->window];
+            for (int j = 0; sentence[j] >= 0; j++) stats->memory_live += sizeof(int);
+            stats->memory_live += sizeof(int);
+        }
+    }
+    stats->memory_total = stats->memory_words + stats->memory_strings + stats->memory_links + stats->memory_starts;
+    stats->memory_total += stats->memory_index + stats->memory_mapping + stats->memory_stream + stats->memory_live;
+    stats->memory_total += stats->memory_view;
+}
@@ -0,0 +1,56 @@
+/*  stats.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Measurements of a model's shape and memory use, for the model_stats tool
+*   and for the registry's memory budget.  Include model.h and stddef.h first.
+*/
+
+/*  Function: model_memory
+*   ----------------------
+*   Returns the number of bytes the model occupies, including all of its
+*   mapped file if it was loaded with load_model, and its generation view and
+*   view replicas as built so far.  Safe to call while other threads generate.
+*/
+size_t model_memory(Model* model);
+
+/*  Struct: ModelStats
+*   ------------------
+*   Summary of a model filled in by compute_model_stats.  Fan-out is the
+*   number of distinct words that followed a word; the percentiles are over
+*   all words.  Components are the strongly connected components of the
+*   graph in which each word points at its successors.
+*/
+typedef struct ModelStats {
+    int n_words;  // vocabulary size
+    long n_tokens;  // word occurrences ingested
+    long n_links;  // successor entries, one per bigram occurrence
+    long n_edges;  // distinct bigrams
+    int max_fan_out;
+    int p50_fan_out;
+    int p99_fan_out;
+    int n_dead_ends;  // words with no successors that do not end sentences
+    int n_pruned;  // words from which no sentence ender can be reached
+    int n_starters;  // distinct words that start sentences
+    int n_starts;  // sentence starts, one per occurrence
+    int n_enders;  // words that end sentences
+    int n_components;
+    int largest_component;  // in words
+    int n_singleton_components;
+    size_t memory_words;  // the model and its Word array
+    size_t memory_strings;
+    size_t memory_links;  // next_words arrays
+    size_t memory_starts;  // sentence_starting_words array
+    size_t memory_index;  // hash table from strings to words
+    size_t memory_mapping;  // mapped model file
+    size_t memory_stream;  // sketches of a streaming model
+    size_t memory_live;  // counts and window of a live model
+    size_t memory_view;  // pruned lists used by generate_sentence
+    size_t memory_total;  // as returned by model_memory
+} ModelStats;
+
+/*  Function: compute_model_stats
+*   -----------------------------
+*   Fills in stats for the model, in time linear in its words and links.
+*/
+void compute_model_stats(Model* model, ModelStats* stats);
@@ -0,0 +1,540 @@
+/*  test_model.c
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+#include <poll.h>
+#include "model.h"
+#include "sketch.h"
+#include "cache.h"
+#include "model_internal.h"
+#include "enumerator.h"
+#include "async.h"
+#include "stats.h"
+
+#define TEST_SEED 42
+#define SEEDED_SENTENCES 500  // sentences in each seeded batch compared
+#define MAX_TEST_THREADS 7
+#define MAX_ENUMERATED 200000  // sentences of a length above which the enumeration checks are skipped
+#define RESUME_STEP 7  // sentences enumerated between saving and loading the cursor
+#define N_RANGES 5  // ranges the enumeration is split into
+#define N_CHUNKS 8  // pieces the text is ingested in when checking the generation view
+#define EXACT_SENTENCES 200  // sentences drawn by generate_sentences_exact for each length
+#define N_CACHE_LENGTHS 32  // lengths that fill every slot of a sentence cache
+#define CACHE_WAIT_MS 5000  // longest wait for a turned-away length to be cached
+#define MIN_STREAM_BUDGET 8192  // smallest sketch budget checked; larger ones double up to 1 << 24
+#define N_ASYNC 48  // generations submitted by each asynchronous check
+#define ASYNC_LENGTH 400  // words in each, so that searches last long enough to be cancelled
+#define ASYNC_WAIT_MS 10000  // longest wait for the submitted generations to finish
+
+/*	Struct: SentenceList
+*	--------------------
+*	Copies of the sentences passed to collect_sentence, in order.
+*/
+typedef struct SentenceList {
+	char** sentences;
+	long n;
+	long cap;
+} SentenceList;
+
+/*	Struct: AsyncResult
+*	-------------------
+*	What one asynchronous generation delivered.
+*/
+typedef struct AsyncResult {
+	Generation* generation;
+	char* sentence;
+	int n_finished;  // atomic, times the generation has finished
+	bool cancelled;
+} AsyncResult;
+
+int n_failed = 0;
+
+//  -------Function prototypes-------
+char* read_text(const char* filename, long* size);
+Model* model_from(char* text, long size);
+void check(bool passed, const char* what);
+void check_seeded_batches(Model* model, int length);
+bool same_batch(char* first[], char* second[], int n);
+void check_enumeration(Model* model, int length);
+bool collect_sentence(const char* sentence, void* arg);
+bool same_lists(SentenceList* first, SentenceList* second);
+void free_list(SentenceList* list);
+void check_incremental_view(char* text, long size);
+void check_stream_budgets(char* text, long size);
+bool same_view(Model* model, GenerationView* kept, GenerationView* fresh);
+bool same_entries(int first[], int n_first, int second[], int n_second);
+void check_cache_reclaim(Model* model);
+void check_exact_sampling(Model* model, int length);
+bool valid_sentence(Model* model, const char* sentence, int length);
+void check_async_callbacks(Model* model);
+void record_generation(Generation* generation, char* sentence, void* arg);
+void check_async_queue(Model* model);
+void submit_and_cancel(AsyncResult results[], int i);
+bool expected_results(Model* model, AsyncResult results[]);
+//  ---------------------------------
+
+/*	Function: main
+*	--------------
+*	Invocation: test_model [filename]
+*	Builds a model from the text (input.txt by default) and checks that:
+*	 - seeded batches come out the same on any number of threads, with the vector kernels
+*	   or the scalar ones, and when made in ranges of indices;
+*	 - the enumerator lists as many sentences as it counts, and the same ones in the same
+*	   order when its cursor is saved and loaded every few sentences, or split into ranges;
+*	 - sentences drawn in proportion to their probability are ones the model can make, of
+*	   the length asked for, and none are drawn for a length with no sentences;
+*	 - a streaming model's sketches stay within its memory budget, for budgets from a few
+*	   kilobytes up;
+*	 - the generation view kept up to date as text is ingested in pieces matches one built
+*	   from scratch after every piece;
+*	 - a sentence cache whose slots all went to lengths no longer asked for makes room for
+*	   a new length;
+*	 - asynchronous generations, some cancelled before or during their search, each finish
+*	   exactly once, through their callback or completion queue, and the queue's descriptor
+*	   stops polling readable once it has been drained.
+*	Prints one line per check, and exits with status 1 if any failed.
+*/
+int main(int argc, char* argv[]) {
+	if (argc > 2) {
+		printf("Please invoke as: test_model [filename]\n");
+		exit(1);
+	}
+	long size;
+	char* text = read_text(argc == 2 ? argv[1] : "input.txt", &size);
+	Model* model = model_from(text, size);
+	check_seeded_batches(model, 4);
+	check_seeded_batches(model, 8);
+	for (int length = 3; length <= 6; length++) check_enumeration(model, length);
+	check_exact_sampling(model, 4);
+	check_exact_sampling(model, 8);
+	check_cache_reclaim(model);
+	check_async_callbacks(model);
+	check_async_queue(model);
+	free_allocated(model);
+	check_incremental_view(text, size);
+	check_stream_budgets(text, size);
+	free(text);
+	if (n_failed) {
+		printf("%d check(s) failed.\n", n_failed);
+		exit(1);
+	}
+	printf("All checks passed.\n");
+	return 0;
+}
+
+/*	Function: read_text
+*	-------------------
+*	Returns the whole file, heap-allocated, storing its size in size.
+*/
+char* read_text(const char* filename, long* size) {
+	FILE* file = fopen(filename, "r");
+	if (!file) {
+		printf("File %s could not be opened.\n", filename);
+		exit(1);
+	}
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	char* text = malloc(*size + 1);
+	if (*size < 1 || fread(text, 1, *size, file) != (size_t)*size) {
+		printf("File %s could not be read.\n", filename);
+		exit(1);
+	}
+	fclose(file);
+	return text;
+}
+
+/*	Function: model_from
+*	--------------------
+*	Creates a model from size bytes of text in memory.
+*/
+Model* model_from(char* text, long size) {
+	FILE* stream = fmemopen(text, size, "r");
+	Model* model = create_model(stream);
+	fclose(stream);
+	return model;
+}
+
+/*	Function: check
+*	---------------
+*	Prints the outcome of one check, and counts it if it failed.
+*/
+void check(bool passed, const char* what) {
+	printf("%s: %s\n", passed ? "ok" : "FAILED", what);
+	if (!passed) n_failed++;
+}
+
+/*	Function: check_seeded_batches
+*	------------------------------
+*	Makes a seeded batch with the scalar kernels on one thread, then compares with it the
+*	batches made by either kernel on 1, 3, 5 and 7 threads, and a batch of its second half
+*	made from the index it starts at.
+*/
+void check_seeded_batches(Model* model, int length) {
+	char* reference[SEEDED_SENTENCES];
+	char* batch[SEEDED_SENTENCES];
+	char what[128];
+	use_vector_kernels = false;
+	int n = generate_sentences_seeded(model, length, TEST_SEED, 0, SEEDED_SENTENCES, reference, 1);
+	for (int vector = 0; vector <= 1; vector++) {
+		use_vector_kernels = vector;
+		for (int n_threads = 1; n_threads <= MAX_TEST_THREADS; n_threads += 2) {
+			int n_made = generate_sentences_seeded(model, length, TEST_SEED, 0, SEEDED_SENTENCES, batch, n_threads);
+			snprintf(what, sizeof(what), "seeded %d-word batch, %s kernels, %d thread(s)", length, vector ? "vector" : "scalar", n_threads);
+			check(n_made == n && same_batch(reference, batch, n_made), what);
+			for (int i = 0; i < n_made; i++) free(batch[i]);
+		}
+	}
+	int half = n / 2;
+	int n_made = generate_sentences_seeded(model, length, TEST_SEED, half, n - half, batch, 3);
+	snprintf(what, sizeof(what), "seeded %d-word batch from index %d", length, half);
+	check(n_made == n - half && same_batch(reference + half, batch, n_made), what);
+	for (int i = 0; i < n_made; i++) free(batch[i]);
+	for (int i = 0; i < n; i++) free(reference[i]);
+}
+
+/*	Function: same_batch
+*	--------------------
+*	Returns true if the two batches of n sentences are identical.
+*/
+bool same_batch(char* first[], char* second[], int n) {
+	for (int i = 0; i < n; i++) {
+		if (strcmp(first[i], second[i])) return false;
+	}
+	return true;
+}
+
+/*	Function: check_enumeration
+*	---------------------------
+*	Lists every sentence of the length in one pass, then again through a cursor saved and
+*	loaded every RESUME_STEP sentences, and again through N_RANGES split ranges, and checks
+*	that the listings are the same and as long as the count.  Skipped for lengths with more
+*	than MAX_ENUMERATED sentences.
+*/
+void check_enumeration(Model* model, int length) {
+	Enumerator* enumerator = create_enumerator(model, length);
+	uint64_t count = count_sentences(enumerator);
+	char what[128];
+	if (count > MAX_ENUMERATED) {
+		printf("skipped: enumeration of the %llu %d-word sentences\n", (unsigned long long)count, length);
+		free_enumerator(enumerator);
+		return;
+	}
+	SentenceList all = {NULL, 0, 0};
+	EnumerationCursor* cursor = start_enumeration(enumerator);
+	enumerate_sentences(cursor, 0, collect_sentence, &all);
+	snprintf(what, sizeof(what), "enumeration of %d-word sentences lists the %llu counted", length, (unsigned long long)count);
+	check(enumeration_finished(cursor) && all.n == (long)count, what);
+	free_cursor(cursor);
+
+	SentenceList resumed = {NULL, 0, 0};
+	cursor = start_enumeration(enumerator);
+	while (cursor && !enumeration_finished(cursor)) {
+		if (!enumerate_sentences(cursor, RESUME_STEP, collect_sentence, &resumed)) break;
+		char* saved = save_cursor(cursor);
+		free_cursor(cursor);
+		cursor = load_cursor(enumerator, saved);
+		free(saved);
+	}
+	snprintf(what, sizeof(what), "enumeration of %d-word sentences resumed every %d", length, RESUME_STEP);
+	check(cursor && enumeration_finished(cursor) && same_lists(&all, &resumed), what);
+	if (cursor) free_cursor(cursor);
+
+	SentenceList split = {NULL, 0, 0};
+	EnumerationCursor* cursors[N_RANGES];
+	split_enumeration(enumerator, N_RANGES, cursors);
+	for (int i = 0; i < N_RANGES; i++) {
+		enumerate_sentences(cursors[i], 0, collect_sentence, &split);
+		free_cursor(cursors[i]);
+	}
+	snprintf(what, sizeof(what), "enumeration of %d-word sentences split into %d ranges", length, N_RANGES);
+	check(same_lists(&all, &split), what);
+	free_list(&all);
+	free_list(&resumed);
+	free_list(&split);
+	free_enumerator(enumerator);
+}
+
+/*	Function: collect_sentence
+*	--------------------------
+*	SentenceVisitor that appends a copy of the sentence to the SentenceList.
+*/
+bool collect_sentence(const char* sentence, void* arg) {
+	SentenceList* list = arg;
+	if (list->n == list->cap) {
+		list->cap = 2 * list->cap + 16;
+		list->sentences = realloc(list->sentences, list->cap * sizeof(char*));
+	}
+	list->sentences[list->n++] = strdup(sentence);
+	return true;
+}
+
+/*	Function: same_lists
+*	--------------------
+*	Returns true if the two lists hold the same sentences in the same order.
+*/
+bool same_lists(SentenceList* first, SentenceList* second) {
+	return first->n == second->n && same_batch(first->sentences, second->sentences, first->n);
+}
+
+/*	Function: free_list
+*	-------------------
+*	Frees the list's sentences and array.
+*/
+void free_list(SentenceList* list) {
+	for (long i = 0; i < list->n; i++) free(list->sentences[i]);
+	free(list->sentences);
+}
+
+/*	Function: check_incremental_view
+*	--------------------------------
+*	Creates a model from the first of N_CHUNKS pieces of the text, cut at spaces, and builds
+*	its generation view, then ingests the other pieces one at a time, comparing the view
+*	ingest_text kept up to date with a fresh build_generation_view after each.
+*/
+void check_incremental_view(char* text, long size) {
+	long ends[N_CHUNKS];
+	for (int i = 0; i < N_CHUNKS; i++) {
+		long end = size * (i + 1) / N_CHUNKS;
+		while (end < size && text[end] != ' ') end++;
+		ends[i] = end;
+	}
+	Model* model = model_from(text, ends[0]);
+	get_generation_view(model);
+	bool same = true;
+	for (int i = 1; i < N_CHUNKS; i++) {
+		if (ends[i] == ends[i - 1]) continue;
+		FILE* stream = fmemopen(text + ends[i - 1], ends[i] - ends[i - 1], "r");
+		ingest_text(model, stream);
+		fclose(stream);
+		GenerationView* fresh = build_generation_view(model);
+		same = same && same_view(model, get_generation_view(model), fresh);
+		free_generation_view(fresh);
+	}
+	char what[128];
+	snprintf(what, sizeof(what), "generation view updated through %d ingests", N_CHUNKS - 1);
+	check(same, what);
+	free_allocated(model);
+}
+
+/*	Function: check_stream_budgets
+*	------------------------------
+*	Builds a streaming model from the text for each budget from MIN_STREAM_BUDGET up to
+*	16 MB, doubling, and checks that the memory its sketches hold never exceeds the budget.
+*/
+void check_stream_budgets(char* text, long size) {
+	size_t over = 0;
+	for (size_t budget = MIN_STREAM_BUDGET; budget <= 1 << 24 && !over; budget *= 2) {
+		Model* model = create_streaming_model(budget);
+		FILE* stream = fmemopen(text, size, "r");
+		ingest_text(model, stream);
+		fclose(stream);
+		ModelStats stats;
+		compute_model_stats(model, &stats);
+		if (stats.memory_stream > budget) over = budget;
+		free_allocated(model);
+	}
+	char what[128];
+	if (over) snprintf(what, sizeof(what), "streaming sketches stay within a memory budget of %zu bytes", over);
+	else snprintf(what, sizeof(what), "streaming sketches stay within their memory budget");
+	check(!over, what);
+}
+
+/*	Function: same_view
+*	-------------------
+*	Returns true if the two views of the model prune the same words and hold the same
+*	entries in each list, in any order.
+*/
+bool same_view(Model* model, GenerationView* kept, GenerationView* fresh) {
+	if (kept->n_pruned != fresh->n_pruned) return false;
+	if (!same_entries(kept->starts, kept->n_starts, fresh->starts, fresh->n_starts)) return false;
+	for (int w = 0; w < model->n_w; w++) {
+		if (kept->viable[w] != fresh->viable[w]) return false;
+		if (!same_entries(kept->next[w], kept->n_next[w], fresh->next[w], fresh->n_next[w])) return false;
+		if (!same_entries(kept->prev[w], kept->n_prev[w], fresh->prev[w], fresh->n_prev[w])) return false;
+	}
+	return true;
+}
+
+/*	Function: same_entries
+*	----------------------
+*	Returns true if the two lists hold the same entries, in any order.
+*/
+bool same_entries(int first[], int n_first, int second[], int n_second) {
+	if (n_first != n_second) return false;
+	if (!n_first) return true;
+	int* sorted = malloc(2 * n_first * sizeof(int));
+	memcpy(sorted, first, n_first * sizeof(int));
+	memcpy(sorted + n_first, second, n_second * sizeof(int));
+	qsort(sorted, n_first, sizeof(int), compare_ints);
+	qsort(sorted + n_first, n_second, sizeof(int), compare_ints);
+	bool same = !memcmp(sorted, sorted + n_first, n_first * sizeof(int));
+	free(sorted);
+	return same;
+}
+
+/*	Function: check_cache_reclaim
+*	-----------------------------
+*	Asks a sentence cache once for each of N_CACHE_LENGTHS lengths, which claims every slot,
+*	then keeps asking for one more length until the cache answers it, which it can only do
+*	once an idle slot has been reclaimed.  Gives up after CACHE_WAIT_MS.
+*/
+void check_cache_reclaim(Model* model) {
+	SentenceCache* cache = create_sentence_cache(model, 64);
+	char* sentence;
+	for (int length = 1; length <= N_CACHE_LENGTHS; length++) {
+		if (take_cached_sentence(cache, length, &sentence)) free(sentence);
+	}
+	bool answered = false;
+	for (int waited = 0; !answered && waited < CACHE_WAIT_MS; waited++) {
+		answered = take_cached_sentence(cache, N_CACHE_LENGTHS + 1, &sentence);
+		if (answered) free(sentence);
+		else usleep(1000);
+	}
+	char what[128];
+	snprintf(what, sizeof(what), "sentence cache reclaims a slot for length %d", N_CACHE_LENGTHS + 1);
+	check(answered, what);
+	free_sentence_cache(cache);
+}
+
+/*	Function: check_exact_sampling
+*	------------------------------
+*	Draws EXACT_SENTENCES sentences of the length with generate_sentences_exact and checks
+*	that each is valid, then checks that a model of two-word sentences gives none of one
+*	more word.
+*/
+void check_exact_sampling(Model* model, int length) {
+	char* sentences[EXACT_SENTENCES];
+	int n_made = generate_sentences_exact(model, length, EXACT_SENTENCES, sentences);
+	bool valid = n_made == EXACT_SENTENCES;
+	for (int i = 0; i < n_made; i++) {
+		valid = valid && valid_sentence(model, sentences[i], length);
+		free(sentences[i]);
+	}
+	char what[128];
+	snprintf(what, sizeof(what), "exact sampling makes valid %d-word sentences", length);
+	check(valid, what);
+	char text[] = "Hello world. Goodbye world.";
+	Model* pairs = model_from(text, strlen(text));
+	snprintf(what, sizeof(what), "exact sampling makes no %d-word sentence from two-word sentences", length);
+	check(generate_sentences_exact(pairs, length, EXACT_SENTENCES, sentences) == 0, what);
+	free_allocated(pairs);
+}
+
+/*	Function: valid_sentence
+*	------------------------
+*	Returns true if the sentence has the given number of words and the model can produce it.
+*/
+bool valid_sentence(Model* model, const char* sentence, int length) {
+	int n_words = 0;
+	for (const char* c = sentence; *c; c++) {
+		if (*c != ' ' && (c == sentence || c[-1] == ' ')) n_words++;
+	}
+	return n_words == length && score_sentence(model, sentence) > -INFINITY;
+}
+
+/*	Function: check_async_callbacks
+*	-------------------------------
+*	Submits N_ASYNC generations with callbacks, cancelling some of them, and waits up to
+*	ASYNC_WAIT_MS for every callback before checking what each delivered.
+*/
+void check_async_callbacks(Model* model) {
+	AsyncResult results[N_ASYNC] = {{0}};
+	for (int i = 0; i < N_ASYNC; i++) {
+		results[i].generation = generate_sentence_async(model, ASYNC_LENGTH, record_generation, &results[i]);
+		submit_and_cancel(results, i);
+	}
+	for (int i = 0, waited = 0; i < N_ASYNC && waited < ASYNC_WAIT_MS; ) {
+		if (__atomic_load_n(&results[i].n_finished, __ATOMIC_ACQUIRE)) i++;
+		else {
+			usleep(1000);
+			waited++;
+		}
+	}
+	check(expected_results(model, results), "asynchronous generations finish once through their callbacks");
+}
+
+/*	Function: record_generation
+*	---------------------------
+*	Callback that stores the sentence in the AsyncResult passed as arg.
+*/
+void record_generation(Generation* generation, char* sentence, void* arg) {
+	(void)generation;
+	AsyncResult* result = arg;
+	result->sentence = sentence;
+	__atomic_add_fetch(&result->n_finished, 1, __ATOMIC_RELEASE);
+}
+
+/*	Function: check_async_queue
+*	---------------------------
+*	Submits N_ASYNC generations to a completion queue, cancelling some of them, and drains
+*	the queue whenever its descriptor polls readable until every generation has come out or
+*	ASYNC_WAIT_MS has passed.  Then checks what each delivered, and that the drained queue's
+*	descriptor no longer polls readable.
+*/
+void check_async_queue(Model* model) {
+	AsyncResult results[N_ASYNC] = {{0}};
+	CompletionQueue* queue = create_completion_queue();
+	for (int i = 0; i < N_ASYNC; i++) {
+		results[i].generation = generate_sentence_queued(model, ASYNC_LENGTH, queue, &results[i]);
+		submit_and_cancel(results, i);
+	}
+	struct pollfd ready = {.fd = completion_queue_fd(queue), .events = POLLIN};
+	int n_taken = 0;
+	for (int waited = 0; n_taken < N_ASYNC && waited < ASYNC_WAIT_MS; waited++) {
+		if (poll(&ready, 1, 1) < 1) continue;
+		char* sentence;
+		void* tag;
+		while (take_completion(queue, &sentence, &tag)) {
+			AsyncResult* result = tag;
+			result->sentence = sentence;
+			result->n_finished++;
+			n_taken++;
+		}
+	}
+	check(expected_results(model, results), "asynchronous generations finish once through a completion queue");
+	check(poll(&ready, 1, 0) == 0, "a drained completion queue does not poll readable");
+	free_completion_queue(queue);
+}
+
+/*	Function: submit_and_cancel
+*	---------------------------
+*	Called just after generation i was submitted.  Every third one is cancelled at once,
+*	usually before it starts; every third after a short wait, usually in the middle of its
+*	search; and the rest are left alone.  Releases the caller's reference either way.
+*/
+void submit_and_cancel(AsyncResult results[], int i) {
+	AsyncResult* result = &results[i];
+	if (i % 3 == 1) usleep(100);
+	if (i % 3 != 2) cancel_generation(result->generation);
+	result->cancelled = generation_cancelled(result->generation);
+	release_generation(result->generation);
+}
+
+/*	Function: expected_results
+*	--------------------------
+*	Returns true if every generation finished exactly once, the ones left alone with a
+*	valid sentence and the cancelled ones with either a valid sentence or none.  Frees the
+*	sentences.
+*/
+bool expected_results(Model* model, AsyncResult results[]) {
+	bool expected = true;
+	for (int i = 0; i < N_ASYNC; i++) {
+		AsyncResult* result = &results[i];
+		if (__atomic_load_n(&result->n_finished, __ATOMIC_ACQUIRE) != 1) expected = false;
+		else if (result->cancelled != (i % 3 != 2)) expected = false;
+		else if (result->sentence) expected = expected && valid_sentence(model, result->sentence, ASYNC_LENGTH);
+		else expected = expected && result->cancelled;
+		free(result->sentence);
+	}
+	return expected;
+}
@@ -0,0 +1,159 @@
+/*  workers.c
+*   2015, Cody M Leff
+*   for Argo coding challenge - Semantic Analysis
+*   -------------------------
+*   Summary: a fixed set of threads sharing one FIFO queue of tasks, guarded by a
+*   mutex, with a condition variable to wake idle workers.
+*   -------------------------
+*   Design choices & notes:
+*    - Tasks are kept in a singly linked list so that submission never has to
+*      grow an array or block.  Each queued task costs one small allocation,
+*      which is negligible next to generating a sentence.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "workers.h"
+
+/*  Struct: QueuedTask
+*   ------------------
+*   A submitted task waiting for a worker.
+*/
+typedef struct QueuedTask {
+    Task task;
+    void* arg;
+    struct QueuedTask* next;
+} QueuedTask;
+
+/*  Struct: WorkerPoolImplementation
+*   --------------------------------
+*   The worker threads and the queue of tasks they take from.
+*/
+struct WorkerPoolImplementation {
+    int n_threads;
+    pthread_t* threads;
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready;
+    QueuedTask* head;  // next task to run
+    QueuedTask* tail;  // last task submitted
+    bool stopping;  // set once the pool is being freed
+};
+
+static WorkerPool* library_pool = NULL;
+static pthread_once_t library_pool_once = PTHREAD_ONCE_INIT;
+
+
+//  -------Function prototypes-------
+void start_library_pool();
+void* run_worker(void* pool_ptr);
+//  ---------------------------------
+
+
+/*  Function: create_worker_pool
+*   ----------------------------
+*   Initializes the queue and starts the threads.
+*/
+WorkerPool* create_worker_pool(int n_threads) {
+    if (n_threads <= 0) n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads <= 0) n_threads = 1;
+    WorkerPool* pool = malloc(sizeof(WorkerPool));
+    pool->n_threads = n_threads;
+    pool->threads = malloc(n_threads * sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_ready, NULL);
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->stopping = false;
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_create(pool->threads + i, NULL, run_worker, pool)) {
+            printf("Could not start worker thread.\n");
+            exit(1);
+        }
+    }
+    return pool;
+}
+
+/*  Function: library_worker_pool
+*   -----------------------------
+*   Starts the shared pool the first time any thread asks for it.
+*/
+WorkerPool* library_worker_pool() {
+    pthread_once(&library_pool_once, start_library_pool);
+    return library_pool;
+}
+
+/*  Function: start_library_pool
+*   ----------------------------
+*   Starts the shared pool, with one thread per processor.
+*/
+void start_library_pool() {
+    library_pool = create_worker_pool(0);
+}
+
+/*  Function: submit_task
+*   ---------------------
+*   Appends the task to the queue and wakes one idle worker.
+*/
+void submit_task(WorkerPool* pool, Task task, void* arg) {
+    QueuedTask* queued = malloc(sizeof(QueuedTask));
+    queued->task = task;
+    queued->arg = arg;
+    queued->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail) pool->tail->next = queued;
+    else pool->head = queued;
+    pool->tail = queued;
+    pthread_cond_signal(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*  Function: worker_pool_size
+*   --------------------------
+*   Returns the number of threads.
+*/
+int worker_pool_size(WorkerPool* pool) {
+    return pool->n_threads;
+}
+
+/*  Function: free_worker_pool
+*   --------------------------
+*   Tells the workers to stop once the queue is empty and joins them.
+*/
+void free_worker_pool(WorkerPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->n_threads; i++) pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_ready);
+    free(pool->threads);
+    free(pool);
+}
+
+/*  Function: run_worker
+*   --------------------
+*   Body of each worker thread: repeatedly takes the task at the head of the queue and runs
+*   it outside the lock, sleeping while the queue is empty, until the pool is stopping and
+*   no tasks remain.
+*/
+void* run_worker(void* pool_ptr) {
+    WorkerPool* pool = pool_ptr;
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->head && !pool->stopping) pthread_cond_wait(&pool->task_ready, &pool->lock);
+        QueuedTask* queued = pool->head;
+        if (!queued) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        pool->head = queued->next;
+        if (!pool->head) pool->tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+        queued->task(queued->arg);
+        free(queued);
+    }
+}
@@ -0,0 +1,51 @@
+/*  workers.h
+*   2015, Cody M Leff
+*   for Argo coding challenge
+*   -------------------------
+*   Fixed pool of threads that run submitted tasks in submission order.
+*/
+
+/*  Struct: WorkerPool
+*   ------------------
+*   Reference to a running pool of worker threads.
+*/
+typedef struct WorkerPoolImplementation WorkerPool;
+
+/*  Type: Task
+*   ----------
+*   Function run by a worker thread, passed the argument given at submission.
+*/
+typedef void (*Task)(void* arg);
+
+/*  Function: create_worker_pool
+*   ----------------------------
+*   Starts n_threads worker threads, or one per online processor if n_threads
+*   is not positive.
+*/
+WorkerPool* create_worker_pool(int n_threads);
+
+/*  Function: library_worker_pool
+*   -----------------------------
+*   Returns the pool that the model library runs its own background searches
+*   on, started with one thread per processor on first use and never freed.
+*/
+WorkerPool* library_worker_pool();
+
+/*  Function: submit_task
+*   ---------------------
+*   Queues task to be run with arg on the next idle worker.  Never blocks on
+*   running tasks.
+*/
+void submit_task(WorkerPool* pool, Task task, void* arg);
+
+/*  Function: worker_pool_size
+*   --------------------------
+*   Returns the number of worker threads in the pool.
+*/
+int worker_pool_size(WorkerPool* pool);
+
+/*  Function: free_worker_pool
+*   --------------------------
+*   Waits for every queued task to finish, stops the workers and frees the pool.
+*/
+void free_worker_pool(WorkerPool* pool);